@@ -0,0 +1,96 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*******************************************************************************
+ * Function: bench_cycles
+ * -----------------------------------------------------------------------------
+ * Reads a free-running cycle counter: the TSC on x86, nanoseconds elsewhere.
+ *
+ * Returns:
+ *  - Current counter value.
+ ******************************************************************************/
+static inline uint64_t bench_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Keep a value alive so the optimizer cannot drop the benchmarked work
+template <typename T>
+static inline void bench_keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// False accept rate at which bench_error_rates() reports the false reject rate
+#define BENCH_FAR_TARGET 0.01
+
+// Error rates of a matcher score on a labelled corpus
+typedef struct
+{
+    double eer;                                   // Equal error rate
+    double frr;                                   // False reject rate at BENCH_FAR_TARGET
+} Bench_Error_Rates;
+
+/*******************************************************************************
+ * Function: bench_error_rates
+ * -----------------------------------------------------------------------------
+ * Sweeps the acceptance threshold over every distance of same-label
+ * (genuine) and different-label (impostor) pairs. The rates do not depend on
+ * a threshold, so scores in different units compare directly.
+ *
+ * Parameters:
+ *  - genuine: Distances of same-label pairs, sorted in place.
+ *  - impostor: Distances of different-label pairs, sorted in place.
+ *
+ * Returns:
+ *  - Equal error rate and false reject rate at BENCH_FAR_TARGET.
+ ******************************************************************************/
+static inline Bench_Error_Rates bench_error_rates(std::vector<float> &genuine, std::vector<float> &impostor)
+{
+    std::sort(genuine.begin(), genuine.end());
+    std::sort(impostor.begin(), impostor.end());
+    Bench_Error_Rates rates = {1.0, 1.0};
+    double gap = 2.0;                             // Smallest |FAR - FRR| so far
+    size_t g = 0, k = 0;                          // Pairs at or below the threshold
+    while (g < genuine.size() || k < impostor.size())
+    {
+        // Next threshold: the smaller of the next distances, all equal ones accepted together
+        float threshold = k == impostor.size() || (g < genuine.size() && genuine[g] <= impostor[k]) ? genuine[g] : impostor[k];
+        while (g < genuine.size() && genuine[g] <= threshold)
+        {
+            g++;
+        }
+        while (k < impostor.size() && impostor[k] <= threshold)
+        {
+            k++;
+        }
+        double far = (double)k / impostor.size();
+        double frr = 1.0 - (double)g / genuine.size();
+        if (far <= BENCH_FAR_TARGET)
+        {
+            rates.frr = frr;                      // Still within the false accept budget
+        }
+        if (far - frr < gap && frr - far < gap)
+        {
+            gap = far > frr ? far - frr : frr - far;
+            rates.eer = (far + frr) / 2;
+        }
+    }
+    return rates;
+}
+
+#endif
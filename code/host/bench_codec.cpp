@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * Host benchmark for the gesture trace codec.
+ *
+ * Encodes every capture of a corpus in each codec format and prints the
+ * encoded size per sample, the compression against the raw 12 bytes, how
+ * many keys fit in a 16 KB flash sector, the largest reconstruction error
+ * and the decode cost per sample. Every capture is then decoded,
+ * re-finalized and used as the key against the original records, and the
+ * equal error rate of the rate DTW matcher shows what the quantization costs
+ * in accuracy. Uses the synthetic corpus unless a corpus file is given.
+ *
+ *   bench_codec [corpus.gcr]
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+#include "corpus.h"
+#include "ensemble.h"
+#include "gesture_codec.h"
+
+#define SYNTHETIC_CAPTURES 300                    // Captures in the synthetic corpus, 30 gestures
+#define SECTOR_BYTES (16 * 1024)                  // Smallest STM32F429 flash sector
+#define RUNS 5                                    // Decode runs, the fastest is reported
+
+static uint8_t scratch_memory[1 << 13];           // DTW rows and copies
+
+// Equal error rate of the rate DTW matcher with keys from one corpus and records from another
+static double rate_dtw_eer(const Corpus &keys, const Corpus &records)
+{
+    BumpArena scratch(scratch_memory, sizeof(scratch_memory));
+    std::vector<float> genuine, impostor;
+    for (size_t i = 0; i < keys.templates.size(); i++)
+    {
+        for (size_t j = 0; j < records.templates.size(); j++)
+        {
+            if (i == j)
+            {
+                continue;                         // A capture against its own recording
+            }
+            float score = matcher_score(MATCHER_RATE_DTW, keys.templates[i], records.templates[j], scratch);
+            (keys.labels[i] == records.labels[j] ? genuine : impostor).push_back(score);
+        }
+    }
+    return bench_error_rates(genuine, impostor).eer;
+}
+
+// Encode, measure and decode every capture in one format and print a result line
+static void bench_format(const char *name, uint8_t format, const Corpus &corpus)
+{
+    size_t count = corpus.templates.size();
+    std::vector<std::vector<uint8_t>> encoded(count);
+    size_t bytes = 0, samples = 0, largest = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        encoded[i].resize(CODEC_MAX_BYTES);
+        encoded[i].resize(codec_encode(corpus.templates[i].trace, format, encoded[i].data(), CODEC_MAX_BYTES));
+        bytes += encoded[i].size();
+        samples += corpus.templates[i].trace.size;
+        largest = encoded[i].size() > largest ? encoded[i].size() : largest;
+    }
+
+    // Decode into a copy of the corpus, timing the decoder alone
+    Corpus decoded;
+    corpus_prefix(decoded, corpus, count);
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < RUNS; run++)
+    {
+        uint64_t start = bench_cycles();
+        for (size_t i = 0; i < count; i++)
+        {
+            codec_decode(encoded[i].data(), encoded[i].size(), decoded.templates[i].trace);
+        }
+        uint64_t elapsed = bench_cycles() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    float error = 0.0f;                           // Largest reconstruction error, dps
+    for (size_t i = 0; i < count; i++)
+    {
+        const Gesture_Trace &original = corpus.templates[i].trace;
+        Gesture_Trace &copy = decoded.templates[i].trace;
+        if (copy.size != original.size)
+        {
+            printf("%s: capture %zu did not decode\n", name, i);
+            return;
+        }
+        for (size_t k = 0; k < copy.size; k++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                error = fmaxf(error, fabsf(copy.samples[k][axis] - original.samples[k][axis]));
+            }
+        }
+        template_finalize(decoded.templates[i]);
+    }
+
+    double per_sample = (double)bytes / samples;
+    printf("%-14s %6.2f B/sample %5.1fx %4zu keys/sector  error %5.2f dps  %6.1f cycles/sample  EER %5.2f %%\n",
+           name, per_sample, sizeof(Gesture_Sample) / per_sample, SECTOR_BYTES / largest, error,
+           (double)best / samples, 100 * rate_dtw_eer(decoded, corpus));
+}
+
+int main(int argc, char **argv)
+{
+    Corpus corpus;
+    if (argc > 1)
+    {
+        if (!corpus_load(corpus, argv[1]))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        corpus_synthetic(corpus, SYNTHETIC_CAPTURES, 1);
+    }
+    size_t longest = 0;
+    for (const Gesture_Template &gesture : corpus.templates)
+    {
+        longest = gesture.trace.size > longest ? gesture.trace.size : longest;
+    }
+    printf("%zu captures, raw %zu keys/sector, rate DTW EER %.2f %%\n", corpus.templates.size(),
+           (size_t)SECTOR_BYTES / (longest * sizeof(Gesture_Sample)), 100 * rate_dtw_eer(corpus, corpus));
+
+    bench_format("int16 varint", 0, corpus);
+    bench_format("int16 rice", CODEC_RICE, corpus);
+    bench_format("int8 varint", CODEC_INT8, corpus);
+    bench_format("int8 rice", CODEC_INT8 | CODEC_RICE, corpus);
+    return 0;
+}
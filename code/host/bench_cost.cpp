@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * Host benchmark for the DTW cell costs.
+ *
+ * Scores every pair of a corpus by path DTW per warping step under each cost
+ * in dtw_cost.h and prints the host cycles per matrix cell next to the M4
+ * estimate of the cost class, plus the error rates the cost achieves on the
+ * corpus: the equal error rate and the false reject rate at 1 % false
+ * accepts. Uses the synthetic corpus unless a corpus file is given.
+ *
+ *   bench_cost [corpus.gcr]
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <vector>
+#include "bench.h"
+#include "corpus.h"
+#include "dtw_cost.h"
+
+#define SYNTHETIC_CAPTURES 300                    // Captures in the synthetic corpus, 30 gestures
+
+static uint8_t scratch_memory[1 << 12];           // Two DTW rows
+
+// Score all pairs under one cost and print a result line
+template <typename Cost>
+static void bench_cost(const char *name, const Corpus &corpus)
+{
+    BumpArena scratch(scratch_memory, sizeof(scratch_memory));
+    std::vector<float> genuine, impostor;
+    double cells = 0;
+    uint64_t start = bench_cycles();
+    for (size_t i = 0; i < corpus.templates.size(); i++)
+    {
+        for (size_t j = i + 1; j < corpus.templates.size(); j++)
+        {
+            const Gesture_Trace &s = corpus.templates[i].path;
+            const Gesture_Trace &t = corpus.templates[j].path;
+            float distance = dtw_with<Cost>(s, t, scratch) / (float)(s.size + t.size);
+            (corpus.labels[i] == corpus.labels[j] ? genuine : impostor).push_back(distance);
+            cells += (double)s.size * t.size;
+        }
+    }
+    uint64_t elapsed = bench_cycles() - start;
+    Bench_Error_Rates rates = bench_error_rates(genuine, impostor);
+    printf("%-24s %8.2f cycles/cell (M4 estimate %2u)   EER %5.2f %%   FRR@FAR1%% %5.2f %%\n", name,
+           elapsed / cells, (unsigned)Cost::cost, 100 * rates.eer, 100 * rates.frr);
+}
+
+int main(int argc, char **argv)
+{
+    Corpus corpus;
+    if (argc > 1)
+    {
+        if (!corpus_load(corpus, argv[1]))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        corpus_synthetic(corpus, SYNTHETIC_CAPTURES, 1);
+    }
+    printf("%zu captures\n", corpus.templates.size());
+
+    bench_cost<L2Cost>("L2", corpus);
+    bench_cost<SquaredL2Cost>("squared L2", corpus);
+    bench_cost<L1Cost>("L1", corpus);
+    bench_cost<FastL2Cost>("L2, fast sqrt", corpus);
+    bench_cost<WeightedL2Cost<384, 256, 128>>("L2 weighted 1.5/1/0.5", corpus);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * Host benchmark for the DTW kernels.
+ *
+ * Scores random rotation paths of the lengths the matcher sees with the
+ * row-by-row dtw() and with the anti-diagonal dtw_wavefront(), and prints
+ * matrix cells per second. The wavefront is timed twice: with the SoA
+ * transposition on every call, as the matcher would use it, and with the
+ * traces transposed once, as a batch tool would. Every result is compared
+ * bit for bit with dtw().
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "bench.h"
+#include "matcher.h"
+#include "dtw_wavefront.h"
+
+#define PAIRS 64                                  // Trace pairs per length
+#define RUNS 5                                    // Runs per kernel, the fastest is reported
+
+static uint8_t scratch_memory[1 << 16];           // Rows, diagonals and SoA copies
+
+// Seconds on the host clock
+static double bench_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Random walk resembling an integrated rotation path
+static void make_trace(Gesture_Trace &trace, size_t length)
+{
+    Gesture_Sample angle = {0.0f, 0.0f, 0.0f};
+    for (size_t i = 0; i < length; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            angle[axis] += (rand() % 2001 - 1000) * 1e-4f;
+        }
+        trace_push(trace, angle);
+    }
+}
+
+int main()
+{
+    static Gesture_Sample storage[2 * PAIRS][GESTURE_MAX_SAMPLES];
+    Gesture_Trace traces[2 * PAIRS];
+    BumpArena scratch(scratch_memory, sizeof(scratch_memory));
+    srand(1);
+
+    printf("lanes: %d\n", DTW_LANES);
+    printf("%6s %16s %16s %16s %8s\n", "length", "dtw cells/s", "wavefront", "wavefront soa", "same");
+    const size_t lengths[] = {32, 64, 128};
+    for (size_t length : lengths)
+    {
+        for (int p = 0; p < 2 * PAIRS; p++)
+        {
+            trace_init(traces[p], storage[p], GESTURE_MAX_SAMPLES);
+            make_trace(traces[p], length - (size_t)(rand() % (length / 4)));   // Lengths differ a little
+        }
+        double cells = 0;
+        for (int p = 0; p < PAIRS; p++)
+        {
+            cells += (double)traces[2 * p].size * traces[2 * p + 1].size;
+        }
+
+        // SoA copies for the batch variant, made once
+        std::vector<uint8_t> soa_memory(2 * PAIRS * 3 * GESTURE_MAX_SAMPLES * sizeof(float) + 64);
+        BumpArena soa_arena(soa_memory.data(), soa_memory.size());
+        Dtw_Soa soa[2 * PAIRS];
+        for (int p = 0; p < 2 * PAIRS; p++)
+        {
+            dtw_soa_init(soa[p], traces[p], p % 2 == 1, soa_arena);
+        }
+
+        float reference[PAIRS], wavefront[PAIRS], batch[PAIRS];
+        double best[3] = {1e30, 1e30, 1e30};
+        for (int run = 0; run < RUNS; run++)
+        {
+            double start = bench_seconds();
+            for (int p = 0; p < PAIRS; p++)
+            {
+                reference[p] = dtw(traces[2 * p], traces[2 * p + 1], scratch);
+            }
+            double middle = bench_seconds();
+            for (int p = 0; p < PAIRS; p++)
+            {
+                wavefront[p] = dtw_wavefront(traces[2 * p], traces[2 * p + 1], scratch);
+            }
+            double late = bench_seconds();
+            for (int p = 0; p < PAIRS; p++)
+            {
+                batch[p] = dtw_wavefront_soa(soa[2 * p], soa[2 * p + 1], scratch);
+            }
+            double end = bench_seconds();
+            bench_keep(reference);
+            bench_keep(wavefront);
+            bench_keep(batch);
+            best[0] = middle - start < best[0] ? middle - start : best[0];
+            best[1] = late - middle < best[1] ? late - middle : best[1];
+            best[2] = end - late < best[2] ? end - late : best[2];
+        }
+
+        bool same = memcmp(reference, wavefront, sizeof(reference)) == 0 && memcmp(reference, batch, sizeof(reference)) == 0;
+        printf("%6zu %16.3e %16.3e %16.3e %8s\n", length, cells / best[0], cells / best[1], cells / best[2],
+               same ? "yes" : "NO");
+        if (!same)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Host benchmark for the capture filter stages.
+ *
+ * Runs a synthetic 200 Hz gyroscope signal (slow rotation, tremor and spikes)
+ * through each stage on its own and through the firmware's capture chain, and
+ * prints the cost per sample. Host cycles are not M4 cycles, but the ratios
+ * between stages carry over and regressions show up here first.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+#include "filter.h"
+#include "decimator.h"
+
+#define SAMPLE_COUNT (1 << 20)                    // Samples per run
+#define RUNS 5                                    // Runs per stage, the fastest is reported
+
+/*******************************************************************************
+ * Class: Biquad
+ * -----------------------------------------------------------------------------
+ * Direct form I second-order section with Q14 coefficients, the low-pass the
+ * capture chain used before the decimators took over band limiting:
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2].
+ *
+ * Template parameters:
+ *  - B0, B1, B2: Feed-forward coefficients in Q14.
+ *  - A1, A2: Feedback coefficients in Q14 (a0 normalized to 1).
+ ******************************************************************************/
+template <int32_t B0, int32_t B1, int32_t B2, int32_t A1, int32_t A2>
+class Biquad
+{
+public:
+    static const uint32_t cost = 20;
+
+    Biquad() { reset(); }
+
+    int16_t process(int16_t x)
+    {
+        // 64-bit accumulation maps to SMLAL on the M4 and cannot overflow
+        int64_t acc = (int64_t)B0 * x + (int64_t)B1 * x1 + (int64_t)B2 * x2
+                    - (int64_t)A1 * y1 - (int64_t)A2 * y2;
+        int16_t y = filter_saturate((int32_t)((acc + (1 << 13)) >> 14)); // Round back from Q14
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+
+    void reset()
+    {
+        x1 = x2 = 0;
+        y1 = y2 = 0;
+    }
+
+private:
+    int16_t x1, x2;                                      // Previous inputs
+    int16_t y1, y2;                                      // Previous outputs
+};
+
+// 2nd-order Butterworth low-pass, 8 Hz cutoff at 200 Hz ODR (b1 trimmed for unity DC gain)
+typedef Biquad<219, 437, 219, -26992, 11483> LowPass8Hz_200Hz;
+
+// Build the synthetic input signal in raw counts
+static std::vector<int16_t> make_signal()
+{
+    std::vector<int16_t> signal(SAMPLE_COUNT);
+    srand(1);
+    for (size_t i = 0; i < signal.size(); i++)
+    {
+        float t = i / 200.0f;                                        // 200 Hz ODR
+        float value = 4000.0f * sinf(2.0f * 3.14159f * 1.5f * t)     // Gesture band
+                    + 300.0f * sinf(2.0f * 3.14159f * 40.0f * t)     // Out-of-band vibration
+                    + (rand() % 41 - 20);                            // Sensor noise
+        if (rand() % 500 == 0)
+        {
+            value += 8000.0f;                                        // Occasional spike
+        }
+        signal[i] = (int16_t)value;
+    }
+    return signal;
+}
+
+// Time one filter over the signal and print cycles per sample
+template <typename Filter>
+static void bench_stage(const char *name, const std::vector<int16_t> &signal)
+{
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < RUNS; run++)
+    {
+        Filter filter;
+        int32_t checksum = 0;
+        uint64_t start = bench_cycles();
+        for (size_t i = 0; i < signal.size(); i++)
+        {
+            checksum += filter.process(signal[i]);
+        }
+        uint64_t elapsed = bench_cycles() - start;
+        bench_keep(checksum);
+        best = elapsed < best ? elapsed : best;
+    }
+    printf("%-28s %8.2f cycles/sample   (M4 estimate %3u)\n", name,
+           (double)best / signal.size(), (unsigned)Filter::cost);
+}
+
+// Time one decimator over the signal and print cycles per input sample
+template <typename Decimator>
+static void bench_decimator(const char *name, const std::vector<int16_t> &signal)
+{
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < RUNS; run++)
+    {
+        Decimator decimator;
+        int32_t checksum = 0;
+        int16_t y = 0;
+        uint64_t start = bench_cycles();
+        for (size_t i = 0; i < signal.size(); i++)
+        {
+            if (decimator.process(signal[i], y))
+            {
+                checksum += y;
+            }
+        }
+        uint64_t elapsed = bench_cycles() - start;
+        bench_keep(checksum);
+        best = elapsed < best ? elapsed : best;
+    }
+    printf("%-28s %8.2f cycles/sample   (M4 estimate %3u)\n", name,
+           (double)best / signal.size(), (unsigned)Decimator::cost);
+}
+
+int main()
+{
+    std::vector<int16_t> signal = make_signal();
+
+    printf("Filter stage cost, %d samples per run\n", SAMPLE_COUNT);
+    bench_stage<DcBlocker<32604>>("DcBlocker<0.995>", signal);
+    bench_stage<LowPass8Hz_200Hz>("Biquad low-pass 8 Hz", signal);
+    bench_stage<MovingAverage<4>>("MovingAverage<4>", signal);
+    bench_stage<MovingAverage<16>>("MovingAverage<16>", signal);
+    bench_stage<Median3>("Median3", signal);
+    bench_stage<FilterChain<Median3>>("Capture chain", signal);
+    bench_stage<FilterChain<DcBlocker<32604>, Median3, LowPass8Hz_200Hz, MovingAverage<4>>>("All stages", signal);
+    bench_decimator<PolyphaseDecimator<8, 8>>("Decimator 8x, 8 taps/phase", signal);
+    bench_decimator<PolyphaseDecimator<5, 6>>("Decimator 5x, 6 taps/phase", signal);
+    return 0;
+}
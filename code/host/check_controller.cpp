@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * Host check of the controller's erase gate.
+ *
+ * Replays event sequences through a model of controller_thread() that makes
+ * the same controller_state.h calls at the same points: an erase request
+ * asks erase_gate_request(), every state change goes through
+ * erase_gate_enter(), and a capture leaves Capturing before a new key is
+ * saved. Each sequence states which keys must survive it. Prints one line
+ * per sequence and fails if any key is erased that should not be, or an
+ * erase is lost.
+ *
+ *   check_controller
+ ******************************************************************************/
+
+#include <stdio.h>
+#include "controller_state.h"
+
+// Controller model: the state, the gate and whether a key is stored
+typedef struct
+{
+    Controller_State state;
+    Erase_Gate gate;
+    bool recording_key;                           // The capture becomes the key
+    bool key;                                     // A key is stored
+} Model;
+
+static void enter(Model &m, Controller_State next)
+{
+    m.state = next;
+    if (erase_gate_enter(m.gate, next))
+    {
+        m.key = false;                            // The held erase runs
+    }
+}
+
+static void request(Model &m, bool record)
+{
+    m.recording_key = record;
+    enter(m, STATE_CALIBRATING);
+    enter(m, STATE_CAPTURING);                    // EVENT_CALIBRATION_DONE
+}
+
+static void erase(Model &m)
+{
+    if (erase_gate_request(m.gate, m.state))
+    {
+        m.key = false;
+    }
+}
+
+static void capture_done(Model &m)
+{
+    enter(m, !m.recording_key && m.key ? STATE_MATCHING : STATE_RESULT);
+    if (m.recording_key)
+    {
+        m.key = true;                             // save_key()
+    }
+}
+
+static void match_done(Model &m)
+{
+    enter(m, STATE_RESULT);
+}
+
+static void timeout(Model &m)
+{
+    enter(m, STATE_IDLE);
+}
+
+// Report one sequence; returns true if the key state and the gate are as expected
+static bool expect(const char *name, const Model &m, bool key)
+{
+    bool ok = m.key == key && !m.gate.pending;
+    printf("%-52s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Erase during an unlock capture with no key, then record and unlock: the new key must survive
+    {
+        Model m = {STATE_IDLE, {false}, false, false};
+        request(m, false);
+        erase(m);
+        capture_done(m);                          // "NO KEY SAVED." branch
+        timeout(m);
+        request(m, true);
+        capture_done(m);
+        timeout(m);
+        request(m, false);
+        capture_done(m);
+        match_done(m);
+        timeout(m);
+        ok &= expect("erase in keyless unlock, then record and unlock", m, true);
+    }
+
+    // Erase during an unlock capture with a key: held through matching, served on the result
+    {
+        Model m = {STATE_IDLE, {false}, false, true};
+        request(m, false);
+        erase(m);
+        capture_done(m);
+        bool held = m.key && m.state == STATE_MATCHING;
+        match_done(m);
+        ok &= expect("erase in unlock capture, held through matching", m, false) && held;
+    }
+
+    // Erase during matching: served on the result
+    {
+        Model m = {STATE_IDLE, {false}, false, true};
+        request(m, false);
+        capture_done(m);
+        erase(m);
+        match_done(m);
+        ok &= expect("erase during matching", m, false);
+    }
+
+    // Erase while idle or on the result screen: served at once
+    {
+        Model m = {STATE_IDLE, {false}, false, true};
+        erase(m);
+        ok &= expect("erase while idle", m, false);
+    }
+
+    // Erase while recording a key: held until the capture ends, then the old key goes and the new one stays
+    {
+        Model m = {STATE_IDLE, {false}, false, true};
+        request(m, true);
+        erase(m);
+        bool held = m.gate.pending;
+        capture_done(m);
+        timeout(m);
+        ok &= expect("erase while recording a key, held until it ends", m, true) && held;
+    }
+
+    // Erase during calibration: held, no erase may overlap sampling
+    {
+        Model m = {STATE_IDLE, {false}, false, true};
+        m.recording_key = true;
+        enter(m, STATE_CALIBRATING);
+        erase(m);
+        bool held = m.key && m.gate.pending;
+        enter(m, STATE_CAPTURING);
+        held = held && m.key;
+        capture_done(m);
+        ok &= expect("erase during calibration, held through the capture", m, true) && held;
+    }
+
+    printf("controller check: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>                               // Include file access
+#include <string.h>                              // Include memcmp
+#include <math.h>                                // Include sinf
+#include <random>                                // Include the synthetic gesture generator
+#include "corpus.h"                              // Include the corpus header
+
+// Arena bytes per template, with room for alignment
+#define CORPUS_TEMPLATE_BYTES (TEMPLATE_ARENA_BYTES + 64)
+
+// Size the arena and carve count empty templates from it
+static void corpus_reserve(Corpus &corpus, size_t count)
+{
+    corpus.storage.assign(count * CORPUS_TEMPLATE_BYTES, 0);
+    corpus.templates.resize(count);
+    corpus.labels.resize(count);
+    BumpArena arena(corpus.storage.data(), corpus.storage.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        template_init(corpus.templates[i], arena);   // Sized above, cannot fail
+    }
+}
+
+/*******************************************************************************
+ * Function: corpus_load
+ * -----------------------------------------------------------------------------
+ * Reads every capture of a corpus file and finalizes it. Captures longer than
+ * GESTURE_MAX_SAMPLES cannot come from the firmware and are truncated.
+ *
+ * Parameters:
+ *  - corpus: Receives the captures.
+ *  - path: Corpus file.
+ *
+ * Returns:
+ *  - true if the file was read completely.
+ ******************************************************************************/
+bool corpus_load(Corpus &corpus, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    uint8_t header[8];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "GCRP", 4) != 0 ||
+        (header[4] | header[5] << 8) != CORPUS_VERSION)
+    {
+        fprintf(stderr, "%s: not a version %d corpus\n", path, CORPUS_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    // Two passes: count the captures, then read them into a single arena
+    std::vector<long> offsets;                   // File offset of each capture
+    uint8_t capture[4];
+    while (fread(capture, 1, sizeof(capture), file) == sizeof(capture))
+    {
+        offsets.push_back(ftell(file) - (long)sizeof(capture));
+        uint16_t count = (uint16_t)(capture[2] | capture[3] << 8);
+        fseek(file, (long)count * 6 * sizeof(float), SEEK_CUR);
+    }
+
+    corpus_reserve(corpus, offsets.size());
+    bool complete = true;
+    for (size_t i = 0; i < offsets.size() && complete; i++)
+    {
+        fseek(file, offsets[i], SEEK_SET);
+        complete = fread(capture, 1, sizeof(capture), file) == sizeof(capture);
+        corpus.labels[i] = (uint16_t)(capture[0] | capture[1] << 8);
+        uint16_t count = (uint16_t)(capture[2] | capture[3] << 8);
+        Gesture_Template &gesture = corpus.templates[i];
+        for (uint16_t k = 0; k < count && complete; k++)
+        {
+            float values[6];                     // Rate and path, little-endian like the host
+            complete = fread(values, sizeof(float), 6, file) == 6;
+            trace_push(gesture.trace, {values[0], values[1], values[2]});
+            trace_push(gesture.path, {values[3], values[4], values[5]});
+        }
+        template_finalize(gesture);
+    }
+    fclose(file);
+    if (!complete)
+    {
+        fprintf(stderr, "%s: truncated\n", path);
+    }
+    return complete;
+}
+
+/*******************************************************************************
+ * Function: corpus_synthetic
+ * -----------------------------------------------------------------------------
+ * Builds a deterministic stand-in corpus for benchmarks. Every gesture is a
+ * few smooth rate bursts per axis; its repetitions are stretched in time,
+ * scaled in amplitude and noisy, like a person repeating a gesture. Paths
+ * are the per-axis integral of the rates, which is close to the firmware's
+ * quaternion path for rotations this small.
+ *
+ * Parameters:
+ *  - corpus: Receives the captures.
+ *  - count: Number of captures.
+ *  - seed: Generator seed.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void corpus_synthetic(Corpus &corpus, size_t count, uint32_t seed)
+{
+    const float pi = 3.14159265f;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 5.0f);  // Sensor and hand noise in dps
+
+    size_t gestures = count / 10 > 0 ? count / 10 : 1;  // Ten repetitions per gesture
+    std::vector<float> shape(gestures * 3 * 3 * 3);     // Amplitude, frequency and phase of three bursts per axis
+    std::vector<float> length(gestures);                 // Nominal duration in samples
+    for (size_t g = 0; g < gestures; g++)
+    {
+        length[g] = 40.0f + 60.0f * unit(random);
+        for (size_t k = 0; k < 27; k += 3)
+        {
+            shape[g * 27 + k + 0] = 50.0f + 250.0f * unit(random);
+            shape[g * 27 + k + 1] = 0.5f + 2.5f * unit(random);
+            shape[g * 27 + k + 2] = 2.0f * pi * unit(random);
+        }
+    }
+
+    corpus_reserve(corpus, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t g = i % gestures;
+        corpus.labels[i] = (uint16_t)g;
+        float stretch = 0.85f + 0.3f * unit(random);   // Performed faster or slower
+        float gain = 0.8f + 0.4f * unit(random);       // Performed with more or less vigour
+        size_t n = (size_t)(length[g] * stretch);
+        n = n < GESTURE_MAX_SAMPLES ? n : GESTURE_MAX_SAMPLES;
+
+        Gesture_Template &gesture = corpus.templates[i];
+        Gesture_Sample angle = {0.0f, 0.0f, 0.0f};
+        for (size_t k = 0; k < n; k++)
+        {
+            float phase = (float)k / (float)n;          // Position within the gesture
+            Gesture_Sample rate;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float *burst = &shape[g * 27 + axis * 9];
+                float value = 0.0f;
+                for (int b = 0; b < 3; b++)
+                {
+                    value += burst[3 * b] * sinf(2.0f * pi * burst[3 * b + 1] * phase + burst[3 * b + 2]);
+                }
+                rate[axis] = gain * value * sinf(pi * phase) / 3.0f + noise(random);
+                angle[axis] += rate[axis] * (pi / 180.0f) / GESTURE_RATE_HZ;
+            }
+            trace_push(gesture.trace, rate);
+            trace_push(gesture.path, angle);
+        }
+        template_finalize(gesture);
+    }
+}
+
+/*******************************************************************************
+ * Function: corpus_prefix
+ * -----------------------------------------------------------------------------
+ * Copies the first captures of a corpus, for benchmarks over growing sizes.
+ *
+ * Parameters:
+ *  - prefix: Receives the copy.
+ *  - corpus: Source corpus.
+ *  - count: Number of captures, at most the corpus size.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void corpus_prefix(Corpus &prefix, const Corpus &corpus, size_t count)
+{
+    corpus_reserve(prefix, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        prefix.labels[i] = corpus.labels[i];
+        trace_copy(prefix.templates[i].trace, corpus.templates[i].trace);
+        trace_copy(prefix.templates[i].path, corpus.templates[i].path);
+        template_finalize(prefix.templates[i]);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "gesture_arena.h"
+#include "gesture_template.h"
+
+/*******************************************************************************
+ * Gesture corpus
+ *
+ * Captures recorded by the firmware and collected by serial_dump.py --corpus,
+ * loaded into finalized templates exactly as the matcher thread builds them.
+ * File layout, little-endian:
+ *
+ *   "GCRP" version:u16 reserved:u16
+ *   { label:u16 count:u16 { x y z path_x path_y path_z : f32 } * count } ...
+ *
+ * Rates are in dps at GESTURE_RATE_HZ, paths in radians.
+ ******************************************************************************/
+
+#define CORPUS_VERSION 1
+
+// Captures with their labels, backed by one arena
+typedef struct
+{
+    std::vector<uint8_t> storage;              // Arena memory for every template
+    std::vector<Gesture_Template> templates;   // Finalized captures
+    std::vector<uint16_t> labels;              // Label per capture, e.g. person and gesture
+} Corpus;
+
+// Load a corpus file, returns false with a message on stderr if it is unreadable
+bool corpus_load(Corpus &corpus, const char *path);
+
+// Generate count captures of count / 10 gestures, each repeated with timing, amplitude and noise variation
+void corpus_synthetic(Corpus &corpus, size_t count, uint32_t seed);
+
+// First count captures of a corpus, sharing nothing with it
+void corpus_prefix(Corpus &prefix, const Corpus &corpus, size_t count);
+
+#endif
@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * Offline calibration of the matcher ensemble.
+ *
+ * Scores every pair of captures of a labelled corpus with all six matchers,
+ * fits the logistic fusion with ensemble_fit() with every matcher enabled,
+ * and prints the fitted coefficients as the ENSEMBLE_* defines of
+ * src/ensemble.h. The equal error rate and the false reject rate at 1 % false
+ * accepts of the fused logit, and the error rates at the model's own
+ * decision, are printed for the default and the fitted model. Pairs with a
+ * score that is not finite, e.g. the correlation of a flat axis, are left
+ * out of the fit. Uses the synthetic corpus unless a corpus file is given;
+ * only a fit of recorded captures belongs in src/ensemble.h.
+ *
+ * Before fitting, a self-check fits scores drawn from two separated classes
+ * and fails unless every distance weight comes out negative, the correlation
+ * weight positive, and the decision boundary splits the two classes.
+ * --check runs only the self-check.
+ *
+ *   fit [--check] [corpus.gcr]
+ ******************************************************************************/
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "corpus.h"
+#include "ensemble.h"
+#include "matcher.h"
+
+#define SYNTHETIC_CAPTURES 300                    // Captures in the synthetic corpus, 30 gestures
+#define FIT_ITERATIONS 2000                       // Gradient steps
+#define FIT_RATE 0.5f                             // Learning rate on standardized scores
+#define CHECK_ATTEMPTS 400                        // Score vectors per class in the self-check
+
+static uint8_t scratch_memory[4 * (GESTURE_MAX_SAMPLES + 1) * sizeof(float) + 64]; // DTW rows and copies
+
+// Sign of a score change towards a closer match, in Matcher_Id order
+static const float closer[MATCHER_COUNT] = {-1.0f, 1.0f, -1.0f, -1.0f, -1.0f, -1.0f};
+
+// Typical distance of a score from its offset, for the self-check classes
+static const float spread[MATCHER_COUNT] = {
+    0.5f * FEATURE_THRESHOLD, 0.5f, 0.5f * RATE_DTW_THRESHOLD, 0.5f * DERIVATIVE_DTW_THRESHOLD,
+    0.5f * ZNORM_DTW_THRESHOLD, 0.5f * DTW_THRESHOLD,
+};
+
+// Score vectors, MATCHER_COUNT floats per attempt, in the layout ensemble_fit() reads
+typedef std::vector<float> Score_Table;
+
+// Scores of one attempt
+static const float *attempt(const Score_Table &scores, size_t n)
+{
+    return &scores[n * MATCHER_COUNT];
+}
+
+// Print the error rates of a model's fused logit, over all thresholds and at the model's decision
+static void report_model(const char *name, const Ensemble_Model &model, const Score_Table &scores, const bool *genuine)
+{
+    std::vector<float> same, different;
+    size_t false_rejects = 0, false_accepts = 0;
+    for (size_t n = 0; n < scores.size() / MATCHER_COUNT; n++)
+    {
+        float logit = ensemble_logit(model, attempt(scores, n));
+        (genuine[n] ? same : different).push_back(-logit);      // Higher logits are closer
+        false_rejects += genuine[n] && !ensemble_accepts(model, logit);
+        false_accepts += !genuine[n] && ensemble_accepts(model, logit);
+    }
+    double frr = (double)false_rejects / same.size();
+    double far = (double)false_accepts / different.size();
+    Bench_Error_Rates rates = bench_error_rates(same, different);
+    printf("%-14s EER %5.2f %%   FRR@FAR1%% %5.2f %%   at the decision FAR %5.2f %% FRR %5.2f %%\n", name,
+           100 * rates.eer, 100 * rates.frr, 100 * far, 100 * frr);
+}
+
+// Fit a model with every matcher enabled to a score table; offsets and decision are the defaults
+static Ensemble_Model fit_model(const Score_Table &scores, const bool *genuine)
+{
+    Ensemble_Model model = ensemble_default_model;
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        model.weight[i] = closer[i];                            // Enabled, and the sign each weight keeps
+    }
+    ensemble_fit(model, (const float(*)[MATCHER_COUNT])scores.data(), genuine, scores.size() / MATCHER_COUNT,
+                 FIT_ITERATIONS, FIT_RATE);
+    return model;
+}
+
+// Print the model as the defines of src/ensemble.h
+static void print_model(const Ensemble_Model &model)
+{
+    printf("#define ENSEMBLE_BIAS %.3ff\n", model.bias);
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        char name[32];
+        const char *lower = matcher_name((Matcher_Id)i);
+        size_t k = 0;
+        for (; lower[k] != '\0' && k + 1 < sizeof(name); k++)
+        {
+            name[k] = (char)toupper((unsigned char)lower[k]);
+        }
+        name[k] = '\0';
+        printf("#define ENSEMBLE_WEIGHT_%s %.3ff\n", name, model.weight[i]);
+    }
+}
+
+/*******************************************************************************
+ * Function: check_fit
+ * -----------------------------------------------------------------------------
+ * Fits scores drawn from two classes that lie on either side of every
+ * matcher's offset: genuine attempts closer than the offset by 0.2 to 1.2
+ * spreads, impostors further by as much. Every input separates the classes
+ * on its own, so the fit must weight each one towards a closer match and
+ * place the decision boundary between the classes.
+ *
+ * Returns:
+ *  - true if the weight signs and the boundary are as expected.
+ ******************************************************************************/
+static bool check_fit()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> margin(0.2f, 1.2f);
+    Score_Table scores(2 * CHECK_ATTEMPTS * MATCHER_COUNT);
+    bool genuine[2 * CHECK_ATTEMPTS];
+    for (size_t n = 0; n < 2 * CHECK_ATTEMPTS; n++)
+    {
+        genuine[n] = n < CHECK_ATTEMPTS;
+        for (int i = 0; i < MATCHER_COUNT; i++)
+        {
+            float side = genuine[n] ? closer[i] : -closer[i];
+            scores[n * MATCHER_COUNT + i] = ensemble_default_model.offset[i] + side * margin(random) * spread[i];
+        }
+    }
+    Ensemble_Model model = fit_model(scores, genuine);
+
+    bool ok = true;
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        if (!(model.weight[i] * closer[i] > 0))
+        {
+            printf("fit check: %s weight %g has the wrong sign\n", matcher_name((Matcher_Id)i), model.weight[i]);
+            ok = false;
+        }
+    }
+    size_t misplaced = 0;
+    for (size_t n = 0; n < 2 * CHECK_ATTEMPTS; n++)
+    {
+        misplaced += ensemble_accepts(model, ensemble_logit(model, attempt(scores, n))) != genuine[n];
+    }
+    if (misplaced != 0)
+    {
+        printf("fit check: boundary misplaces %zu of %u attempts\n", misplaced, 2 * CHECK_ATTEMPTS);
+        ok = false;
+    }
+    printf("fit check: %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    bool check_only = argc > 1 && strcmp(argv[1], "--check") == 0;
+    if (!check_fit())
+    {
+        return 1;
+    }
+    if (check_only)
+    {
+        return 0;
+    }
+
+    Corpus corpus;
+    if (argc > 1)
+    {
+        if (!corpus_load(corpus, argv[1]))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        corpus_synthetic(corpus, SYNTHETIC_CAPTURES, 1);
+    }
+
+    // Score every pair once with every matcher
+    BumpArena scratch(scratch_memory, sizeof(scratch_memory));
+    size_t count = corpus.templates.size();
+    Score_Table scores;
+    std::unique_ptr<bool[]> genuine(new bool[count * (count - 1) / 2 + 1]);
+    size_t attempts = 0, skipped = 0, same = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t j = i + 1; j < count; j++)
+        {
+            float score[MATCHER_COUNT];
+            bool finite = true;
+            for (int k = 0; k < MATCHER_COUNT; k++)
+            {
+                score[k] = matcher_score((Matcher_Id)k, corpus.templates[i], corpus.templates[j], scratch);
+                finite = finite && isfinite(score[k]);
+            }
+            if (!finite)
+            {
+                skipped++;
+                continue;
+            }
+            scores.insert(scores.end(), score, score + MATCHER_COUNT);
+            genuine[attempts] = corpus.labels[i] == corpus.labels[j];
+            same += genuine[attempts++];
+        }
+    }
+    printf("%zu captures, %zu pairs (%zu genuine), %zu left out\n", count, attempts, same, skipped);
+    if (same == 0 || same == attempts)
+    {
+        printf("both genuine and impostor pairs are needed\n");
+        return 1;
+    }
+
+    Ensemble_Model model = fit_model(scores, genuine.get());
+    report_model("default model", ensemble_default_model, scores, genuine.get());
+    report_model("fitted model", model, scores, genuine.get());
+    print_model(model);
+    return 0;
+}
@@ -0,0 +1,551 @@
+/*******************************************************************************
+ * All-pairs matcher scores for a gesture corpus.
+ *
+ * Scores every capture of a corpus against every other with the six
+ * ensemble matchers and writes the scores as distance matrices, for choosing
+ * thresholds, band widths and ensemble weights offline. Templates are built by
+ * the firmware's own template_finalize() and scored with the firmware's own
+ * feature and correlation code. Path DTW runs on the anti-diagonal
+ * dtw_wavefront kernel and banded rate DTW on a row kernel that computes each
+ * row's cell costs with AVX2. Both keep the firmware's operation order, so
+ * every score is bit-identical to the device. --check recomputes a sample of
+ * pairs with matcher_score() and fails on any difference. Every matcher is
+ * symmetric, so only the upper triangle is computed and mirrored.
+ *
+ *   pairs --corpus corpus.gcr --output scores.gdm
+ *   pairs --synthetic 4000 --bench
+ *
+ * Matrix file, little-endian, written through a shared memory mapping:
+ *
+ *   Matrix_Header, label:u16[count], padding to data_offset,
+ *   score:f32[MATCHER_COUNT][count][count] in Matcher_Id order, row = key
+ *
+ * e.g. numpy.memmap(path, "<f4", "r", offset, (matchers, count, count)).
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "corpus.h"
+#include "work_pool.h"
+#include "ensemble.h"
+#include "matcher.h"
+#include "dtw_wavefront.h"
+
+#define PAIRS_TILE 32                              // Captures per tile side, one task per tile
+#define PAIRS_CHECK 256                            // Pairs verified against the firmware by default
+#define PAIRS_MATRIX_VERSION 2                     // 2 added the derivative and z-normalized DTW
+
+// Start of the matrix file
+typedef struct
+{
+    char magic[4];                                 // "GDMX"
+    uint16_t version;                              // PAIRS_MATRIX_VERSION
+    uint16_t matchers;                             // Matrices in the file, MATCHER_COUNT
+    uint32_t count;                                // Captures, rows and columns of each matrix
+    uint32_t data_offset;                          // Byte offset of the first matrix, 64-byte aligned
+} Matrix_Header;
+
+// Structure-of-arrays copy of a trace, so a row of costs is three contiguous loads per vector
+typedef struct
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    size_t size;                                   // Valid samples
+} Soa_Trace;
+
+// DTW rows and cell costs of one worker
+typedef struct
+{
+    std::vector<float> previous;                   // Row i - 1 of the DTW matrix
+    std::vector<float> current;                    // Row i of the DTW matrix
+    std::vector<float> cost;                       // Cell costs of the current row
+    std::vector<float> above;                      // Cost plus the better cell of the previous row
+} Dtw_Rows;
+
+// Transpose a trace into SoA form
+static void soa_from_trace(Soa_Trace &soa, const Gesture_Trace &trace)
+{
+    soa.x.resize(trace.size);
+    soa.y.resize(trace.size);
+    soa.z.resize(trace.size);
+    for (size_t i = 0; i < trace.size; i++)
+    {
+        soa.x[i] = trace.samples[i][0];
+        soa.y[i] = trace.samples[i][1];
+        soa.z[i] = trace.samples[i][2];
+    }
+    soa.size = trace.size;
+}
+
+/*******************************************************************************
+ * Function: cost_row
+ * -----------------------------------------------------------------------------
+ * Everything of DTW row i that does not depend on the row itself, for columns
+ * lo..hi: the cell cost, evaluated like euclidean_distance() as
+ * ((dx * dx + dy * dy) + dz * dz) and a correctly rounded square root, and
+ * the cost plus the better of the two cells above. Rounding is monotonic, so
+ * cost + min(a, b) == min(cost + a, cost + b) exactly, and the serial part of
+ * the recurrence is left with one add and one min per cell. Without fused
+ * multiply-adds every lane matches the scalar firmware bit for bit.
+ ******************************************************************************/
+static void cost_row(float sx, float sy, float sz, const Soa_Trace &t, const float *previous, size_t lo, size_t hi,
+                     float *cost, float *above)
+{
+    size_t j = lo;
+#if defined(__AVX2__)
+    __m256 vx = _mm256_set1_ps(sx);
+    __m256 vy = _mm256_set1_ps(sy);
+    __m256 vz = _mm256_set1_ps(sz);
+    for (; j + 8 <= hi + 1; j += 8)
+    {
+        __m256 dx = _mm256_sub_ps(vx, _mm256_loadu_ps(&t.x[j - 1]));
+        __m256 dy = _mm256_sub_ps(vy, _mm256_loadu_ps(&t.y[j - 1]));
+        __m256 dz = _mm256_sub_ps(vz, _mm256_loadu_ps(&t.z[j - 1]));
+        __m256 sum = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(sum, _mm256_mul_ps(dz, dz)));
+        __m256 best = _mm256_min_ps(_mm256_loadu_ps(&previous[j]), _mm256_loadu_ps(&previous[j - 1]));
+        _mm256_storeu_ps(&cost[j], distance);
+        _mm256_storeu_ps(&above[j], _mm256_add_ps(distance, best));
+    }
+#endif
+    for (; j <= hi; j++)
+    {
+        float dx = sx - t.x[j - 1];
+        float dy = sy - t.y[j - 1];
+        float dz = sz - t.z[j - 1];
+        float sum = dx * dx + dy * dy;
+        cost[j] = sqrtf(sum + dz * dz);
+        above[j] = cost[j] + std::min(previous[j], previous[j - 1]);
+    }
+}
+
+/*******************************************************************************
+ * Function: pair_dtw
+ * -----------------------------------------------------------------------------
+ * dtw_banded() over SoA inputs: the same band, window rounding and stale-row
+ * reset, with the row-independent part of each window computed up front by
+ * cost_row(). A band of at least t.size gives the full dtw().
+ ******************************************************************************/
+static float pair_dtw(const Soa_Trace &s, const Soa_Trace &t, size_t band, Dtw_Rows &rows)
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    size_t n = s.size;
+    size_t m = t.size;
+    if (n == 0 || m == 0)
+    {
+        return infinity;
+    }
+    size_t reach = (m + n - 1) / n;
+    band = std::min(std::max(band, reach), m);     // Wider than m changes nothing, and cannot overflow
+
+    rows.previous.assign(m + 1, infinity);
+    rows.current.assign(m + 1, infinity);
+    rows.cost.resize(m + 1);
+    rows.above.resize(m + 1);
+    float *previous = rows.previous.data();
+    float *current = rows.current.data();
+    float *cost = rows.cost.data();
+    float *above = rows.above.data();
+    previous[0] = 0;
+    size_t stale_lo = 0, stale_hi = 0;
+    size_t lo = 0, hi = 0;
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        size_t centre = (i * m + n / 2) / n;
+        size_t row_lo = centre > band ? std::max<size_t>(centre - band, 1) : 1;
+        size_t row_hi = std::min(centre + band, m);
+        for (size_t j = stale_lo; j <= stale_hi; ++j)
+        {
+            current[j] = infinity;
+        }
+        cost_row(s.x[i - 1], s.y[i - 1], s.z[i - 1], t, previous, row_lo, row_hi, cost, above);
+        float left = current[row_lo - 1];          // Cell to the left, carried in a register
+        for (size_t j = row_lo; j <= row_hi; ++j)
+        {
+            left = std::min(above[j], cost[j] + left);
+            current[j] = left;
+        }
+        std::swap(previous, current);
+        stale_lo = lo;
+        stale_hi = hi;
+        lo = row_lo;
+        hi = row_hi;
+    }
+    return previous[m];
+}
+
+// Corpus with the SoA copies the DTW kernel reads
+typedef struct
+{
+    const Corpus *corpus;
+    std::vector<Soa_Trace> rate;                   // Resampled rates
+    std::vector<uint8_t> path_memory;              // Arena storage of the path copies
+    std::vector<Dtw_Soa> path;                     // Rotation paths
+    std::vector<Dtw_Soa> path_reversed;            // Rotation paths, last sample first
+} Pair_Inputs;
+
+static void pair_inputs(Pair_Inputs &inputs, const Corpus &corpus)
+{
+    size_t count = corpus.templates.size();
+    inputs.corpus = &corpus;
+    inputs.rate.resize(count);
+    inputs.path.resize(count);
+    inputs.path_reversed.resize(count);
+    inputs.path_memory.resize(count * 2 * 3 * GESTURE_MAX_SAMPLES * sizeof(float) + 64);
+    BumpArena arena(inputs.path_memory.data(), inputs.path_memory.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        soa_from_trace(inputs.rate[i], corpus.templates[i].resampled);
+        dtw_soa_init(inputs.path[i], corpus.templates[i].path, false, arena);        // Sized above, cannot fail
+        dtw_soa_init(inputs.path_reversed[i], corpus.templates[i].path, true, arena);
+    }
+}
+
+// Scores of key i against record j, as matcher_score() computes them
+static void pair_scores(const Pair_Inputs &inputs, size_t i, size_t j, BumpArena &scratch, Dtw_Rows &rows,
+                        float score[MATCHER_COUNT])
+{
+    const Gesture_Template &key = inputs.corpus->templates[i];
+    const Gesture_Template &record = inputs.corpus->templates[j];
+    score[MATCHER_FEATURES] = matcher_score(MATCHER_FEATURES, key, record, scratch);
+    score[MATCHER_CORRELATION] = matcher_score(MATCHER_CORRELATION, key, record, scratch);
+    score[MATCHER_RATE_DTW] = pair_dtw(inputs.rate[i], inputs.rate[j], RATE_DTW_BAND, rows) /
+                              (float)(key.resampled.size + record.resampled.size);
+    score[MATCHER_DERIVATIVE_DTW] = matcher_score(MATCHER_DERIVATIVE_DTW, key, record, scratch);
+    score[MATCHER_ZNORM_DTW] = matcher_score(MATCHER_ZNORM_DTW, key, record, scratch);
+    score[MATCHER_PATH_DTW] = dtw_wavefront_soa(inputs.path[i], inputs.path_reversed[j], scratch) /
+                              (float)(key.path.size + record.path.size);
+}
+
+// Per-worker state
+typedef struct
+{
+    std::vector<uint8_t> memory;                   // Arena storage for the firmware matchers
+    Dtw_Rows rows;
+} Worker_Scratch;
+
+/*******************************************************************************
+ * Function: score_all_pairs
+ * -----------------------------------------------------------------------------
+ * Fills the MATCHER_COUNT count x count matrices at out, one task per tile of
+ * the upper triangle. Diagonal tiles cost half as much as the others, which
+ * the work stealing evens out.
+ ******************************************************************************/
+static void score_all_pairs(const Pair_Inputs &inputs, WorkPool &pool, float *out)
+{
+    size_t count = inputs.rate.size();
+    size_t tiles = (count + PAIRS_TILE - 1) / PAIRS_TILE;   // Tiles per side
+    std::vector<std::pair<uint32_t, uint32_t>> tasks;       // Upper-triangle tiles, row-major
+    for (size_t a = 0; a < tiles; a++)
+    {
+        for (size_t b = a; b < tiles; b++)
+        {
+            tasks.push_back({(uint32_t)a, (uint32_t)b});
+        }
+    }
+
+    std::vector<Worker_Scratch> scratch(pool.size());
+    for (Worker_Scratch &worker : scratch)
+    {
+        worker.memory.resize(4 * (GESTURE_MAX_SAMPLES + 1) * sizeof(float) + 64);
+    }
+
+    size_t plane = count * count;                            // Floats per matrix
+    pool.run(tasks.size(), [&](size_t task, unsigned w) {
+        BumpArena arena(scratch[w].memory.data(), scratch[w].memory.size());
+        size_t i_end = std::min((size_t)(tasks[task].first + 1) * PAIRS_TILE, count);
+        size_t j_end = std::min((size_t)(tasks[task].second + 1) * PAIRS_TILE, count);
+        for (size_t i = (size_t)tasks[task].first * PAIRS_TILE; i < i_end; i++)
+        {
+            for (size_t j = std::max(i, (size_t)tasks[task].second * PAIRS_TILE); j < j_end; j++)
+            {
+                float score[MATCHER_COUNT];
+                pair_scores(inputs, i, j, arena, scratch[w].rows, score);
+                for (int k = 0; k < MATCHER_COUNT; k++)
+                {
+                    out[k * plane + i * count + j] = score[k];
+                    out[k * plane + j * count + i] = score[k];
+                }
+            }
+        }
+    });
+}
+
+/*******************************************************************************
+ * Function: check_pairs
+ * -----------------------------------------------------------------------------
+ * Recomputes random pairs, in both orders, with the firmware's matcher_score()
+ * and compares the bits with the matrices.
+ *
+ * Returns:
+ *  - Number of scores that differ.
+ ******************************************************************************/
+static size_t check_pairs(const Corpus &corpus, const float *out, size_t samples, uint32_t seed)
+{
+    size_t count = corpus.templates.size();
+    size_t plane = count * count;
+    std::vector<uint8_t> memory(4 * (GESTURE_MAX_SAMPLES + 1) * sizeof(float) + 64);
+    BumpArena arena(memory.data(), memory.size());
+    std::mt19937 random(seed);
+    size_t mismatches = 0;
+    for (size_t n = 0; n < samples; n++)
+    {
+        size_t i = random() % count;
+        size_t j = random() % count;
+        for (int k = 0; k < MATCHER_COUNT; k++)
+        {
+            float device = matcher_score((Matcher_Id)k, corpus.templates[i], corpus.templates[j], arena);
+            float host = out[k * plane + i * count + j];
+            if (memcmp(&device, &host, sizeof(float)) != 0)
+            {
+                if (mismatches++ < 10)
+                {
+                    fprintf(stderr, "mismatch %s(%zu, %zu): device %.9g host %.9g\n",
+                            matcher_name((Matcher_Id)k), i, j, device, host);
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+/*******************************************************************************
+ * Function: matrix_map
+ * -----------------------------------------------------------------------------
+ * Creates the matrix file at its final size, writes the header and labels
+ * and maps it, so the workers store scores straight into the page cache.
+ *
+ * Returns:
+ *  - Start of the mapping, nullptr on failure; the first matrix is at
+ *    data_offset.
+ ******************************************************************************/
+static uint8_t *matrix_map(const char *path, const Corpus &corpus, size_t &length, uint32_t &data_offset)
+{
+    uint32_t count = (uint32_t)corpus.templates.size();
+    data_offset = (uint32_t)((sizeof(Matrix_Header) + count * sizeof(uint16_t) + 63) & ~(size_t)63);
+    length = data_offset + (size_t)MATCHER_COUNT * count * count * sizeof(float);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)length) != 0)
+    {
+        perror(path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return nullptr;
+    }
+    void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);                                     // The mapping keeps the file open
+    if (mapping == MAP_FAILED)
+    {
+        perror(path);
+        return nullptr;
+    }
+
+    uint8_t *base = (uint8_t *)mapping;
+    Matrix_Header header = {{'G', 'D', 'M', 'X'}, PAIRS_MATRIX_VERSION, MATCHER_COUNT, count, data_offset};
+    memcpy(base, &header, sizeof(header));         // The host is little-endian, like the format
+    memcpy(base + sizeof(header), corpus.labels.data(), count * sizeof(uint16_t));
+    return base;
+}
+
+/*******************************************************************************
+ * Function: bench_scaling
+ * -----------------------------------------------------------------------------
+ * Times the all-pairs run for growing corpus prefixes and thread counts, and
+ * the DTW kernel against the firmware dtw() on one thread.
+ ******************************************************************************/
+static void bench_scaling(const Corpus &corpus, unsigned max_threads)
+{
+    std::vector<unsigned> threads;
+    for (unsigned t = 1; t < max_threads; t *= 2)
+    {
+        threads.push_back(t);
+    }
+    threads.push_back(max_threads);
+
+    size_t count = corpus.templates.size();
+    printf("lanes: row kernel %d, wavefront %d\n",
+#if defined(__AVX2__)
+           8,
+#else
+           1,
+#endif
+           DTW_LANES);
+    printf("%9s %8s %12s %8s %8s\n", "captures", "threads", "pairs/s", "speedup", "steals");
+    for (size_t size = std::max<size_t>(count / 4, 1); size <= count; size *= 2)
+    {
+        Corpus prefix;
+        corpus_prefix(prefix, corpus, size);
+        Pair_Inputs inputs;
+        pair_inputs(inputs, prefix);
+        std::vector<float> out((size_t)MATCHER_COUNT * size * size);
+        double pairs = (double)size * (size + 1) / 2;        // Upper triangle with the diagonal
+        double single = 0;
+        for (unsigned t : threads)
+        {
+            WorkPool pool(t);
+            auto start = std::chrono::steady_clock::now();
+            score_all_pairs(inputs, pool, out.data());
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            single = t == 1 ? seconds : single;
+            printf("%9zu %8u %12.0f %8.2f %8zu\n", size, t, pairs / seconds, single / seconds, pool.steals());
+        }
+        if (size == count)
+        {
+            break;
+        }
+        if (size * 2 > count)
+        {
+            size = count / 2;                              // End on the full corpus
+        }
+    }
+
+    // Path DTW alone: wavefront kernel against the firmware's row-by-row dtw(), same pairs
+    Pair_Inputs inputs;
+    pair_inputs(inputs, corpus);
+    std::vector<uint8_t> memory(4 * (GESTURE_MAX_SAMPLES + 1) * sizeof(float) + 64);
+    BumpArena arena(memory.data(), memory.size());
+    size_t pairs = std::min<size_t>(count, 256);
+    std::vector<float> host(pairs), device(pairs);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t p = 0; p < pairs; p++)
+    {
+        host[p] = dtw_wavefront_soa(inputs.path[p], inputs.path_reversed[(p * 7 + 1) % count], arena);
+    }
+    double kernel = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (size_t p = 0; p < pairs; p++)
+    {
+        device[p] = dtw(corpus.templates[p].path, corpus.templates[(p * 7 + 1) % count].path, arena);
+    }
+    double firmware = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool identical = memcmp(host.data(), device.data(), pairs * sizeof(float)) == 0;
+    printf("path dtw: kernel %.1f us/pair, firmware %.1f us/pair, results %s\n",
+           kernel * 1e6 / pairs, firmware * 1e6 / pairs, identical ? "identical" : "DIFFER");
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: pairs (--corpus FILE | --synthetic N) [--output FILE] [--threads T]\n"
+            "             [--check PAIRS] [--seed S] [--bench]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *corpus_path = nullptr;
+    const char *output_path = "scores.gdm";
+    size_t synthetic = 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t check = PAIRS_CHECK;
+    uint32_t seed = 1;
+    bool bench = false;
+    for (int a = 1; a < argc; a++)
+    {
+        bool more = a + 1 < argc;
+        if (strcmp(argv[a], "--corpus") == 0 && more)
+        {
+            corpus_path = argv[++a];
+        }
+        else if (strcmp(argv[a], "--synthetic") == 0 && more)
+        {
+            synthetic = strtoul(argv[++a], nullptr, 10);
+        }
+        else if (strcmp(argv[a], "--output") == 0 && more)
+        {
+            output_path = argv[++a];
+        }
+        else if (strcmp(argv[a], "--threads") == 0 && more)
+        {
+            threads = std::max(1ul, strtoul(argv[++a], nullptr, 10));
+        }
+        else if (strcmp(argv[a], "--check") == 0 && more)
+        {
+            check = strtoul(argv[++a], nullptr, 10);
+        }
+        else if (strcmp(argv[a], "--seed") == 0 && more)
+        {
+            seed = (uint32_t)strtoul(argv[++a], nullptr, 10);
+        }
+        else if (strcmp(argv[a], "--bench") == 0)
+        {
+            bench = true;
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if ((corpus_path == nullptr) == (synthetic == 0))
+    {
+        usage();
+    }
+
+    Corpus corpus;
+    if (corpus_path != nullptr)
+    {
+        if (!corpus_load(corpus, corpus_path))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        corpus_synthetic(corpus, synthetic, seed);
+    }
+    if (corpus.templates.empty())
+    {
+        fprintf(stderr, "empty corpus\n");
+        return 1;
+    }
+
+    if (bench)
+    {
+        bench_scaling(corpus, threads);
+        return 0;
+    }
+
+    size_t length;
+    uint32_t data_offset;
+    uint8_t *mapping = matrix_map(output_path, corpus, length, data_offset);
+    if (mapping == nullptr)
+    {
+        return 1;
+    }
+    float *out = (float *)(mapping + data_offset);
+
+    Pair_Inputs inputs;
+    pair_inputs(inputs, corpus);
+    WorkPool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    score_all_pairs(inputs, pool, out);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t count = corpus.templates.size();
+    printf("%zu captures, %zu pairs on %u threads in %.2f s\n", count, count * (count + 1) / 2, pool.size(), seconds);
+
+    size_t mismatches = check_pairs(corpus, out, check, seed);
+    printf("checked %zu pairs against the firmware: %zu mismatches\n", check, mismatches);
+
+    msync(mapping, length, MS_SYNC);
+    munmap(mapping, length);
+    printf("wrote %s (%zu bytes, matrices at offset %u)\n", output_path, length, data_offset);
+    return mismatches == 0 ? 0 : 1;
+}
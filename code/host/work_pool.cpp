@@ -0,0 +1,99 @@
+#include <thread>                                // Include the worker threads
+#include <atomic>                                // Include the steal counter
+#include "work_pool.h"                           // Include the work pool header
+
+WorkPool::WorkPool(unsigned threads)
+    : workers(threads > 0 ? threads : 1), stolen(0), queues(workers), locks(workers)
+{
+}
+
+/*******************************************************************************
+ * Function: WorkPool::run
+ * -----------------------------------------------------------------------------
+ * Runs a batch on fresh worker threads; the calling thread only waits.
+ *
+ * Parameters:
+ *  - count: Number of tasks.
+ *  - task: Called with the task index and the worker number, below size(),
+ *          so it can use per-worker scratch without locking.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void WorkPool::run(size_t count, const std::function<void(size_t, unsigned)> &task)
+{
+    for (unsigned w = 0; w < workers; w++)
+    {
+        size_t first = count * w / workers;                     // Contiguous run of worker w
+        size_t last = count * (w + 1) / workers;
+        queues[w].clear();
+        for (size_t index = first; index < last; index++)
+        {
+            queues[w].push_back(index);
+        }
+    }
+
+    std::atomic<size_t> steal_count(0);
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < workers; w++)
+    {
+        threads.emplace_back([this, w, &task, &steal_count]() {
+            size_t index;
+            bool theft;                                         // Task came from another worker
+            while (take(w, index, theft))
+            {
+                task(index, w);
+                if (theft)
+                {
+                    steal_count.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    stolen = steal_count.load();
+}
+
+/*******************************************************************************
+ * Function: WorkPool::take
+ * -----------------------------------------------------------------------------
+ * Pops the next task of a worker: its own newest first, else the oldest task
+ * of the first other worker that has one.
+ *
+ * Parameters:
+ *  - worker: Worker asking for a task.
+ *  - index: Receives the task index.
+ *  - theft: Set if the task was stolen.
+ *
+ * Returns:
+ *  - false once every deque is empty.
+ ******************************************************************************/
+bool WorkPool::take(unsigned worker, size_t &index, bool &theft)
+{
+    {
+        std::lock_guard<std::mutex> guard(locks[worker]);
+        if (!queues[worker].empty())
+        {
+            index = queues[worker].back();
+            queues[worker].pop_back();
+            theft = false;
+            return true;
+        }
+    }
+    for (unsigned step = 1; step < workers; step++)
+    {
+        unsigned victim = (worker + step) % workers;            // Start with the neighbour, spread the thieves
+        std::lock_guard<std::mutex> guard(locks[victim]);
+        if (!queues[victim].empty())
+        {
+            index = queues[victim].front();
+            queues[victim].pop_front();
+            theft = true;
+            return true;
+        }
+    }
+    return false;
+}
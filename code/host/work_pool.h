@@ -0,0 +1,44 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stddef.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*******************************************************************************
+ * Class: WorkPool
+ * -----------------------------------------------------------------------------
+ * Work-stealing pool for batches of independent tasks of uneven cost.
+ *
+ * run() splits the task indices into one contiguous run per worker, so
+ * neighbouring tasks, which tend to share data, stay on one core. A worker
+ * takes tasks from the back of its own deque and, once that is empty, steals
+ * from the front of the others, where the tasks furthest from the owner's
+ * current position are. Tasks never spawn tasks, so a worker that finds every
+ * deque empty is done. Each deque has its own mutex; tasks are meant to be
+ * coarse (a tile of pair comparisons), so the locks are never contended in
+ * practice.
+ ******************************************************************************/
+class WorkPool
+{
+public:
+    explicit WorkPool(unsigned threads);
+
+    // Call task(index, worker) once for every index in [0, count) and wait for all of them
+    void run(size_t count, const std::function<void(size_t, unsigned)> &task);
+
+    unsigned size() const { return workers; }                   // Number of worker threads
+    size_t steals() const { return stolen; }                    // Tasks stolen during the last run
+
+private:
+    bool take(unsigned worker, size_t &index, bool &theft);
+
+    unsigned workers;                                           // Worker threads per run
+    size_t stolen;                                              // Tasks taken from another worker's deque
+    std::vector<std::deque<size_t>> queues;                     // Pending tasks per worker
+    std::vector<std::mutex> locks;                              // Guards for the deques
+};
+
+#endif
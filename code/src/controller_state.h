@@ -0,0 +1,61 @@
+#ifndef CONTROLLER_STATE_H
+#define CONTROLLER_STATE_H
+
+/*******************************************************************************
+ * Gesture controller states and the erase gate
+ *
+ * An erase request can arrive in any state, but a flash sector erase stalls
+ * the CPU with interrupts off, so it must not overlap calibration or a
+ * capture, and the matcher must not have the key pulled from under it. The
+ * gate holds a request made in those states, and the controller asks it on
+ * every state change whether the held erase is due, so no path out of a
+ * busy state can leave a stale request behind to wipe a key recorded later.
+ * The rules depend only on the states, so host/check_controller replays
+ * controller sequences against them.
+ ******************************************************************************/
+
+// States of the gesture controller
+typedef enum
+{
+    STATE_IDLE,                                   // Waiting for a record, unlock or erase request
+    STATE_CALIBRATING,                            // Capture thread is calibrating the gyroscope
+    STATE_CAPTURING,                              // Capture thread is recording the gesture
+    STATE_MATCHING,                               // Matcher thread is comparing the gesture to the key
+    STATE_RESULT                                  // Result is shown, new requests are accepted
+} Controller_State;
+
+// Erase request held while the controller is busy
+typedef struct
+{
+    bool pending;                                 // True when an erase waits for the busy state to end
+} Erase_Gate;
+
+// True while the gyroscope is sampling or the matcher reads the key
+static inline bool controller_busy(Controller_State state)
+{
+    return state == STATE_CALIBRATING || state == STATE_CAPTURING || state == STATE_MATCHING;
+}
+
+// Take an erase request; returns true if it may run now, false if it was held
+static inline bool erase_gate_request(Erase_Gate &gate, Controller_State state)
+{
+    if (controller_busy(state))
+    {
+        gate.pending = true;
+        return false;
+    }
+    return true;
+}
+
+// Enter a state; returns true if a held erase is due now and releases it
+static inline bool erase_gate_enter(Erase_Gate &gate, Controller_State state)
+{
+    if (!gate.pending || controller_busy(state))
+    {
+        return false;                                 // Nothing held, or still busy
+    }
+    gate.pending = false;
+    return true;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <math.h>
+#include "filter.h"
+
+/*******************************************************************************
+ * Class: PolyphaseDecimator
+ * -----------------------------------------------------------------------------
+ * Low-pass FIR and downsampler in one, for int16 samples.
+ *
+ * Only the kept outputs are computed. The RATIO * TAPS_PER_PHASE taps are
+ * stored phase-major, and every input is multiplied into the TAPS_PER_PHASE
+ * outputs it contributes to. Each sample then costs the same
+ * TAPS_PER_PHASE multiply-adds, with no burst when an output completes and no
+ * delay line. The coefficients are a Hamming-windowed sinc with its cutoff at
+ * 80% of the output Nyquist frequency, designed once at construction and
+ * scaled for unity DC gain.
+ *
+ * Template parameters:
+ *  - RATIO: Inputs per output.
+ *  - TAPS_PER_PHASE: Filter length in output samples; longer is sharper but
+ *    delays by RATIO * TAPS_PER_PHASE / 2 inputs.
+ ******************************************************************************/
+template <uint32_t RATIO, uint32_t TAPS_PER_PHASE>
+class PolyphaseDecimator
+{
+    static_assert(RATIO >= 2, "PolyphaseDecimator ratio must be at least 2");
+    static_assert(TAPS_PER_PHASE >= 2, "PolyphaseDecimator needs at least two taps per phase");
+
+public:
+    static const uint32_t length = RATIO * TAPS_PER_PHASE;
+    static const uint32_t cost = 4 * TAPS_PER_PHASE + 8;
+
+    PolyphaseDecimator()
+    {
+        design();
+        reset();
+    }
+
+    // Feed one input; returns true and sets y when an output is due
+    bool process(int16_t x, int16_t &y)
+    {
+        const int16_t *taps = coefficients[phase];       // Taps this input meets in each pending output
+        uint32_t slot = head;
+        for (uint32_t j = 0; j < TAPS_PER_PHASE; j++)
+        {
+            pending[slot] += (int32_t)taps[j] * x;
+            slot = slot + 1 == TAPS_PER_PHASE ? 0 : slot + 1;
+        }
+
+        if (phase != 0)
+        {
+            phase--;
+            return false;
+        }
+
+        y = filter_saturate((pending[head] + (1 << 14)) >> 15); // Round back from Q15
+        pending[head] = 0;                                      // Slot now collects the furthest output
+        head = head + 1 == TAPS_PER_PHASE ? 0 : head + 1;
+        phase = RATIO - 1;
+        return true;
+    }
+
+    void reset()
+    {
+        for (uint32_t j = 0; j < TAPS_PER_PHASE; j++)
+        {
+            pending[j] = 0;
+        }
+        head = 0;
+        phase = RATIO - 1;
+    }
+
+private:
+    // Windowed-sinc design, quantized to Q15 with the rounding error put on the centre tap
+    void design()
+    {
+        const float pi = 3.14159265f;
+        const float cutoff = 0.4f / RATIO;               // Cycles per input sample
+        const float centre = (length - 1) * 0.5f;
+        float h[length];
+        float sum = 0.0f;
+        for (uint32_t n = 0; n < length; n++)
+        {
+            float t = n - centre;
+            float sinc = t == 0.0f ? 2.0f * cutoff : sinf(2.0f * pi * cutoff * t) / (pi * t);
+            float window = 0.54f - 0.46f * cosf(2.0f * pi * n / (length - 1));
+            h[n] = sinc * window;
+            sum += h[n];
+        }
+
+        int32_t total = 0;                               // Sum of the quantized taps
+        for (uint32_t n = 0; n < length; n++)
+        {
+            int16_t q = (int16_t)lroundf(h[n] / sum * 32768.0f);
+            coefficients[n % RATIO][n / RATIO] = q;      // Tap n meets an input n % RATIO samples before an output
+            total += q;
+        }
+        coefficients[(length / 2) % RATIO][(length / 2) / RATIO] += (int16_t)(32768 - total);
+    }
+
+    int16_t coefficients[RATIO][TAPS_PER_PHASE];         // Taps grouped by input phase
+    int32_t pending[TAPS_PER_PHASE];                     // Partial sums of the outputs in flight
+    uint32_t head;                                       // Slot of the next output to complete
+    uint32_t phase;                                      // Inputs left before that output completes
+};
+
+#endif
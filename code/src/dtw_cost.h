@@ -0,0 +1,268 @@
+#ifndef DTW_COST_H
+#define DTW_COST_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include "gesture_arena.h"
+#include "gesture_trace.h"
+
+/*******************************************************************************
+ * Pluggable DTW cell costs.
+ *
+ * Every cost is a class exposing
+ *
+ *   static float distance(const Gesture_Sample &a, const Gesture_Sample &b);
+ *   static const uint32_t cost;   // estimated Cortex-M4 cycles per cell
+ *
+ * and dtw_with<Cost>() / dtw_banded_with<Cost>() take it as a template
+ * parameter, so the cost inlines into the inner loop with no call or branch
+ * per cell. Distances and thresholds are in the units of the cost: L2 and L1
+ * in the units of the samples, squared L2 in their square.
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Class: L2Cost
+ * -----------------------------------------------------------------------------
+ * Euclidean distance, the matcher's reference cost. The square root (VSQRT,
+ * 14 cycles on the M4) dominates.
+ ******************************************************************************/
+class L2Cost
+{
+public:
+    static const uint32_t cost = 22;
+
+    static float distance(const Gesture_Sample &a, const Gesture_Sample &b)
+    {
+        float sum = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            sum += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        return sqrtf(sum);
+    }
+};
+
+/*******************************************************************************
+ * Class: SquaredL2Cost
+ * -----------------------------------------------------------------------------
+ * Squared Euclidean distance. Same nearest neighbours per cell as L2 and no
+ * square root, but large differences weigh quadratically along the path, so
+ * it is more sensitive to a single outlying sample.
+ ******************************************************************************/
+class SquaredL2Cost
+{
+public:
+    static const uint32_t cost = 8;
+
+    static float distance(const Gesture_Sample &a, const Gesture_Sample &b)
+    {
+        float sum = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            sum += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        return sum;
+    }
+};
+
+/*******************************************************************************
+ * Class: L1Cost
+ * -----------------------------------------------------------------------------
+ * Manhattan distance; VABS is a single cycle on the M4.
+ ******************************************************************************/
+class L1Cost
+{
+public:
+    static const uint32_t cost = 8;
+
+    static float distance(const Gesture_Sample &a, const Gesture_Sample &b)
+    {
+        return fabsf(a[0] - b[0]) + fabsf(a[1] - b[1]) + fabsf(a[2] - b[2]);
+    }
+};
+
+/*******************************************************************************
+ * Class: FastL2Cost
+ * -----------------------------------------------------------------------------
+ * Euclidean distance with the square root approximated as x * rsqrt(x): the
+ * bit-level reciprocal square root estimate refined by one Newton step, within
+ * 0.2 % of the true value. Exactly 0 for identical samples.
+ ******************************************************************************/
+class FastL2Cost
+{
+public:
+    static const uint32_t cost = 15;
+
+    static float distance(const Gesture_Sample &a, const Gesture_Sample &b)
+    {
+        float sum = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            sum += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        uint32_t bits;
+        memcpy(&bits, &sum, sizeof(bits));
+        bits = 0x5f3759df - (bits >> 1);                     // Initial estimate of 1 / sqrt(sum)
+        float inverse;
+        memcpy(&inverse, &bits, sizeof(inverse));
+        inverse *= 1.5f - 0.5f * sum * inverse * inverse;    // One Newton step
+        return sum * inverse;
+    }
+};
+
+/*******************************************************************************
+ * Class: WeightedL2Cost
+ * -----------------------------------------------------------------------------
+ * Euclidean distance with a weight per axis, e.g. to trust the axis a gesture
+ * mostly rotates about more than the two that only pick up wobble.
+ *
+ * Template parameters:
+ *  - WX_Q8, WY_Q8, WZ_Q8: Weights of the squared axis differences in Q8
+ *    (256 is 1.0).
+ ******************************************************************************/
+template <int32_t WX_Q8, int32_t WY_Q8, int32_t WZ_Q8>
+class WeightedL2Cost
+{
+    static_assert(WX_Q8 >= 0 && WY_Q8 >= 0 && WZ_Q8 >= 0, "WeightedL2Cost weights must not be negative");
+
+public:
+    static const uint32_t cost = 25;
+
+    static float distance(const Gesture_Sample &a, const Gesture_Sample &b)
+    {
+        float dx = a[0] - b[0];
+        float dy = a[1] - b[1];
+        float dz = a[2] - b[2];
+        return sqrtf((WX_Q8 / 256.0f) * dx * dx + (WY_Q8 / 256.0f) * dy * dy + (WZ_Q8 / 256.0f) * dz * dz);
+    }
+};
+
+/*******************************************************************************
+ * Function: dtw_with
+ * -----------------------------------------------------------------------------
+ * DTW distance of two traces under the given cell cost, keeping only the
+ * previous and current rows of the matrix.
+ *
+ * Template parameters:
+ *  - Cost: One of the cost classes above.
+ *
+ * Parameters:
+ *  - s: First trace.
+ *  - t: Second trace.
+ *  - scratch: Arena providing two rows, released on return.
+ *
+ * Returns:
+ *  - DTW distance, infinity if scratch ran out.
+ ******************************************************************************/
+template <typename Cost>
+float dtw_with(const Gesture_Trace &s, const Gesture_Trace &t, BumpArena &scratch)
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    size_t mark = scratch.mark();                                // Scratch is released on return
+    float *previous = scratch.allocate<float>(t.size + 1);       // Row i - 1 of the DTW matrix
+    float *current = scratch.allocate<float>(t.size + 1);        // Row i of the DTW matrix
+    if (previous == nullptr || current == nullptr)
+    {
+        scratch.release(mark);                                   // Hand back a partial allocation
+        return infinity;                                         // No scratch left, treat as no match
+    }
+
+    for (size_t j = 0; j <= t.size; ++j)
+    {
+        previous[j] = infinity;                                  // Row 0 only reaches the origin
+    }
+    previous[0] = 0;
+
+    for (size_t i = 1; i <= s.size; ++i)
+    {
+        current[0] = infinity;                                   // Column 0 is unreachable after row 0
+        for (size_t j = 1; j <= t.size; ++j)
+        {
+            float cost = Cost::distance(s.samples[i - 1], t.samples[j - 1]);
+            current[j] = cost + std::min({previous[j], current[j - 1], previous[j - 1]});
+        }
+        std::swap(previous, current);                            // Row i becomes the previous row
+    }
+
+    float distance = previous[t.size];
+    scratch.release(mark);
+    return distance;
+}
+
+/*******************************************************************************
+ * Function: dtw_banded_with
+ * -----------------------------------------------------------------------------
+ * DTW distance restricted to a Sakoe-Chiba band, see dtw_banded().
+ *
+ * Template parameters:
+ *  - Cost: One of the cost classes above.
+ *
+ * Parameters:
+ *  - s: First trace.
+ *  - t: Second trace.
+ *  - band: Largest distance in samples of t from the scaled diagonal.
+ *  - scratch: Arena providing two rows, released on return.
+ *
+ * Returns:
+ *  - Banded DTW distance, infinity if a trace is empty or scratch ran out.
+ ******************************************************************************/
+template <typename Cost>
+float dtw_banded_with(const Gesture_Trace &s, const Gesture_Trace &t, size_t band, BumpArena &scratch)
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    size_t n = s.size;                                           // Rows
+    size_t m = t.size;                                           // Columns
+    if (n == 0 || m == 0)
+    {
+        return infinity;                                         // Nothing to align
+    }
+    size_t reach = (m + n - 1) / n;                              // Columns the diagonal advances per row
+    band = std::max(band, reach);
+
+    size_t mark = scratch.mark();                                // Scratch is released on return
+    float *previous = scratch.allocate<float>(m + 1);            // Row i - 1 of the DTW matrix
+    float *current = scratch.allocate<float>(m + 1);             // Row i of the DTW matrix
+    if (previous == nullptr || current == nullptr)
+    {
+        scratch.release(mark);                                   // Hand back a partial allocation
+        return infinity;                                         // No scratch left, treat as no match
+    }
+    for (size_t j = 0; j <= m; ++j)
+    {
+        previous[j] = infinity;
+        current[j] = infinity;
+    }
+    previous[0] = 0;                                             // Row 0 only reaches the origin
+    size_t stale_lo = 0, stale_hi = 0;                           // Window of the row current held last
+    size_t lo = 0, hi = 0;                                       // Window of the row previous holds
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        size_t centre = (i * m + n / 2) / n;                     // Diagonal column of row i
+        size_t row_lo = centre > band ? std::max<size_t>(centre - band, 1) : 1;
+        size_t row_hi = std::min(centre + band, m);
+        for (size_t j = stale_lo; j <= stale_hi; ++j)
+        {
+            current[j] = infinity;                               // Forget the row two back
+        }
+        for (size_t j = row_lo; j <= row_hi; ++j)
+        {
+            float cost = Cost::distance(s.samples[i - 1], t.samples[j - 1]);
+            current[j] = cost + std::min({previous[j], current[j - 1], previous[j - 1]});
+        }
+        std::swap(previous, current);                            // Row i becomes the previous row
+        stale_lo = lo;
+        stale_hi = hi;
+        lo = row_lo;
+        hi = row_hi;
+    }
+
+    float distance = previous[m];                                // Final DTW distance
+    scratch.release(mark);                                       // Release the scratch rows
+    return distance;
+}
+
+#endif
@@ -0,0 +1,251 @@
+#include <math.h>                                // Include sqrtf
+#include <limits>                                // Include infinity
+#include "dtw_wavefront.h"                       // Include the wavefront DTW header
+
+#if DTW_LANES == 8
+#include <immintrin.h>                           // Include AVX2
+
+// DTW_LANES floats in one register
+typedef __m256 Lanes;
+static inline Lanes lanes_load(const float *p) { return _mm256_loadu_ps(p); }
+static inline void lanes_store(float *p, Lanes v) { _mm256_storeu_ps(p, v); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes lanes_min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+static inline Lanes lanes_sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+#elif DTW_LANES == 4 && defined(__SSE2__)
+#include <emmintrin.h>                           // Include SSE2
+
+typedef __m128 Lanes;
+static inline Lanes lanes_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void lanes_store(float *p, Lanes v) { _mm_storeu_ps(p, v); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes lanes_min(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+static inline Lanes lanes_sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+#elif DTW_LANES == 4
+#include <arm_neon.h>                            // Include AArch64 NEON
+
+typedef float32x4_t Lanes;
+static inline Lanes lanes_load(const float *p) { return vld1q_f32(p); }
+static inline void lanes_store(float *p, Lanes v) { vst1q_f32(p, v); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+static inline Lanes lanes_min(Lanes a, Lanes b) { return vminq_f32(a, b); }
+static inline Lanes lanes_sqrt(Lanes a) { return vsqrtq_f32(a); }
+#endif
+
+// Squared distance of one pair, in the operation order of euclidean_distance()
+static inline float squared_distance(float ax, float ay, float az, float bx, float by, float bz)
+{
+    float dx = ax - bx;
+    float dy = ay - by;
+    float dz = az - bz;
+    float sum = dx * dx + dy * dy;
+    return sum + dz * dz;
+}
+
+/*******************************************************************************
+ * Function: dtw_soa_init
+ * -----------------------------------------------------------------------------
+ * Copies a trace into three coordinate arrays carved from the arena.
+ *
+ * Parameters:
+ *  - soa: Receives the arrays.
+ *  - trace: Trace to copy.
+ *  - reversed: Store the last sample first.
+ *  - arena: Arena providing the storage; the caller releases it.
+ *
+ * Returns:
+ *  - false if the arena is exhausted.
+ ******************************************************************************/
+bool dtw_soa_init(Dtw_Soa &soa, const Gesture_Trace &trace, bool reversed, BumpArena &arena)
+{
+    soa.x = arena.allocate<float>(trace.size);
+    soa.y = arena.allocate<float>(trace.size);
+    soa.z = arena.allocate<float>(trace.size);
+    soa.size = trace.size;
+    if (soa.x == nullptr || soa.y == nullptr || soa.z == nullptr)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < trace.size; i++)
+    {
+        size_t k = reversed ? trace.size - 1 - i : i;   // Destination of sample i
+        soa.x[k] = trace.samples[i][0];
+        soa.y[k] = trace.samples[i][1];
+        soa.z[k] = trace.samples[i][2];
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function: dtw_squared_distance
+ * -----------------------------------------------------------------------------
+ * Squared Euclidean distances from one sample to a run of SoA samples, in
+ * DTW_LANES wide steps.
+ *
+ * Parameters:
+ *  - x, y, z: The sample.
+ *  - tx, ty, tz: Coordinates of the run.
+ *  - count: Length of the run.
+ *  - out: Receives count squared distances.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void dtw_squared_distance(float x, float y, float z, const float *tx, const float *ty, const float *tz,
+                          size_t count, float *out)
+{
+    size_t k = 0;
+#if DTW_LANES > 1
+    float bx[DTW_LANES], by[DTW_LANES], bz[DTW_LANES];
+    for (int lane = 0; lane < DTW_LANES; lane++)
+    {
+        bx[lane] = x;
+        by[lane] = y;
+        bz[lane] = z;
+    }
+    Lanes vx = lanes_load(bx), vy = lanes_load(by), vz = lanes_load(bz);
+    for (; k + DTW_LANES <= count; k += DTW_LANES)
+    {
+        Lanes dx = lanes_sub(vx, lanes_load(&tx[k]));
+        Lanes dy = lanes_sub(vy, lanes_load(&ty[k]));
+        Lanes dz = lanes_sub(vz, lanes_load(&tz[k]));
+        lanes_store(&out[k], lanes_add(lanes_add(lanes_mul(dx, dx), lanes_mul(dy, dy)), lanes_mul(dz, dz)));
+    }
+#endif
+    for (; k < count; k++)
+    {
+        out[k] = squared_distance(x, y, z, tx[k], ty[k], tz[k]);
+    }
+}
+
+/*******************************************************************************
+ * Function: dtw_diagonal
+ * -----------------------------------------------------------------------------
+ * Evaluates count consecutive cells of one anti-diagonal:
+ *
+ *   out[k] = sqrt(|s_k - t_k|^2) + min(up[k], left[k], corner[k])
+ *
+ * where s and t point at the first cell's samples and advance together.
+ ******************************************************************************/
+static void dtw_diagonal(const float *sx, const float *sy, const float *sz, const float *tx, const float *ty,
+                         const float *tz, const float *up, const float *left, const float *corner, float *out,
+                         size_t count)
+{
+    size_t k = 0;
+#if DTW_LANES > 1
+    for (; k + DTW_LANES <= count; k += DTW_LANES)
+    {
+        Lanes dx = lanes_sub(lanes_load(&sx[k]), lanes_load(&tx[k]));
+        Lanes dy = lanes_sub(lanes_load(&sy[k]), lanes_load(&ty[k]));
+        Lanes dz = lanes_sub(lanes_load(&sz[k]), lanes_load(&tz[k]));
+        Lanes squared = lanes_add(lanes_add(lanes_mul(dx, dx), lanes_mul(dy, dy)), lanes_mul(dz, dz));
+        Lanes best = lanes_min(lanes_min(lanes_load(&up[k]), lanes_load(&left[k])), lanes_load(&corner[k]));
+        lanes_store(&out[k], lanes_add(lanes_sqrt(squared), best));
+    }
+#endif
+    for (; k < count; k++)
+    {
+        float best = up[k] < left[k] ? up[k] : left[k];
+        best = corner[k] < best ? corner[k] : best;
+        out[k] = sqrtf(squared_distance(sx[k], sy[k], sz[k], tx[k], ty[k], tz[k])) + best;
+    }
+}
+
+/*******************************************************************************
+ * Function: dtw_wavefront_soa
+ * -----------------------------------------------------------------------------
+ * Fills the DTW matrix one anti-diagonal d = i + j at a time, keeping the
+ * last three diagonals indexed by row. Cell (i, j) reads (i - 1, j) and
+ * (i, j - 1) from diagonal d - 1 at indices i - 1 and i, and (i - 1, j - 1)
+ * from diagonal d - 2 at index i - 1. After each diagonal the entries just
+ * outside its row range are set to infinity; later diagonals read no further
+ * out, so stale values from three diagonals back are never seen.
+ *
+ * Parameters:
+ *  - s: First trace.
+ *  - t_reversed: Second trace, last sample first.
+ *  - scratch: Arena providing three diagonals, released on return.
+ *
+ * Returns:
+ *  - DTW distance, infinity if either trace is empty or scratch ran out.
+ ******************************************************************************/
+float dtw_wavefront_soa(const Dtw_Soa &s, const Dtw_Soa &t_reversed, BumpArena &scratch)
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    size_t n = s.size;
+    size_t m = t_reversed.size;
+    if (n == 0 || m == 0)
+    {
+        return infinity;
+    }
+
+    size_t mark = scratch.mark();                               // Scratch is released on return
+    float *corner = scratch.allocate<float>(n + 2);             // Diagonal d - 2
+    float *edge = scratch.allocate<float>(n + 2);               // Diagonal d - 1
+    float *front = scratch.allocate<float>(n + 2);              // Diagonal d
+    if (corner == nullptr || edge == nullptr || front == nullptr)
+    {
+        scratch.release(mark);
+        return infinity;
+    }
+    for (size_t i = 0; i < n + 2; i++)
+    {
+        corner[i] = infinity;
+        edge[i] = infinity;
+        front[i] = infinity;
+    }
+    corner[0] = 0;                                              // Diagonal 0 is the origin
+
+    for (size_t d = 2; d <= n + m; d++)
+    {
+        size_t lo = d > m ? d - m : 1;                          // First row on the diagonal
+        size_t hi = d - 1 < n ? d - 1 : n;                      // Last row on the diagonal
+        size_t r = m + lo - d;                                  // Reversed index of t[d - lo - 1]
+        dtw_diagonal(&s.x[lo - 1], &s.y[lo - 1], &s.z[lo - 1],
+                     &t_reversed.x[r], &t_reversed.y[r], &t_reversed.z[r],
+                     &edge[lo - 1], &edge[lo], &corner[lo - 1], &front[lo], hi - lo + 1);
+        front[lo - 1] = infinity;                               // Guard the row range
+        front[hi + 1] = infinity;
+
+        float *oldest = corner;                                 // Rotate the diagonals
+        corner = edge;
+        edge = front;
+        front = oldest;
+    }
+
+    float distance = edge[n];                                   // Cell (n, m) on the last diagonal
+    scratch.release(mark);
+    return distance;
+}
+
+/*******************************************************************************
+ * Function: dtw_wavefront
+ * -----------------------------------------------------------------------------
+ * Transposes both traces into scratch and runs dtw_wavefront_soa().
+ *
+ * Parameters:
+ *  - s: First trace.
+ *  - t: Second trace.
+ *  - scratch: Arena providing the SoA copies and diagonals, released on return.
+ *
+ * Returns:
+ *  - Same distance as dtw(s, t, scratch).
+ ******************************************************************************/
+float dtw_wavefront(const Gesture_Trace &s, const Gesture_Trace &t, BumpArena &scratch)
+{
+    size_t mark = scratch.mark();
+    Dtw_Soa a, b;
+    float distance = std::numeric_limits<float>::infinity();
+    if (dtw_soa_init(a, s, false, scratch) && dtw_soa_init(b, t, true, scratch))
+    {
+        distance = dtw_wavefront_soa(a, b, scratch);
+    }
+    scratch.release(mark);
+    return distance;
+}
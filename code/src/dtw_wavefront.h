@@ -0,0 +1,60 @@
+#ifndef DTW_WAVEFRONT_H
+#define DTW_WAVEFRONT_H
+
+#include <stddef.h>
+#include "gesture_arena.h"
+#include "gesture_trace.h"
+
+/*******************************************************************************
+ * Anti-diagonal DTW
+ *
+ * dtw() fills the cost matrix row by row, and every cell waits for its left
+ * neighbour. The cells of one anti-diagonal (i + j constant) only depend on
+ * the two diagonals before it, so a whole diagonal can be evaluated in SIMD
+ * lanes: 8 with AVX2, 4 with SSE2 or AArch64 NEON. Diagonals are indexed by
+ * the row i. The second trace is stored reversed, so t[j - 1] = t[d - i - 1]
+ * is contiguous in i like s[i - 1].
+ *
+ * Inputs are structure-of-arrays and the per-cell cost comes from a squared
+ * distance kernel followed by one vector square root. Each lane evaluates
+ * exactly the scalar expression of euclidean_distance() with no fused
+ * multiply-adds, and min() is exact, so the result is bit-identical to dtw()
+ * on every target.
+ *
+ * The Cortex-M4 has no floating-point SIMD: its packed DSP instructions only
+ * work on 8- and 16-bit integers, which would need quantized costs and change
+ * the scores. The target build therefore runs the same kernel one lane wide
+ * and keeps dtw() for matching.
+ ******************************************************************************/
+
+#if defined(__AVX2__)
+#define DTW_LANES 8
+#elif defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define DTW_LANES 4
+#else
+#define DTW_LANES 1
+#endif
+
+// A trace as three coordinate arrays
+typedef struct
+{
+    float *x;                      // First coordinate of every sample
+    float *y;                      // Second coordinate
+    float *z;                      // Third coordinate
+    size_t size;                   // Number of samples
+} Dtw_Soa;
+
+// Transpose a trace into arena storage, optionally reversed; returns false when the arena is exhausted
+bool dtw_soa_init(Dtw_Soa &soa, const Gesture_Trace &trace, bool reversed, BumpArena &arena);
+
+// Squared Euclidean distances between one sample and count SoA samples
+void dtw_squared_distance(float x, float y, float z, const float *tx, const float *ty, const float *tz,
+                          size_t count, float *out);
+
+// DTW distance of two SoA traces, t reversed, evaluated by anti-diagonals
+float dtw_wavefront_soa(const Dtw_Soa &s, const Dtw_Soa &t_reversed, BumpArena &scratch);
+
+// DTW distance of two gesture traces, bit-identical to dtw(), using arena scratch
+float dtw_wavefront(const Gesture_Trace &s, const Gesture_Trace &t, BumpArena &scratch);
+
+#endif
@@ -0,0 +1,355 @@
+#include <math.h>                                // Include expf, logf and sqrtf
+#include <limits>                                // Include quiet_NaN
+#include "ensemble.h"                            // Include the ensemble header
+#include "matcher.h"                             // Include the individual matchers
+#include "profiler.h"                            // Include the cycle counter
+
+const Ensemble_Model ensemble_default_model = {
+    ENSEMBLE_BIAS,
+    {ENSEMBLE_WEIGHT_FEATURES, ENSEMBLE_WEIGHT_CORRELATION, ENSEMBLE_WEIGHT_RATE_DTW, ENSEMBLE_WEIGHT_DERIVATIVE_DTW,
+     ENSEMBLE_WEIGHT_ZNORM_DTW, ENSEMBLE_WEIGHT_PATH_DTW},
+    {FEATURE_THRESHOLD, CORRELATION_THRESHOLD, RATE_DTW_THRESHOLD, DERIVATIVE_DTW_THRESHOLD, ZNORM_DTW_THRESHOLD,
+     DTW_THRESHOLD},
+    ENSEMBLE_DECISION,
+};
+
+static const char *const matcher_names[MATCHER_COUNT] = {
+    "features", "correlation", "rate_dtw", "derivative_dtw", "znorm_dtw", "path_dtw",
+};
+
+// Profiler probe each matcher is recorded under
+static const Profile_Probe matcher_probes[MATCHER_COUNT] = {
+    PROBE_FEATURES, PROBE_CORRELATION, PROBE_RATE_DTW, PROBE_DERIVATIVE_DTW, PROBE_ZNORM_DTW, PROBE_DTW,
+};
+
+// Clamped logit term of one score; a missing score counts as strongly against a match
+static float ensemble_term(const Ensemble_Model &model, int i, float score)
+{
+    if (isnan(score))
+    {
+        return -ENSEMBLE_TERM_LIMIT;
+    }
+    float term = model.weight[i] * (score - model.offset[i]);
+    if (term > ENSEMBLE_TERM_LIMIT)
+    {
+        return ENSEMBLE_TERM_LIMIT;
+    }
+    if (term < -ENSEMBLE_TERM_LIMIT || isnan(term))             // Infinite distance times a weight
+    {
+        return -ENSEMBLE_TERM_LIMIT;
+    }
+    return term;
+}
+
+// Logit at which the fused probability equals the decision probability
+static float ensemble_boundary(const Ensemble_Model &model)
+{
+    return logf(model.decision / (1.0f - model.decision));
+}
+
+/*******************************************************************************
+ * Function: matcher_name
+ * -----------------------------------------------------------------------------
+ * Returns the short name of a matcher.
+ *
+ * Parameters:
+ *  - id: Matcher.
+ *
+ * Returns:
+ *  - Name with static storage.
+ ******************************************************************************/
+const char *matcher_name(Matcher_Id id)
+{
+    return id < MATCHER_COUNT ? matcher_names[id] : "?";
+}
+
+/*******************************************************************************
+ * Function: matcher_score
+ * -----------------------------------------------------------------------------
+ * Runs one matcher. Both templates must be finalized. The DTW scores are
+ * divided by the longest possible warping path, so they are comparable across
+ * gesture lengths.
+ *
+ * Parameters:
+ *  - id: Matcher to run.
+ *  - key: Stored gesture key.
+ *  - record: Gesture to score.
+ *  - scratch: Arena providing DTW scratch, released on return.
+ *
+ * Returns:
+ *  - Raw score; NaN if it is undefined, e.g. the correlation of a flat axis.
+ ******************************************************************************/
+float matcher_score(Matcher_Id id, const Gesture_Template &key, const Gesture_Template &record, BumpArena &scratch)
+{
+    switch (id)
+    {
+    case MATCHER_FEATURES:
+        return features_distance(key.features, record.features);
+
+    case MATCHER_CORRELATION:
+    {
+        std::array<float, 3> correlation = calculateCorrelationVectors(key.resampled, record.resampled);
+        float weakest = correlation[0];
+        for (int axis = 1; axis < 3; axis++)
+        {
+            if (isnan(correlation[axis]) || correlation[axis] < weakest)
+            {
+                weakest = correlation[axis];                     // NaN sticks once seen
+            }
+        }
+        return weakest;
+    }
+
+    case MATCHER_RATE_DTW:
+        return dtw_banded(key.resampled, record.resampled, RATE_DTW_BAND, scratch) /
+               (float)(key.resampled.size + record.resampled.size);
+
+    case MATCHER_DERIVATIVE_DTW:
+        return dtw_derivative(key.resampled, record.resampled, RATE_DTW_BAND, scratch) /
+               (float)(key.resampled.size + record.resampled.size);
+
+    case MATCHER_ZNORM_DTW:
+        return dtw_znormalized(key.resampled, key.features, record.resampled, record.features, RATE_DTW_BAND, scratch) /
+               (float)(key.resampled.size + record.resampled.size);
+
+    case MATCHER_PATH_DTW:
+        return dtw(key.path, record.path, scratch) / (float)(key.path.size + record.path.size);
+
+    default:
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+}
+
+/*******************************************************************************
+ * Function: ensemble_match
+ * -----------------------------------------------------------------------------
+ * Runs the enabled matchers in Matcher_Id order, timing each one, and fuses
+ * their scores. Before each matcher the logit is compared to the decision
+ * boundary: once it lies further away than the remaining matchers' terms can
+ * reach, the verdict is settled and the rest are skipped.
+ *
+ * Parameters:
+ *  - model: Fusion coefficients.
+ *  - key: Stored gesture key.
+ *  - record: Gesture to score.
+ *  - scratch: Arena providing DTW scratch.
+ *  - result: Receives scores, terms, timings and the verdict.
+ *
+ * Returns:
+ *  - true if the record matches the key.
+ ******************************************************************************/
+bool ensemble_match(const Ensemble_Model &model, const Gesture_Template &key, const Gesture_Template &record,
+                    BumpArena &scratch, Ensemble_Result &result)
+{
+    float boundary = ensemble_boundary(model);                   // Logit of the decision probability
+    float reach = 0;                                             // Largest swing the remaining matchers can add
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        result.score[i] = std::numeric_limits<float>::quiet_NaN();
+        result.contribution[i] = 0;
+        result.cycles[i] = 0;
+        reach += model.weight[i] != 0 ? ENSEMBLE_TERM_LIMIT : 0;
+    }
+    result.run = 0;
+    result.logit = model.bias;
+
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        if (model.weight[i] == 0)
+        {
+            continue;                                            // Disabled
+        }
+        if (fabsf(result.logit - boundary) > reach)
+        {
+            break;                                               // The verdict can no longer change
+        }
+        uint32_t start = profiler_cycles();
+        result.score[i] = matcher_score((Matcher_Id)i, key, record, scratch);
+        result.cycles[i] = profiler_cycles() - start;
+#if PROFILER_ENABLED
+        profiler_record(matcher_probes[i], result.cycles[i]);
+#endif
+        result.contribution[i] = ensemble_term(model, i, result.score[i]);
+        result.logit += result.contribution[i];
+        result.run |= 1u << i;
+        reach -= ENSEMBLE_TERM_LIMIT;
+    }
+
+    result.probability = 1.0f / (1.0f + expf(-result.logit));
+    result.match = result.logit >= boundary;
+    return result.match;
+}
+
+/*******************************************************************************
+ * Function: ensemble_pivotal
+ * -----------------------------------------------------------------------------
+ * Tells whether a matcher decided the verdict: removing its term moves the
+ * logit to the other side of the decision boundary. A matcher that is rarely
+ * pivotal only adds latency.
+ *
+ * Parameters:
+ *  - model: Model the result was fused with.
+ *  - result: Fused result.
+ *  - id: Matcher to test.
+ *
+ * Returns:
+ *  - true if the verdict depends on the matcher.
+ ******************************************************************************/
+bool ensemble_pivotal(const Ensemble_Model &model, const Ensemble_Result &result, Matcher_Id id)
+{
+    if (!(result.run & (1u << id)))
+    {
+        return false;
+    }
+    return ensemble_accepts(model, result.logit - result.contribution[id]) != result.match;
+}
+
+/*******************************************************************************
+ * Function: ensemble_logit
+ * -----------------------------------------------------------------------------
+ * Fuses a complete score vector, as ensemble_match() would with every enabled
+ * matcher run. Host tools use it to evaluate a model on scores computed
+ * once, without running the matchers again.
+ *
+ * Parameters:
+ *  - model: Fusion coefficients.
+ *  - score: Raw score per matcher.
+ *
+ * Returns:
+ *  - Fused logit; the record matches when it reaches the decision boundary.
+ ******************************************************************************/
+float ensemble_logit(const Ensemble_Model &model, const float score[MATCHER_COUNT])
+{
+    float logit = model.bias;
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        if (model.weight[i] != 0)
+        {
+            logit += ensemble_term(model, i, score[i]);
+        }
+    }
+    return logit;
+}
+
+/*******************************************************************************
+ * Function: ensemble_accepts
+ * -----------------------------------------------------------------------------
+ * Applies the model's decision to a fused logit.
+ *
+ * Parameters:
+ *  - model: Fusion coefficients.
+ *  - logit: Fused logit, e.g. from ensemble_logit().
+ *
+ * Returns:
+ *  - true if the logit is on the match side of the decision boundary.
+ ******************************************************************************/
+bool ensemble_accepts(const Ensemble_Model &model, float logit)
+{
+    return logit >= ensemble_boundary(model);
+}
+
+/*******************************************************************************
+ * Function: ensemble_fit
+ * -----------------------------------------------------------------------------
+ * Calibrates the model on scored attempts with known labels, e.g. a corpus
+ * scored on the host with every matcher enabled. Batch gradient descent on
+ * the log loss runs on standardized inputs, so one learning rate suits
+ * scores in dps and in radians alike, and the result is mapped back to raw
+ * weights. The clamp of each term is ignored while fitting. Each weight keeps
+ * the sign it starts with: when correlated matchers would pull one of them
+ * past zero, it stops at 0 instead, and a matcher fitted to 0 no longer runs.
+ * Disabled matchers stay disabled; offsets and the decision probability are
+ * kept.
+ *
+ * Parameters:
+ *  - model: Model to calibrate in place.
+ *  - scores: Raw scores per attempt, all finite.
+ *  - genuine: Label per attempt, true for the key's owner.
+ *  - count: Number of attempts.
+ *  - iterations: Gradient steps.
+ *  - rate: Learning rate, around 0.5 for standardized inputs.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void ensemble_fit(Ensemble_Model &model, const float (*scores)[MATCHER_COUNT], const bool *genuine, size_t count,
+                  uint32_t iterations, float rate)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Mean and spread of each input, relative to its offset
+    float mean[MATCHER_COUNT] = {0};
+    float spread[MATCHER_COUNT] = {0};
+    for (size_t n = 0; n < count; n++)
+    {
+        for (int i = 0; i < MATCHER_COUNT; i++)
+        {
+            mean[i] += scores[n][i] - model.offset[i];
+        }
+    }
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        mean[i] /= (float)count;
+    }
+    for (size_t n = 0; n < count; n++)
+    {
+        for (int i = 0; i < MATCHER_COUNT; i++)
+        {
+            float d = scores[n][i] - model.offset[i] - mean[i];
+            spread[i] += d * d;
+        }
+    }
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        spread[i] = sqrtf(spread[i] / (float)count);
+        spread[i] = spread[i] > 0 ? spread[i] : 1.0f;            // Constant input, nothing to learn
+    }
+
+    // Fit on standardized inputs
+    float bias = 0;
+    float weight[MATCHER_COUNT] = {0};
+    for (uint32_t step = 0; step < iterations; step++)
+    {
+        float bias_gradient = 0;
+        float gradient[MATCHER_COUNT] = {0};
+        for (size_t n = 0; n < count; n++)
+        {
+            float z[MATCHER_COUNT];                              // Standardized inputs of attempt n
+            float logit = bias;
+            for (int i = 0; i < MATCHER_COUNT; i++)
+            {
+                z[i] = (scores[n][i] - model.offset[i] - mean[i]) / spread[i];
+                logit += weight[i] * z[i];
+            }
+            float error = 1.0f / (1.0f + expf(-logit)) - (genuine[n] ? 1.0f : 0.0f);
+            bias_gradient += error;
+            for (int i = 0; i < MATCHER_COUNT; i++)
+            {
+                gradient[i] += error * z[i];
+            }
+        }
+        bias -= rate * bias_gradient / (float)count;
+        for (int i = 0; i < MATCHER_COUNT; i++)
+        {
+            if (model.weight[i] != 0)
+            {
+                weight[i] -= rate * gradient[i] / (float)count;
+                if (weight[i] * model.weight[i] < 0)
+                {
+                    weight[i] = 0;                               // Never argue against the matcher's own sense
+                }
+            }
+        }
+    }
+
+    // Map back to raw scores relative to the offsets
+    model.bias = bias;
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        model.weight[i] = weight[i] / spread[i];
+        model.bias -= model.weight[i] * mean[i];
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gesture_arena.h"
+#include "gesture_template.h"
+
+/*******************************************************************************
+ * Matcher ensemble
+ *
+ * Every matcher reduces a key and a record to one score. A logistic model
+ * fuses the scores:
+ *
+ *   logit = bias + sum_i weight_i * (score_i - offset_i)
+ *   p     = 1 / (1 + exp(-logit))
+ *
+ * and the record matches when p reaches the model's decision probability.
+ * Each term is clamped to +-ENSEMBLE_TERM_LIMIT, so the matchers run from
+ * cheapest to dearest and stop as soon as the remaining ones can no longer
+ * move the logit across the decision boundary. A matcher with weight 0 never
+ * runs, which is how one that does not pay for itself is dropped.
+ *
+ * The matchers are independent functions of the same two templates, so host
+ * tools can run them in any order or in batches; on the single-core target
+ * they run back to back in the caller's thread.
+ ******************************************************************************/
+
+// Largest magnitude of one matcher's term in the logit
+#define ENSEMBLE_TERM_LIMIT 8.0f
+
+// Default model, set by hand and centred on the matcher thresholds, with every matcher enabled; the
+// derivative and z-normalized DTW thresholds sit at the equal error point of the synthetic corpus.
+// Replace it only with host/build/fit output for a recorded corpus
+#define ENSEMBLE_BIAS 0.0f
+#define ENSEMBLE_WEIGHT_FEATURES -10.0f        // Per unit of embedding distance
+#define ENSEMBLE_WEIGHT_CORRELATION 4.0f       // Per unit of the weakest axis correlation
+#define ENSEMBLE_WEIGHT_RATE_DTW -0.2f         // Per dps of banded rate DTW per step
+#define ENSEMBLE_WEIGHT_DERIVATIVE_DTW -2.0f   // Per dps per sample of banded derivative DTW per step
+#define ENSEMBLE_WEIGHT_ZNORM_DTW -20.0f       // Per standard deviation of banded z-normalized DTW per step
+#define ENSEMBLE_WEIGHT_PATH_DTW -20.0f        // Per radian of path DTW per step
+#define ENSEMBLE_DECISION 0.5f                 // Probability at which a record matches
+
+// Matchers in the order they run
+typedef enum
+{
+    MATCHER_FEATURES,              // Embedding distance, lower is closer
+    MATCHER_CORRELATION,           // Weakest per-axis correlation of the resampled traces, higher is closer
+    MATCHER_RATE_DTW,              // Banded DTW of the resampled rates per warping step, lower is closer
+    MATCHER_DERIVATIVE_DTW,        // Banded DTW of the derivatives of the resampled rates per warping step, lower is closer
+    MATCHER_ZNORM_DTW,             // Banded DTW of the z-normalized resampled rates per warping step, lower is closer
+    MATCHER_PATH_DTW,              // DTW of the rotation paths per warping step, lower is closer
+    MATCHER_COUNT
+} Matcher_Id;
+
+// Logistic fusion coefficients
+typedef struct
+{
+    float bias;                    // Logit with every score at its offset
+    float weight[MATCHER_COUNT];   // Logit change per unit of score, 0 disables the matcher
+    float offset[MATCHER_COUNT];   // Score at which the matcher is neutral
+    float decision;                // Probability at which a record matches
+} Ensemble_Model;
+
+// Outcome of scoring a record against a key
+typedef struct
+{
+    float score[MATCHER_COUNT];        // Raw scores, NaN for matchers that did not run
+    float contribution[MATCHER_COUNT]; // Clamped logit terms, 0 for matchers that did not run
+    uint32_t cycles[MATCHER_COUNT];    // Time per matcher in profiler_cycles() units, 0 if it did not run
+    uint8_t run;                       // Bit i set if matcher i ran
+    float logit;                       // Fused logit
+    float probability;                 // Fused match probability
+    bool match;                        // Final verdict
+} Ensemble_Result;
+
+// Default model
+extern const Ensemble_Model ensemble_default_model;
+
+// Short name of a matcher, for logs and metrics
+const char *matcher_name(Matcher_Id id);
+
+// Raw score of one matcher
+float matcher_score(Matcher_Id id, const Gesture_Template &key, const Gesture_Template &record, BumpArena &scratch);
+
+// Score a record with every enabled matcher that can still change the verdict
+bool ensemble_match(const Ensemble_Model &model, const Gesture_Template &key, const Gesture_Template &record,
+                    BumpArena &scratch, Ensemble_Result &result);
+
+// True if the verdict would flip without the given matcher's contribution
+bool ensemble_pivotal(const Ensemble_Model &model, const Ensemble_Result &result, Matcher_Id id);
+
+// Fused logit of a complete score vector, for scores computed ahead of time
+float ensemble_logit(const Ensemble_Model &model, const float score[MATCHER_COUNT]);
+
+// True if a fused logit reaches the model's decision probability
+bool ensemble_accepts(const Ensemble_Model &model, float logit);
+
+// Fit bias and weights by logistic regression on labelled score vectors, keeping offsets and decision
+void ensemble_fit(Ensemble_Model &model, const float (*scores)[MATCHER_COUNT], const bool *genuine, size_t count,
+                  uint32_t iterations, float rate);
+
+#endif
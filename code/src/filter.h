@@ -0,0 +1,187 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * Per-sample digital filters for the capture path. The firmware runs
+ * Median3 at the full rate (CaptureFilter in main.cpp) and leaves band
+ * limiting to the decimators; the other stages are kept for host/bench_filter
+ * to compare against it.
+ *
+ * Every stage works on int16 samples (raw sensor counts, i.e. Q15 of full
+ * scale), keeps its own state and exposes
+ *
+ *   int16_t process(int16_t x);   // filter one sample
+ *   void reset();                 // forget the history
+ *   static const uint32_t cost;   // estimated Cortex-M4 cycles per sample
+ *
+ * FilterChain composes stages at compile time, so the whole chain inlines
+ * into the capture loop and its cost is checked against a budget with
+ * static_assert.
+ ******************************************************************************/
+
+// Saturate a 32-bit intermediate to the int16 range
+static inline int16_t filter_saturate(int32_t x)
+{
+    return (int16_t)(x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x));
+}
+
+/*******************************************************************************
+ * Class: DcBlocker
+ * -----------------------------------------------------------------------------
+ * First-order DC blocker y[n] = x[n] - x[n-1] + R * y[n-1].
+ *
+ * Template parameters:
+ *  - R_Q15: Pole radius in Q15; closer to 32768 keeps lower frequencies.
+ ******************************************************************************/
+template <int32_t R_Q15>
+class DcBlocker
+{
+    static_assert(R_Q15 > 0 && R_Q15 < 32768, "DcBlocker pole must lie inside the unit circle");
+
+public:
+    static const uint32_t cost = 8;
+
+    DcBlocker() { reset(); }
+
+    int16_t process(int16_t x)
+    {
+        y = x - x1 + ((R_Q15 * y + (1 << 14)) >> 15);   // Difference plus leaky feedback
+        x1 = x;
+        y = filter_saturate(y);
+        return (int16_t)y;
+    }
+
+    void reset()
+    {
+        x1 = 0;
+        y = 0;
+    }
+
+private:
+    int32_t x1;                                          // Previous input
+    int32_t y;                                           // Previous output
+};
+
+/*******************************************************************************
+ * Class: MovingAverage
+ * -----------------------------------------------------------------------------
+ * Boxcar average over the last N samples using a running sum.
+ *
+ * Template parameters:
+ *  - N: Window length, must be a power of two so the division is a shift.
+ ******************************************************************************/
+template <uint32_t N>
+class MovingAverage
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "MovingAverage window must be a power of two");
+
+public:
+    static const uint32_t cost = 10;
+
+    MovingAverage() { reset(); }
+
+    int16_t process(int16_t x)
+    {
+        sum += x - window[index];                        // Replace the oldest sample in the sum
+        window[index] = x;
+        index = (index + 1) & (N - 1);
+        return (int16_t)(sum / (int32_t)N);
+    }
+
+    void reset()
+    {
+        for (uint32_t i = 0; i < N; i++)
+        {
+            window[i] = 0;
+        }
+        index = 0;
+        sum = 0;
+    }
+
+private:
+    int16_t window[N];                                   // Last N inputs
+    uint32_t index;                                      // Slot of the oldest input
+    int32_t sum;                                         // Sum of the window
+};
+
+/*******************************************************************************
+ * Class: Median3
+ * -----------------------------------------------------------------------------
+ * Three-tap median, removes single-sample spikes without smearing edges.
+ ******************************************************************************/
+class Median3
+{
+public:
+    static const uint32_t cost = 12;
+
+    Median3() { reset(); }
+
+    int16_t process(int16_t x)
+    {
+        int16_t a = x1, b = x2;
+        x2 = x1;
+        x1 = x;
+        // Median of (x, a, b) with three compares and no branches on the data path
+        int16_t lo = a < b ? a : b;
+        int16_t hi = a < b ? b : a;
+        return x < lo ? lo : (x > hi ? hi : x);
+    }
+
+    void reset()
+    {
+        x1 = x2 = 0;
+    }
+
+private:
+    int16_t x1, x2;                                      // Previous inputs
+};
+
+/*******************************************************************************
+ * Class: FilterChain
+ * -----------------------------------------------------------------------------
+ * Applies the listed stages in order. An empty chain passes samples through.
+ *
+ * Template parameters:
+ *  - Stages: Filter stages, first to last.
+ ******************************************************************************/
+template <typename... Stages>
+class FilterChain;
+
+template <>
+class FilterChain<>
+{
+public:
+    static const uint32_t cost = 0;
+
+    int16_t process(int16_t x) { return x; }
+    void reset() {}
+};
+
+template <typename First, typename... Rest>
+class FilterChain<First, Rest...>
+{
+public:
+    static const uint32_t cost = First::cost + FilterChain<Rest...>::cost;
+
+    int16_t process(int16_t x)
+    {
+        return rest.process(first.process(x));
+    }
+
+    void reset()
+    {
+        first.reset();
+        rest.reset();
+    }
+
+    First &head() { return first; }                      // First stage, for per-stage benchmarks
+    FilterChain<Rest...> &tail() { return rest; }        // Remaining stages
+
+private:
+    First first;                                         // This stage
+    FilterChain<Rest...> rest;                           // Remaining stages
+};
+
+#endif
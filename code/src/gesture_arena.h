@@ -0,0 +1,65 @@
+#ifndef GESTURE_ARENA_H
+#define GESTURE_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*******************************************************************************
+ * Class: BumpArena
+ * -----------------------------------------------------------------------------
+ * Typed bump allocator over a caller-provided, statically sized buffer.
+ *
+ * Long-lived buffers (gesture traces) are carved once at boot. Short-lived
+ * matcher scratch is taken after a mark() and handed back with release(), so
+ * the arena never fragments and allocation is a pointer bump. Not thread safe:
+ * boot allocations happen before the threads start and scratch belongs to the
+ * matcher thread.
+ ******************************************************************************/
+class BumpArena
+{
+public:
+    BumpArena(uint8_t *storage, size_t size) : base(storage), limit(size), offset(0), peak(0), count(0) {}
+
+    // Reserve room for count objects of type T; returns nullptr when exhausted
+    template <typename T>
+    T *allocate(size_t count_of)
+    {
+        size_t align = alignof(T);                                  // Required alignment of T
+        size_t start = (offset + align - 1) & ~(align - 1);         // Round the offset up
+        size_t bytes = count_of * sizeof(T);                        // Size of the request
+        if (start > limit || bytes > limit - start)
+        {
+            return nullptr;                                         // Arena exhausted
+        }
+        offset = start + bytes;                                     // Bump the offset
+        peak = offset > peak ? offset : peak;                       // Track the high-water mark
+        count++;                                                    // Count the allocation
+        return reinterpret_cast<T *>(base + start);
+    }
+
+    // Current offset, to be passed to release() when the scratch is done
+    size_t mark() const
+    {
+        return offset;
+    }
+
+    // Free everything allocated since mark
+    void release(size_t mark_offset)
+    {
+        offset = mark_offset;
+    }
+
+    size_t used() const { return offset; }                          // Bytes currently allocated
+    size_t high_water() const { return peak; }                      // Most bytes ever allocated
+    size_t size() const { return limit; }                           // Total arena size
+    uint32_t allocations() const { return count; }                  // Number of allocate() calls served
+
+private:
+    uint8_t *base;                                                  // Start of the storage
+    size_t limit;                                                   // Size of the storage in bytes
+    size_t offset;                                                  // First free byte
+    size_t peak;                                                    // High-water mark in bytes
+    uint32_t count;                                                 // Allocations served
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include <string.h>                              // Include memcpy
+#include <math.h>                                // Include fabsf and lrintf
+#include "gesture_codec.h"                       // Include the gesture codec header
+
+#define CODEC_MAGIC_0 'G'
+#define CODEC_MAGIC_1 'K'
+#define CODEC_RICE_MAX_K 16                      // Largest Rice parameter; at 16 no zig-zag value needs more than 18 bits
+#define CODEC_RICE_ESCAPE 16                     // Quotients this large are written as the raw value instead
+#define CODEC_VARINT_BYTES 3                     // Longest varint, enough for 21 bits
+
+// Quantizer limit of a format
+static inline int32_t codec_limit(uint8_t format)
+{
+    return format & CODEC_INT8 ? 127 : 32767;
+}
+
+// Bits of the largest zig-zag difference of a format, written after an escape
+static inline uint32_t codec_raw_bits(uint8_t format)
+{
+    return format & CODEC_INT8 ? 9 : 17;
+}
+
+static inline int32_t codec_quantize(float x, float step, int32_t limit)
+{
+    int32_t q = (int32_t)lrintf(x / step);
+    return q > limit ? limit : (q < -limit ? -limit : q);
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Bits of one Rice code with parameter k
+static inline uint32_t rice_bits(uint32_t v, uint32_t k, uint32_t raw_bits)
+{
+    uint32_t q = v >> k;
+    return q < CODEC_RICE_ESCAPE ? q + 1 + k : CODEC_RICE_ESCAPE + raw_bits;
+}
+
+// LSB-first bit writer over a bounded buffer
+typedef struct
+{
+    uint8_t *next;
+    uint8_t *end;
+    uint32_t bits;                               // Pending bits, LSB first
+    uint32_t bit_count;                          // Valid bits in bits
+    bool overflow;                               // Set once a byte did not fit
+} Bit_Writer;
+
+static void bits_put(Bit_Writer &writer, uint32_t value, uint32_t count)
+{
+    if (writer.overflow)
+    {
+        return;                                  // Already failed, keep the bit count bounded
+    }
+    writer.bits |= value << writer.bit_count;    // count <= 17 and bit_count < 8, so nothing is shifted out
+    writer.bit_count += count;
+    while (writer.bit_count >= 8)
+    {
+        if (writer.next == writer.end)
+        {
+            writer.overflow = true;
+            return;
+        }
+        *writer.next++ = (uint8_t)writer.bits;
+        writer.bits >>= 8;
+        writer.bit_count -= 8;
+    }
+}
+
+// Decoding state over an encoded trace
+typedef struct
+{
+    const uint8_t *next;                         // Next payload byte
+    const uint8_t *end;                          // End of the payload
+    uint32_t bits;                               // Rice bits not consumed yet, LSB first
+    uint32_t bit_count;                          // Valid bits in bits
+    uint8_t format;                              // CODEC_* flags
+    uint8_t rice_k[3];                           // Rice parameter per axis
+    float step;                                  // Quantization step, in the units of the trace
+    int32_t value[3];                            // Last quantized sample
+    size_t remaining;                            // Samples not decoded yet
+} Codec_Reader;
+
+// Top up the reader's bit buffer to more than 24 bits while payload remains
+static inline void bits_refill(Codec_Reader &reader)
+{
+    while (reader.bit_count <= 24 && reader.next < reader.end)
+    {
+        reader.bits |= (uint32_t)*reader.next++ << reader.bit_count;
+        reader.bit_count += 8;
+    }
+}
+
+// Take count bits, count <= 17; returns false if the payload ran out
+static inline bool bits_take(Codec_Reader &reader, uint32_t count, uint32_t &value)
+{
+    bits_refill(reader);
+    if (reader.bit_count < count)
+    {
+        return false;
+    }
+    value = reader.bits & ((1u << count) - 1);
+    reader.bits = count < 32 ? reader.bits >> count : 0;
+    reader.bit_count -= count;
+    return true;
+}
+
+// Next zig-zag difference of one axis
+static inline bool codec_next_value(Codec_Reader &reader, int axis, uint32_t &value)
+{
+    if (!(reader.format & CODEC_RICE))
+    {
+        value = 0;
+        for (uint32_t i = 0; i < CODEC_VARINT_BYTES; i++)
+        {
+            if (reader.next == reader.end)
+            {
+                return false;
+            }
+            uint8_t byte = *reader.next++;
+            value |= (uint32_t)(byte & 0x7F) << (7 * i);
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;                            // Longer than any valid difference
+    }
+
+    bits_refill(reader);
+    uint32_t q = reader.bits == 0xFFFFFFFFu ? 32 : (uint32_t)__builtin_ctz(~reader.bits); // Unary quotient, RBIT and CLZ on the M4
+    q = q < CODEC_RICE_ESCAPE ? q : CODEC_RICE_ESCAPE;
+    if (q > reader.bit_count)
+    {
+        return false;                            // Ones run past the payload
+    }
+    reader.bits >>= q;
+    reader.bit_count -= q;
+    if (q == CODEC_RICE_ESCAPE)
+    {
+        return bits_take(reader, codec_raw_bits(reader.format), value);
+    }
+    uint32_t tail;                               // Terminating zero and the k remainder bits
+    if (!bits_take(reader, 1 + reader.rice_k[axis], tail))
+    {
+        return false;
+    }
+    value = q << reader.rice_k[axis] | tail >> 1;
+    return true;
+}
+
+/*******************************************************************************
+ * Function: codec_encode
+ * -----------------------------------------------------------------------------
+ * Encodes a trace in the given format. With CODEC_RICE the parameter of each
+ * axis is chosen by summing the code length of every difference for each
+ * candidate, which takes one extra pass at encode time only.
+ *
+ * Parameters:
+ *  - trace: Trace to encode, at most 65535 samples.
+ *  - format: CODEC_* flags.
+ *  - out: Receives the encoding.
+ *  - capacity: Size of out; CODEC_MAX_BYTES always suffices for a gesture.
+ *
+ * Returns:
+ *  - Bytes written, 0 if they did not fit.
+ ******************************************************************************/
+size_t codec_encode(const Gesture_Trace &trace, uint8_t format, uint8_t *out, size_t capacity)
+{
+    if (capacity < CODEC_HEADER_BYTES || trace.size > 0xFFFF)
+    {
+        return 0;
+    }
+    int32_t limit = codec_limit(format);
+    uint32_t raw_bits = codec_raw_bits(format);
+
+    float largest = 0.0f;                        // Largest magnitude of any coordinate
+    for (size_t i = 0; i < trace.size; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float m = fabsf(trace.samples[i][axis]);
+            largest = m > largest ? m : largest;
+        }
+    }
+    float step = largest > 0.0f ? largest / (float)limit : 1.0f;
+
+    uint8_t rice_k[3] = {0, 0, 0};
+    if (format & CODEC_RICE)
+    {
+        uint32_t cost[3][CODEC_RICE_MAX_K + 1] = {};  // Payload bits per axis and parameter
+        int32_t previous[3] = {0, 0, 0};
+        for (size_t i = 0; i < trace.size; i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                int32_t q = codec_quantize(trace.samples[i][axis], step, limit);
+                uint32_t v = zigzag(q - previous[axis]);
+                previous[axis] = q;
+                for (uint32_t k = 0; k <= CODEC_RICE_MAX_K; k++)
+                {
+                    cost[axis][k] += rice_bits(v, k, raw_bits);
+                }
+            }
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (uint32_t k = 1; k <= CODEC_RICE_MAX_K; k++)
+            {
+                rice_k[axis] = cost[axis][k] < cost[axis][rice_k[axis]] ? (uint8_t)k : rice_k[axis];
+            }
+        }
+    }
+
+    Bit_Writer writer = {out + CODEC_HEADER_BYTES, out + capacity, 0, 0, false};
+    int32_t previous[3] = {0, 0, 0};
+    for (size_t i = 0; i < trace.size && !writer.overflow; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int32_t q = codec_quantize(trace.samples[i][axis], step, limit);
+            uint32_t v = zigzag(q - previous[axis]);
+            previous[axis] = q;
+            if (!(format & CODEC_RICE))
+            {
+                while (v >= 0x80)
+                {
+                    bits_put(writer, (v & 0x7F) | 0x80, 8);
+                    v >>= 7;
+                }
+                bits_put(writer, v, 8);
+                continue;
+            }
+            uint32_t k = rice_k[axis];
+            uint32_t quotient = v >> k;
+            if (quotient < CODEC_RICE_ESCAPE)
+            {
+                bits_put(writer, (1u << quotient) - 1, quotient + 1);  // quotient ones and a zero
+                bits_put(writer, v & ((1u << k) - 1), k);
+            }
+            else
+            {
+                bits_put(writer, (1u << CODEC_RICE_ESCAPE) - 1, CODEC_RICE_ESCAPE);
+                bits_put(writer, v, raw_bits);
+            }
+        }
+    }
+    if (writer.bit_count > 0)
+    {
+        bits_put(writer, 0, 8 - writer.bit_count);   // Pad the last byte with zeros
+    }
+    size_t length = (size_t)(writer.next - (out + CODEC_HEADER_BYTES));
+    if (writer.overflow || length > 0xFFFF)
+    {
+        return 0;
+    }
+
+    uint32_t step_bits;                          // IEEE 754 bit pattern, the M4 is little-endian too
+    memcpy(&step_bits, &step, sizeof(step_bits));
+    out[0] = CODEC_MAGIC_0;
+    out[1] = CODEC_MAGIC_1;
+    out[2] = CODEC_VERSION;
+    out[3] = format;
+    out[4] = (uint8_t)trace.size;
+    out[5] = (uint8_t)(trace.size >> 8);
+    out[6] = (uint8_t)length;
+    out[7] = (uint8_t)(length >> 8);
+    for (int b = 0; b < 4; b++)
+    {
+        out[8 + b] = (uint8_t)(step_bits >> (8 * b));
+    }
+    out[12] = rice_k[0];
+    out[13] = rice_k[1];
+    out[14] = rice_k[2];
+    out[15] = 0;
+    return CODEC_HEADER_BYTES + length;
+}
+
+// Check the header of an encoded trace and position a reader on its first sample
+static bool codec_reader_init(Codec_Reader &reader, const uint8_t *encoded, size_t size)
+{
+    if (size < CODEC_HEADER_BYTES || encoded[0] != CODEC_MAGIC_0 || encoded[1] != CODEC_MAGIC_1 ||
+        encoded[2] != CODEC_VERSION || (encoded[3] & ~(CODEC_INT8 | CODEC_RICE)) != 0)
+    {
+        return false;                            // Not an encoded trace, e.g. erased flash
+    }
+    size_t length = encoded[6] | encoded[7] << 8;
+    if (length > size - CODEC_HEADER_BYTES)
+    {
+        return false;
+    }
+    uint32_t step_bits = (uint32_t)encoded[8] | (uint32_t)encoded[9] << 8 | (uint32_t)encoded[10] << 16 |
+                         (uint32_t)encoded[11] << 24;
+    memcpy(&reader.step, &step_bits, sizeof(reader.step));
+    reader.format = encoded[3];
+    reader.remaining = encoded[4] | encoded[5] << 8;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        reader.rice_k[axis] = encoded[12 + axis];
+        reader.value[axis] = 0;
+        if (reader.rice_k[axis] > CODEC_RICE_MAX_K)
+        {
+            return false;
+        }
+    }
+    reader.next = encoded + CODEC_HEADER_BYTES;
+    reader.end = reader.next + length;
+    reader.bits = 0;
+    reader.bit_count = 0;
+    return true;
+}
+
+// Decode the next sample: three codes, three additions and three multiplies
+static bool codec_read(Codec_Reader &reader, Gesture_Sample &sample)
+{
+    if (reader.remaining == 0)
+    {
+        return false;
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        uint32_t v;
+        if (!codec_next_value(reader, axis, v))
+        {
+            reader.remaining = 0;                // Stop at the damage
+            return false;
+        }
+        reader.value[axis] += unzigzag(v);
+        sample[axis] = (float)reader.value[axis] * reader.step;
+    }
+    reader.remaining--;
+    return true;
+}
+
+/*******************************************************************************
+ * Function: codec_decode
+ * -----------------------------------------------------------------------------
+ * Decodes a whole encoded trace.
+ *
+ * Parameters:
+ *  - encoded: Start of the encoding.
+ *  - size: Bytes available at encoded; may exceed the encoding, e.g. a whole
+ *    flash slot.
+ *  - trace: Receives the samples; emptied if the encoding is invalid.
+ *
+ * Returns:
+ *  - true if every sample was decoded and fit.
+ ******************************************************************************/
+bool codec_decode(const uint8_t *encoded, size_t size, Gesture_Trace &trace)
+{
+    trace_clear(trace);
+    Codec_Reader reader;
+    if (!codec_reader_init(reader, encoded, size) || reader.remaining > trace.capacity)
+    {
+        return false;
+    }
+    size_t count = reader.remaining;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!codec_read(reader, trace.samples[i]))
+        {
+            return false;                        // Truncated, trace stays empty
+        }
+    }
+    trace.size = count;
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef GESTURE_CODEC_H
+#define GESTURE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gesture_trace.h"
+
+/*******************************************************************************
+ * Gesture trace codec
+ *
+ * Stores a trace in a fraction of its 12 bytes per sample:
+ *
+ *   1. Quantize every coordinate to int16 or int8 with one step per trace,
+ *      the largest magnitude over the quantizer range.
+ *   2. Replace each quantized value by its difference to the previous sample
+ *      of the same axis; rates at 20 Hz change little from sample to sample.
+ *   3. Zig-zag the differences (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...) and
+ *      write them as LEB128 varints, or as Rice codes with the best
+ *      parameter per axis. Rice codes are a static prefix code for the
+ *      geometric distribution the differences follow, so they come within a
+ *      few percent of a Huffman table without storing one.
+ *
+ * Differences are taken between quantized values, so quantization errors do
+ * not accumulate: every decoded coordinate is within half a step of the
+ * original. The encoding starts with a 16-byte header:
+ *
+ *   magic:"GK" version:u8 format:u8 count:u16 length:u16 step:f32 rice_k:u8[3] reserved:u8
+ *
+ * followed by length payload bytes, all little-endian. Erased flash reads as
+ * 0xFF and fails the magic check.
+ ******************************************************************************/
+
+#define CODEC_VERSION 1
+#define CODEC_HEADER_BYTES 16
+
+// Format flags
+#define CODEC_INT8 0x01            // 8-bit quantization, otherwise 16-bit
+#define CODEC_RICE 0x02            // Rice codes, otherwise varints
+
+// Largest encoding of a GESTURE_MAX_SAMPLES trace in any format
+#define CODEC_MAX_BYTES (CODEC_HEADER_BYTES + GESTURE_MAX_SAMPLES * 3 * 3)
+
+// Encode a trace; returns the bytes written, 0 if capacity is too small
+size_t codec_encode(const Gesture_Trace &trace, uint8_t format, uint8_t *out, size_t capacity);
+
+// Decode a trace into preallocated storage; size may exceed the encoding; false if invalid or too long
+bool codec_decode(const uint8_t *encoded, size_t size, Gesture_Trace &trace);
+
+#endif
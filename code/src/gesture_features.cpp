@@ -0,0 +1,136 @@
+#include <math.h>                                // Include math functions
+#include "gesture_features.h"                    // Include the feature extraction header
+
+// Relative difference of two magnitudes in [0, 1]
+static inline float relative_difference(float a, float b)
+{
+    return fabsf(a - b) / (fabsf(a) + fabsf(b) + FEATURE_EPSILON);
+}
+
+/*******************************************************************************
+ * Function: features_extract
+ * -----------------------------------------------------------------------------
+ * Reduces a gesture to a fixed-size embedding in one pass over the trace and
+ * one over its resampling. Runs once per capture, so stored keys carry their
+ * embedding and an unlock attempt compares a few dozen numbers before any
+ * sequence matcher runs. The pass over the resampling also yields the mean
+ * and standard deviation the z-normalized DTW scales by.
+ *
+ * Parameters:
+ *  - trace: Trimmed gesture trace.
+ *  - resampled: The same gesture resampled to a fixed length.
+ *  - features: Receives the embedding.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void features_extract(const Gesture_Trace &trace, const Gesture_Trace &resampled, Gesture_Features &features)
+{
+    features.duration = (uint16_t)trace.size;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float energy = 0.0f;                     // Sum of squares
+        float angle = 0.0f;                      // Sum of rates
+        uint16_t crossings = 0;
+        uint16_t peaks = 0;
+        int sign = 0;                            // Last sign seen outside the deadband
+
+        for (size_t i = 0; i < trace.size; i++)
+        {
+            float x = trace.samples[i][axis];
+            energy += x * x;
+            angle += x;
+
+            // Zero crossings with a deadband, so sensor noise around zero does not chatter
+            int s = x > FEATURE_ZC_DEADBAND ? 1 : (x < -FEATURE_ZC_DEADBAND ? -1 : 0);
+            if (s != 0)
+            {
+                if (sign != 0 && s != sign)
+                {
+                    crossings++;
+                }
+                sign = s;
+            }
+
+            // Peaks of the magnitude; a flat top counts once at its last sample
+            if (i > 0 && i + 1 < trace.size)
+            {
+                float m = fabsf(x);
+                if (m >= FEATURE_PEAK_MIN && m > fabsf(trace.samples[i - 1][axis]) && m >= fabsf(trace.samples[i + 1][axis]))
+                {
+                    peaks++;
+                }
+            }
+        }
+
+        features.energy[axis] = trace.size ? energy / (float)trace.size : 0.0f;
+        features.angle[axis] = angle * FEATURE_SAMPLE_PERIOD;
+        features.zero_crossings[axis] = crossings;
+        features.peaks[axis] = peaks;
+
+        // Piecewise aggregate approximation of the resampled trace, with its moments for z-normalization
+        float total = 0.0f;                      // Sum over all segments
+        float squares = 0.0f;                    // Sum of squares over all segments
+        for (int segment = 0; segment < FEATURE_PAA_SEGMENTS; segment++)
+        {
+            size_t first = segment * resampled.size / FEATURE_PAA_SEGMENTS;
+            size_t last = (segment + 1) * resampled.size / FEATURE_PAA_SEGMENTS;
+            float sum = 0.0f;
+            for (size_t i = first; i < last; i++)
+            {
+                float x = resampled.samples[i][axis];
+                sum += x;
+                squares += x * x;
+            }
+            features.paa[axis][segment] = last > first ? sum / (float)(last - first) : 0.0f;
+            total += sum;
+        }
+        float mean = resampled.size ? total / (float)resampled.size : 0.0f;
+        float variance = resampled.size ? squares / (float)resampled.size - mean * mean : 0.0f;
+        features.mean[axis] = mean;
+        features.deviation[axis] = variance > 0.0f ? sqrtf(variance) : 0.0f; // Rounding can leave a tiny negative
+    }
+}
+
+/*******************************************************************************
+ * Function: features_distance
+ * -----------------------------------------------------------------------------
+ * Compares two embeddings. Every feature contributes a relative difference in
+ * [0, 1] so no unit dominates, and the result is their mean. Energy is
+ * compared as RMS so it scales like the other rate features. The PAA term is
+ * the L1 distance of the segment means over their total magnitude.
+ *
+ * Parameters:
+ *  - a: First embedding.
+ *  - b: Second embedding.
+ *
+ * Returns:
+ *  - Mean relative difference, 0 for identical embeddings.
+ ******************************************************************************/
+float features_distance(const Gesture_Features &a, const Gesture_Features &b)
+{
+    float total = relative_difference(a.duration, b.duration); // Sum of the per-feature differences
+    int terms = 1;                               // Number of differences summed
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        total += relative_difference(sqrtf(a.energy[axis]), sqrtf(b.energy[axis]));
+        total += relative_difference(a.angle[axis], b.angle[axis]);
+        total += relative_difference(a.zero_crossings[axis], b.zero_crossings[axis]);
+        total += relative_difference(a.peaks[axis], b.peaks[axis]);
+        terms += 4;
+
+        float difference = 0.0f;                 // L1 distance of the segment means
+        float magnitude = FEATURE_EPSILON;       // Sum of their magnitudes
+        for (int segment = 0; segment < FEATURE_PAA_SEGMENTS; segment++)
+        {
+            difference += fabsf(a.paa[axis][segment] - b.paa[axis][segment]);
+            magnitude += fabsf(a.paa[axis][segment]) + fabsf(b.paa[axis][segment]);
+        }
+        total += difference / magnitude;
+        terms++;
+    }
+
+    return total / (float)terms;
+}
@@ -0,0 +1,38 @@
+#ifndef GESTURE_FEATURES_H
+#define GESTURE_FEATURES_H
+
+#include <stdint.h>
+#include "gesture_trace.h"
+
+// Trace sample spacing in seconds
+#define FEATURE_SAMPLE_PERIOD (1.0f / GESTURE_RATE_HZ)
+
+// Feature extraction parameters at 20 Hz
+#define FEATURE_ZC_DEADBAND 5.0f      // Sign changes only count once the axis leaves +-5 dps
+#define FEATURE_PEAK_MIN 30.0f        // Peaks below 30 dps are ignored
+#define FEATURE_PAA_SEGMENTS 8        // Piecewise aggregate segments per axis
+#define FEATURE_EPSILON 1.0f          // Keeps relative differences finite near zero
+
+// Largest embedding distance that still goes on to the sequence matchers
+#define FEATURE_THRESHOLD 0.5f
+
+// Compact summary of one gesture trace
+typedef struct
+{
+    float energy[3];                            // Mean square rate per axis, in dps^2
+    float angle[3];                             // Integrated rotation per axis, in degrees
+    uint16_t zero_crossings[3];                 // Sign changes per axis outside the deadband
+    uint16_t peaks[3];                          // Local maxima of |rate| per axis
+    uint16_t duration;                          // Trace length in samples
+    float paa[3][FEATURE_PAA_SEGMENTS];         // Segment means per axis of the resampled trace
+    float mean[3];                              // Mean per axis of the resampled trace, in dps
+    float deviation[3];                         // Standard deviation per axis of the resampled trace, in dps
+} Gesture_Features;
+
+// Summarize a trace and its fixed-length resampling
+void features_extract(const Gesture_Trace &trace, const Gesture_Trace &resampled, Gesture_Features &features);
+
+// Distance between two embeddings in [0, 1], 0 for identical gestures
+float features_distance(const Gesture_Features &a, const Gesture_Features &b);
+
+#endif
@@ -0,0 +1,86 @@
+#include "gesture_template.h"                    // Include the gesture template header
+
+/*******************************************************************************
+ * Function: template_init
+ * -----------------------------------------------------------------------------
+ * Allocates the recording and cache buffers of a template from the arena.
+ * Called once per slot at boot.
+ *
+ * Parameters:
+ *  - gesture: Template to initialize.
+ *  - arena: Arena providing the storage.
+ *
+ * Returns:
+ *  - true if every buffer was allocated.
+ ******************************************************************************/
+bool template_init(Gesture_Template &gesture, BumpArena &arena)
+{
+    Gesture_Sample *samples = arena.allocate<Gesture_Sample>(GESTURE_MAX_SAMPLES); // Recording buffer
+    Gesture_Sample *path = arena.allocate<Gesture_Sample>(GESTURE_MAX_SAMPLES);    // Rotation path buffer
+    Gesture_Sample *resampled = arena.allocate<Gesture_Sample>(RESAMPLE_LENGTH);   // Resampled cache
+
+    trace_init(gesture.trace, samples, GESTURE_MAX_SAMPLES);
+    trace_init(gesture.path, path, GESTURE_MAX_SAMPLES);
+    trace_init(gesture.resampled, resampled, RESAMPLE_LENGTH);
+    return samples != nullptr && path != nullptr && resampled != nullptr;
+}
+
+/*******************************************************************************
+ * Function: template_clear
+ * -----------------------------------------------------------------------------
+ * Empties a template, keeping its buffers.
+ *
+ * Parameters:
+ *  - gesture: Template to empty.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void template_clear(Gesture_Template &gesture)
+{
+    trace_clear(gesture.trace);                      // Forget the recording
+    trace_clear(gesture.path);
+    trace_clear(gesture.resampled);                  // and everything derived from it
+}
+
+/*******************************************************************************
+ * Function: template_swap
+ * -----------------------------------------------------------------------------
+ * Exchanges two templates by swapping their buffers, so a recording and its
+ * cached data move between slots together in constant time.
+ *
+ * Parameters:
+ *  - a: First template.
+ *  - b: Second template.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void template_swap(Gesture_Template &a, Gesture_Template &b)
+{
+    trace_swap(a.trace, b.trace);                    // Swap the recordings
+    trace_swap(a.path, b.path);
+    trace_swap(a.resampled, b.resampled);            // Swap the caches with them
+
+    Gesture_Features features = a.features;          // The embedding is small and held by value
+    a.features = b.features;
+    b.features = features;
+}
+
+/*******************************************************************************
+ * Function: template_finalize
+ * -----------------------------------------------------------------------------
+ * Computes the cached data of a finished recording. Runs once per capture, so
+ * stored keys never pay for it again at unlock time.
+ *
+ * Parameters:
+ *  - gesture: Template whose trace is complete.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void template_finalize(Gesture_Template &gesture)
+{
+    resample_linear(gesture.trace, gesture.resampled, RESAMPLE_LENGTH); // Fixed-length copy for correlation
+    features_extract(gesture.trace, gesture.resampled, gesture.features); // Embedding for pre-screening
+}
@@ -0,0 +1,33 @@
+#ifndef GESTURE_TEMPLATE_H
+#define GESTURE_TEMPLATE_H
+
+#include "gesture_arena.h"
+#include "gesture_trace.h"
+#include "resample.h"
+#include "gesture_features.h"
+
+// Arena bytes template_init() carves for one template
+#define TEMPLATE_ARENA_BYTES ((2 * GESTURE_MAX_SAMPLES + RESAMPLE_LENGTH) * sizeof(Gesture_Sample))
+
+// A recorded gesture together with the derived data the matcher reuses
+typedef struct
+{
+    Gesture_Trace trace;     // Samples as recorded and trimmed
+    Gesture_Trace path;      // Rotation since the first sample, in radians, one per sample of trace
+    Gesture_Trace resampled; // trace resampled to RESAMPLE_LENGTH, cached for correlation
+    Gesture_Features features; // Embedding of the trace, cached for pre-screening
+} Gesture_Template;
+
+// Carve the buffers of a template out of the arena, returns false if it is exhausted
+bool template_init(Gesture_Template &gesture, BumpArena &arena);
+
+// Drop the recording and its derived data, keeping the storage
+void template_clear(Gesture_Template &gesture);
+
+// Exchange two templates without copying samples
+void template_swap(Gesture_Template &a, Gesture_Template &b);
+
+// Compute the derived data once the recording is complete
+void template_finalize(Gesture_Template &gesture);
+
+#endif
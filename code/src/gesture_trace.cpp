@@ -0,0 +1,102 @@
+#include <string.h>                              // Include memcpy
+#include "gesture_trace.h"                       // Include the gesture trace header
+
+uint32_t trace_bytes_copied = 0;                 // Bytes moved by trace_copy since boot
+
+/*******************************************************************************
+ * Function: trace_init
+ * -----------------------------------------------------------------------------
+ * Attaches preallocated storage to a trace and empties it.
+ *
+ * Parameters:
+ *  - trace: Trace to initialize.
+ *  - storage: Sample buffer owned by the caller for the lifetime of the trace.
+ *  - capacity: Number of samples the buffer can hold.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void trace_init(Gesture_Trace &trace, Gesture_Sample *storage, size_t capacity)
+{
+    trace.samples = storage;                         // Attach the storage
+    trace.size = 0;                                  // Start empty
+    trace.capacity = storage != nullptr ? capacity : 0; // A failed allocation leaves a zero-capacity trace
+}
+
+/*******************************************************************************
+ * Function: trace_push
+ * -----------------------------------------------------------------------------
+ * Appends a sample to the end of a trace.
+ *
+ * Parameters:
+ *  - trace: Trace to append to.
+ *  - sample: Sample to append.
+ *
+ * Returns:
+ *  - true if the sample was stored, false if the trace is full.
+ ******************************************************************************/
+bool trace_push(Gesture_Trace &trace, const Gesture_Sample &sample)
+{
+    if (trace.size >= trace.capacity)
+    {
+        return false;                                // Trace full, the sample is dropped
+    }
+    trace.samples[trace.size++] = sample;            // Store the sample
+    return true;
+}
+
+/*******************************************************************************
+ * Function: trace_clear
+ * -----------------------------------------------------------------------------
+ * Empties a trace without releasing its storage.
+ *
+ * Parameters:
+ *  - trace: Trace to empty.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void trace_clear(Gesture_Trace &trace)
+{
+    trace.size = 0;                                  // Forget the samples, keep the storage
+}
+
+/*******************************************************************************
+ * Function: trace_copy
+ * -----------------------------------------------------------------------------
+ * Copies the samples of one trace into the storage of another.
+ *
+ * Parameters:
+ *  - dst: Destination trace.
+ *  - src: Source trace.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void trace_copy(Gesture_Trace &dst, const Gesture_Trace &src)
+{
+    size_t count = src.size < dst.capacity ? src.size : dst.capacity; // Never overrun dst
+    memcpy(dst.samples, src.samples, count * sizeof(Gesture_Sample)); // Copy the samples
+    dst.size = count;                                // Adopt the new length
+    trace_bytes_copied += count * sizeof(Gesture_Sample); // Account for the copy
+}
+
+/*******************************************************************************
+ * Function: trace_swap
+ * -----------------------------------------------------------------------------
+ * Exchanges two traces by swapping their storage pointers, so ownership of a
+ * recording moves between preallocated slots in constant time.
+ *
+ * Parameters:
+ *  - a: First trace.
+ *  - b: Second trace.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void trace_swap(Gesture_Trace &a, Gesture_Trace &b)
+{
+    Gesture_Trace held = a;                          // Only the descriptors move
+    a = b;
+    b = held;
+}
@@ -0,0 +1,43 @@
+#ifndef GESTURE_TRACE_H
+#define GESTURE_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+
+// Sample rate of gesture traces, the rate the features and matchers are tuned for
+#define GESTURE_RATE_HZ 20
+
+// Longest gesture kept, in samples (5 s at 20 Hz plus margin)
+#define GESTURE_MAX_SAMPLES 128
+
+// One gyroscope sample in degrees per second (x, y, z)
+typedef std::array<float, 3> Gesture_Sample;
+
+// Fixed-capacity gesture trace over preallocated storage
+typedef struct
+{
+    Gesture_Sample *samples; // Sample storage, carved from the gesture arena
+    size_t size;             // Number of valid samples
+    size_t capacity;         // Number of samples the storage can hold
+} Gesture_Trace;
+
+// Bytes moved by trace_copy since boot, for copy accounting
+extern uint32_t trace_bytes_copied;
+
+// Attach storage to an empty trace
+void trace_init(Gesture_Trace &trace, Gesture_Sample *storage, size_t capacity);
+
+// Append a sample, returns false when the trace is full
+bool trace_push(Gesture_Trace &trace, const Gesture_Sample &sample);
+
+// Drop all samples, keeping the storage
+void trace_clear(Gesture_Trace &trace);
+
+// Copy the samples of src into dst, truncating to the capacity of dst
+void trace_copy(Gesture_Trace &dst, const Gesture_Trace &src);
+
+// Exchange the storage and contents of two traces without copying samples
+void trace_swap(Gesture_Trace &a, Gesture_Trace &b);
+
+#endif
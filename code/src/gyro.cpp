@@ -1,24 +1,25 @@
 #include <mbed.h>                        // Include the mbed library for hardware abstraction
 #include "gyro.h"                        // Include the custom gyroscope header file
+#include "log_ring.h"                    // Include the deferred log
 
 // Initialize SPI communication for the gyroscope
 SPI gyroscope(PF_9, PF_8, PF_7);           // MOSI on PF_9, MISO on PF_8, SCLK on PF_7
 DigitalOut cs(PC_1);                        // Chip Select (CS) pin on PC_1 for SPI communication
 
-// Calibration thresholds for each axis (initialized to zero)
-int16_t x_threshold;                         // X-axis calibration threshold
-int16_t y_threshold;                         // Y-axis calibration threshold
-int16_t z_threshold;                         // Z-axis calibration threshold
-
 // Zero-rate level samples for each axis (initialized to zero)
 int16_t x_sample;                            // X-axis zero-rate level sample
 int16_t y_sample;                            // Y-axis zero-rate level sample
 int16_t z_sample;                            // Z-axis zero-rate level sample
 
-float sensitivity = 0.0f;                    // Sensitivity factor based on full-scale selection
-
 Gyroscope_RawData *gyro_raw;                  // Pointer to store raw gyroscope data
 
+// Power bookkeeping, owned by the thread that drives the sensor
+static uint8_t rate_bits;                     // CTRL_REG_1 rate and bandwidth bits of the configuration
+static uint8_t interrupt_bits;                // CTRL_REG_3 interrupt routing of the configuration
+static Gyroscope_PowerMode power_mode = GYRO_POWER_DOWN; // Mode the sensor is in
+static uint64_t power_since_ms;               // Kernel time of the last mode change
+static uint32_t power_time_ms[GYRO_POWER_MODES]; // Completed time per mode
+
 /*******************************************************************************
  * Function: WriteByte
  * -----------------------------------------------------------------------------
@@ -39,6 +40,26 @@ void WriteByte(uint8_t address, uint8_t data)
     cs = 1;                                    // Deactivate the gyroscope by pulling CS high
 }
 
+/*******************************************************************************
+ * Function: ReadByte
+ * -----------------------------------------------------------------------------
+ * Reads a single register from the gyroscope via SPI.
+ *
+ * Parameters:
+ *  - address: Register address to read.
+ *
+ * Returns:
+ *  - The register value.
+ ******************************************************************************/
+uint8_t ReadByte(uint8_t address)
+{
+    cs = 0;                                    // Activate the gyroscope by pulling CS low
+    gyroscope.write(address | 0x80);           // Send the register address with the read bit set
+    uint8_t data = gyroscope.write(0xff);      // Clock the register value out
+    cs = 1;                                    // Deactivate the gyroscope by pulling CS high
+    return data;
+}
+
 /*******************************************************************************
  * Function: GetGyroValue
  * -----------------------------------------------------------------------------
@@ -64,50 +85,57 @@ void GetGyroValue(Gyroscope_RawData *rawdata)
  * Function: CalibrateGyroscope
  * -----------------------------------------------------------------------------
  * Calibrates the gyroscope by determining the zero-rate level for each axis.
- * It also sets up thresholds to filter out minor vibrations.
+ * Samples are taken as fast as the sensor produces them, 160 ms at 800 Hz.
  *
  * Parameters:
  *  - rawdata: Pointer to a Gyroscope_RawData structure to store calibration data.
+ *  - wait_sample: Called before each sample with its index, returns once the
+ *                 sensor has a new one (e.g. on DRDY). nullptr polls STATUS_REG.
  *
  * Returns:
  *  - None
  ******************************************************************************/
-void CalibrateGyroscope(Gyroscope_RawData *rawdata)
+void CalibrateGyroscope(Gyroscope_RawData *rawdata, void (*wait_sample)(int sample))
 {
-    int16_t sumX = 0;                          // Accumulator for X-axis samples
-    int16_t sumY = 0;                          // Accumulator for Y-axis samples
-    int16_t sumZ = 0;                          // Accumulator for Z-axis samples
+    int32_t sumX = 0;                          // Accumulator for X-axis samples
+    int32_t sumY = 0;                          // Accumulator for Y-axis samples
+    int32_t sumZ = 0;                          // Accumulator for Z-axis samples
 
-    printf("========[Calibrating...]========\r\n"); // Notify start of calibration
+    log_printf("========[Calibrating...]========\r\n"); // Notify start of calibration
 
-    // Collect 128 samples to calculate the average zero-rate level
-    for (int i = 0; i < 128; i++)
+    // Collect samples to calculate the average zero-rate level
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
     {
+        if (wait_sample != nullptr)
+        {
+            wait_sample(i);                     // Sleep until the next sample
+        }
+        else
+        {
+            while (!(ReadByte(STATUS_REG) & STATUS_ZYXDA))
+            {
+                // Poll until the next sample arrives
+            }
+        }
         GetGyroValue(rawdata);                  // Read raw gyroscope data
         sumX += rawdata->x_raw;                 // Accumulate X-axis data
         sumY += rawdata->y_raw;                 // Accumulate Y-axis data
         sumZ += rawdata->z_raw;                 // Accumulate Z-axis data
-
-        // Update the maximum thresholds based on current samples
-        x_threshold = max(x_threshold, rawdata->x_raw);
-        y_threshold = max(y_threshold, rawdata->y_raw);
-        z_threshold = max(z_threshold, rawdata->z_raw);
-
-        wait_us(10000);                          // Wait for 10 milliseconds between samples
     }
 
     // Calculate the average (zero-rate level) for each axis
-    x_sample = sumX >> 7;                       // Equivalent to sumX / 128
-    y_sample = sumY >> 7;                       // Equivalent to sumY / 128
-    z_sample = sumZ >> 7;                       // Equivalent to sumZ / 128
+    x_sample = sumX / CALIBRATION_SAMPLES;
+    y_sample = sumY / CALIBRATION_SAMPLES;
+    z_sample = sumZ / CALIBRATION_SAMPLES;
 
-    printf("========[Calibration finish.]========\r\n"); // Notify end of calibration
+    log_printf("========[Calibration finish.]========\r\n"); // Notify end of calibration
 }
 
 /*******************************************************************************
- * Function: InitiateGyroscope
+ * Function: ConfigureGyroscope
  * -----------------------------------------------------------------------------
- * Initializes the gyroscope by configuring control registers and performing calibration.
+ * Sets up SPI and writes the control registers, which powers the sensor up in
+ * active mode. The zero-rate levels of an earlier calibration are kept.
  *
  * Parameters:
  *  - init_parameters: Pointer to a Gyroscope_Init_Parameters structure containing
@@ -117,10 +145,8 @@ void CalibrateGyroscope(Gyroscope_RawData *rawdata)
  * Returns:
  *  - None
  ******************************************************************************/
-void InitiateGyroscope(Gyroscope_Init_Parameters *init_parameters, Gyroscope_RawData *init_raw_data)
+void ConfigureGyroscope(Gyroscope_Init_Parameters *init_parameters, Gyroscope_RawData *init_raw_data)
 {
-    printf("\r\n========[Initializing gyroscope...]========\r\n"); // Notify start of initialization
-
     gyro_raw = init_raw_data;                      // Assign the raw data pointer for global access
     cs = 1;                                        // Ensure the gyroscope is inactive initially
 
@@ -129,124 +155,145 @@ void InitiateGyroscope(Gyroscope_Init_Parameters *init_parameters, Gyroscope_Raw
     gyroscope.frequency(1000000);                  // Set SPI clock frequency to 1 MHz
 
     // Configure gyroscope control registers
-    WriteByte(CTRL_REG_1, init_parameters->conf1 | POWERON); // Set Output Data Rate, bandwidth, and enable all 3 axes
+    rate_bits = init_parameters->conf1;                      // Remembered for the power mode switches
+    interrupt_bits = init_parameters->conf3;                 // Restored after wake-on-motion
     WriteByte(CTRL_REG_3, init_parameters->conf3);           // Enable Data Ready interrupt on INT2 pin
     WriteByte(CTRL_REG_4, init_parameters->conf4);           // Set full-scale range and other configurations
+    SetGyroscopePower(GYRO_ACTIVE);                          // Set Output Data Rate, bandwidth, and enable all 3 axes
+}
 
-    // Set sensitivity based on full-scale selection
-    switch (init_parameters->conf4)
-    {
-    case FULL_SCALE_245:
-        sensitivity = SENSITIVITY_245;             // Sensitivity for ±245 dps
-        break;
-
-    case FULL_SCALE_500:
-        sensitivity = SENSITIVITY_500;             // Sensitivity for ±500 dps
-        break;
-
-    case FULL_SCALE_2000:
-        sensitivity = SENSITIVITY_2000;            // Sensitivity for ±2000 dps
-        break;
-
-    case FULL_SCALE_2000_ALT:
-        sensitivity = SENSITIVITY_2000;            // Sensitivity for alternative ±2000 dps setting
-        break;
-    }
+/*******************************************************************************
+ * Function: GetOffsetCorrectedRawData
+ * -----------------------------------------------------------------------------
+ * Retrieves raw data from the gyroscope with the zero-rate offsets removed.
+ * Small values are kept so that a filter further down the capture path can
+ * separate noise from low-amplitude motion.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void GetOffsetCorrectedRawData()
+{
+    GetGyroValue(gyro_raw);                                         // Read raw gyroscope data
 
-    CalibrateGyroscope(gyro_raw);                   // Perform calibration to determine zero-rate levels and thresholds
-    printf("========[Initiation finish.]========\r\n"); // Notify end of initialization
+    // Apply zero-rate level offsets to calibrate data
+    gyro_raw->x_raw -= x_sample;                                   // Subtract X-axis zero-rate level
+    gyro_raw->y_raw -= y_sample;                                   // Subtract Y-axis zero-rate level
+    gyro_raw->z_raw -= z_sample;                                   // Subtract Z-axis zero-rate level
 }
 
 /*******************************************************************************
- * Function: ConvertToDPS
+ * Function: SetGyroscopePower
  * -----------------------------------------------------------------------------
- * Converts raw gyroscope data to degrees per second (DPS) based on sensitivity.
+ * Switches between power-down, sleep and active mode through CTRL_REG_1 and
+ * accounts the time spent in the previous mode. The other control registers
+ * keep their values in every mode.
  *
  * Parameters:
- *  - axis_data: Raw gyroscope data for a single axis.
+ *  - mode: Power mode to enter.
  *
  * Returns:
- *  - Converted value in degrees per second as a float.
+ *  - None
  ******************************************************************************/
-float ConvertToDPS(int16_t axis_data)
+void SetGyroscopePower(Gyroscope_PowerMode mode)
 {
-    float dps = axis_data * sensitivity;             // Multiply raw data by sensitivity to get DPS
-    return dps;                                      // Return the DPS value
+    static const uint8_t mode_bits[GYRO_POWER_MODES] = {POWEROFF, SLEEP, POWERON}; // Power and axis bits per mode
+
+    WriteByte(CTRL_REG_1, mode == GYRO_POWER_DOWN ? POWEROFF : rate_bits | mode_bits[mode]);
+
+    uint64_t now_ms = Kernel::Clock::now().time_since_epoch().count(); // Close the stretch in the previous mode
+    power_time_ms[power_mode] += (uint32_t)(now_ms - power_since_ms);
+    power_since_ms = now_ms;
+    power_mode = mode;
 }
 
 /*******************************************************************************
- * Function: ConvertToVelocity
+ * Function: GetGyroscopePower
  * -----------------------------------------------------------------------------
- * Converts gyroscope data in degrees per second to linear velocity.
+ * Returns the current power mode.
  *
  * Parameters:
- *  - axis_data: Raw gyroscope data for a single axis.
+ *  - None
  *
  * Returns:
- *  - Converted velocity as a float.
+ *  - The mode last set with SetGyroscopePower.
  ******************************************************************************/
-float ConvertToVelocity(int16_t axis_data)
+Gyroscope_PowerMode GetGyroscopePower()
 {
-    float velocity = axis_data * sensitivity * DEGREE_TO_RAD * MY_LEG; // Convert DPS to velocity
-    return velocity;                                                // Return the velocity value
+    return power_mode;
 }
 
 /*******************************************************************************
- * Function: GetDistance
+ * Function: GetGyroscopePowerTime
  * -----------------------------------------------------------------------------
- * Calculates the cumulative distance based on an array of raw gyroscope data.
+ * Returns the time spent in a power mode, for duty cycle reports. May be
+ * called from any thread; a concurrent mode switch can skew one reading.
  *
  * Parameters:
- *  - arr: Array of raw gyroscope data samples.
+ *  - mode: Power mode to query.
  *
  * Returns:
- *  - Calculated distance as a float.
+ *  - Milliseconds in that mode since boot.
  ******************************************************************************/
-float GetDistance(int16_t arr[])
+uint32_t GetGyroscopePowerTime(Gyroscope_PowerMode mode)
 {
-    float distance = 0.00f;                                         // Initialize distance accumulator
-    for (int i = 0; i < 400; i++)                                   // Iterate through 400 samples
+    uint32_t total = power_time_ms[mode];
+    if (mode == power_mode)
     {
-        float v = ConvertToVelocity(arr[i]);                        // Convert raw data to velocity
-        distance += abs(v * 0.05f);                                 // Accumulate the absolute velocity scaled by time
+        total += (uint32_t)(Kernel::Clock::now().time_since_epoch().count() - power_since_ms); // Include the running stretch
     }
-    return distance;                                                // Return the total calculated distance
+    return total;
 }
 
 /*******************************************************************************
- * Function: GetCalibratedRawData
+ * Function: EnableMotionInterrupt
  * -----------------------------------------------------------------------------
- * Retrieves calibrated raw data from the gyroscope by applying zero-rate offsets
- * and thresholding minor vibrations.
+ * Arms the INT1 threshold generator for wake-on-motion. The generator sees
+ * high-pass filtered data, so the zero-rate level cannot trigger it, while the
+ * output registers and the FIFO keep the unfiltered samples. The FIFO runs in
+ * stream mode and always holds the latest FIFO_DEPTH samples, which become the
+ * pre-trigger part of the gesture. DRDY is disabled so the host can sleep; the
+ * sensor must be active.
  *
  * Parameters:
- *  - None
+ *  - threshold: Rate on any axis that raises INT1, in raw digits (15 bits).
+ *  - duration: Samples the rate must stay above the threshold (7 bits).
+ *  - high_pass: CTRL_REG_2 high-pass cutoff bits.
  *
  * Returns:
  *  - None
  ******************************************************************************/
-void GetCalibratedRawData()
+void EnableMotionInterrupt(uint16_t threshold, uint8_t duration, uint8_t high_pass)
 {
-    GetGyroValue(gyro_raw);                                         // Read raw gyroscope data
+    WriteByte(CTRL_REG_3, 0);                                      // Quiet both pins while reconfiguring
+    WriteByte(CTRL_REG_2, high_pass);                              // Normal high-pass mode with the given cutoff
+    WriteByte(CTRL_REG_5, CTRL5_FIFO_EN | CTRL5_HPEN | CTRL5_INT1_SEL_HPF); // Outputs stay unfiltered
+    ReadByte(REFERENCE);                                           // Start the high-pass filter from the current rate
 
-    // Apply zero-rate level offsets to calibrate data
-    gyro_raw->x_raw -= x_sample;                                   // Subtract X-axis zero-rate level
-    gyro_raw->y_raw -= y_sample;                                   // Subtract Y-axis zero-rate level
-    gyro_raw->z_raw -= z_sample;                                   // Subtract Z-axis zero-rate level
+    // Same threshold on every axis
+    WriteByte(INT1_TSH_XH, (threshold >> 8) & 0x7f);
+    WriteByte(INT1_TSH_XL, threshold & 0xff);
+    WriteByte(INT1_TSH_YH, (threshold >> 8) & 0x7f);
+    WriteByte(INT1_TSH_YL, threshold & 0xff);
+    WriteByte(INT1_TSH_ZH, (threshold >> 8) & 0x7f);
+    WriteByte(INT1_TSH_ZL, threshold & 0xff);
+    WriteByte(INT1_DURATION, duration & 0x7f);
 
-    // Apply thresholding to eliminate minor vibrations
-    if (abs(gyro_raw->x_raw) < abs(x_threshold))
-        gyro_raw->x_raw = 0;                                       // Zero out X-axis data below threshold
-    if (abs(gyro_raw->y_raw) < abs(y_threshold))
-        gyro_raw->y_raw = 0;                                       // Zero out Y-axis data below threshold
-    if (abs(gyro_raw->z_raw) < abs(z_threshold))
-        gyro_raw->z_raw = 0;                                       // Zero out Z-axis data below threshold
+    WriteByte(FIFO_CTRL_REG, FIFO_MODE_BYPASS);                    // Empty the FIFO
+    WriteByte(FIFO_CTRL_REG, FIFO_MODE_STREAM);                    // and start collecting
+    WriteByte(INT1_CFG, INT1_CFG_LIR | INT1_XHIE | INT1_YHIE | INT1_ZHIE); // Any axis, latched
+    ReadByte(INT1_SRC);                                            // Clear an event latched earlier
+    WriteByte(CTRL_REG_3, INT1_ENB);                               // Threshold events on INT1 only
 }
 
 /*******************************************************************************
- * Function: PowerOff
+ * Function: DisableMotionInterrupt
  * -----------------------------------------------------------------------------
- * Powers off the gyroscope by disabling it through the control register.
+ * Disarms the INT1 generator, stops the FIFO (discarding what is left in it)
+ * and restores the interrupt routing written by ConfigureGyroscope.
  *
  * Parameters:
  *  - None
@@ -254,7 +301,37 @@ void GetCalibratedRawData()
  * Returns:
  *  - None
  ******************************************************************************/
-void PowerOff()
+void DisableMotionInterrupt()
+{
+    WriteByte(INT1_CFG, 0);                                        // No more threshold events
+    ReadByte(INT1_SRC);                                            // Release a latched INT1
+    WriteByte(FIFO_CTRL_REG, FIFO_MODE_BYPASS);
+    WriteByte(CTRL_REG_5, 0);                                      // FIFO and high-pass filter off
+    WriteByte(CTRL_REG_3, interrupt_bits);                         // DRDY back on INT2
+}
+
+/*******************************************************************************
+ * Function: GetGyroFifoLevel
+ * -----------------------------------------------------------------------------
+ * Returns the number of unread samples in the FIFO. Each GetGyroValue call
+ * pops the oldest one while the FIFO is enabled.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - Unread samples, 0 to FIFO_DEPTH.
+ ******************************************************************************/
+uint32_t GetGyroFifoLevel()
 {
-    WriteByte(CTRL_REG_1, 0x00);                                   // Disable the gyroscope by writing 0 to CTRL_REG_1
+    uint8_t source = ReadByte(FIFO_SRC_REG);
+    if (source & FIFO_SRC_EMPTY)
+    {
+        return 0;
+    }
+    if (source & FIFO_SRC_OVRN)
+    {
+        return FIFO_DEPTH;                                         // Full, the level field has wrapped
+    }
+    return source & FIFO_SRC_FSS;
 }
@@ -9,7 +9,9 @@
 #define CTRL_REG_4 0x23 // control register 4
 #define CTRL_REG_5 0x24 // control register 5
 
+#define REFERENCE 0x25 // reference register, reading it resets the high-pass filter
 #define STATUS_REG 0x27 // status register
+#define STATUS_ZYXDA 0x08 // new sample available on every axis
 
 #define OUT_X_L 0x28 // X-axis angular rate data Low
 #define OUT_X_H 0x29 // X-axis angular rate data high
@@ -53,6 +55,26 @@
 #define ODR_400_HIGH_PASS_30 0x00
 #define ODR_800_HIGH_PASS_56 0x00
 
+// High pass filter cutoff near 0.45 Hz; HPCF 0100 at 100 Hz, one step up per doubling of the ODR
+#define HIGH_PASS_0_45_AT_100 0x04
+
+// Control register 5
+#define CTRL5_FIFO_EN 0x40 // Enable the FIFO
+#define CTRL5_HPEN 0x10 // Enable the high pass filter
+#define CTRL5_INT1_SEL_HPF 0x04 // Feed the INT1 generator with high-pass filtered data
+
+// FIFO modes and status
+#define FIFO_MODE_BYPASS 0x00 // FIFO disabled, output registers only
+#define FIFO_MODE_STREAM 0x40 // Keep the latest 32 samples, oldest overwritten
+#define FIFO_SRC_OVRN 0x40 // FIFO full, older samples were overwritten
+#define FIFO_SRC_EMPTY 0x20 // FIFO empty
+#define FIFO_SRC_FSS 0x1f // Number of unread samples
+#define FIFO_DEPTH 32 // Samples held by the FIFO
+
+// Interrupt 1 generator configuration
+#define INT1_CFG_AND 0x80 // Combine the axis events with AND instead of OR
+#define INT1_CFG_LIR 0x40 // Latch the interrupt until INT1_SRC is read
+
 // Interrupt configurations
 #define INT1_ENB 0x80 // Interrupt enable on the INT1 pin
 #define INT1_BOOT 0x40 // Boot status available on INT1 pin
@@ -78,15 +100,20 @@
 #define SENSITIVITY_500 0.0175f  // 500 dps typical sensitivity
 #define SENSITIVITY_2000 0.07f   // 2000 dps typical sensitivity
 
-// Convert constants
-#define MY_LEG 1              // put board on left leg 0.8m above ground
-#define DEGREE_TO_RAD 0.0175f // rad = dgree * (pi / 180)
+#define CALIBRATION_SAMPLES 128 // samples averaged for the zero-rate level, a power of two
 
 #define POWERON 0x0f  // turn gyroscope
 #define POWEROFF 0x00 // turnoff gyroscope
+#define SLEEP 0x08    // powered with every axis disabled, wakes within a few samples
 
-#define SAMPLE_TIME_20 20
-#define SAMPLE_INTERVAL_0_05 0.005f
+// Power modes of the sensor
+typedef enum
+{
+    GYRO_POWER_DOWN,     // Everything off, about 5 uA; needs the full turn-on time
+    GYRO_SLEEP,          // Drive kept running, no outputs; wakes quickly
+    GYRO_ACTIVE,         // Measuring on every axis
+    GYRO_POWER_MODES
+} Gyroscope_PowerMode;
 
 // Initialization parameters
 typedef struct
@@ -96,6 +123,111 @@ typedef struct
     uint8_t conf4;       // full sacle selection
 } Gyroscope_Init_Parameters;
 
+/*******************************************************************************
+ * Compile-time sensor configuration
+ *
+ * Gyro<ODR, FullScale, Bandwidth> resolves the control register values, the
+ * sensitivity and the sample period when the firmware is built. Combinations
+ * the L3GD20 does not support fail to compile, and every conversion multiplies
+ * by a literal instead of loading a global.
+ ******************************************************************************/
+#define GYRO_INVALID 0xff // Marks a setting the sensor does not offer
+
+// Control register 1 rate and bandwidth bits; 12 selects the 12.5 Hz cutoff
+constexpr uint8_t GyroOdrBits(uint32_t odr_hz, uint32_t cutoff_hz)
+{
+    if (odr_hz == 100)
+    {
+        return cutoff_hz == 12 ? ODR_100_CUTOFF_12_5 : cutoff_hz == 25 ? ODR_100_CUTOFF_25 : GYRO_INVALID;
+    }
+    if (odr_hz == 200)
+    {
+        return cutoff_hz == 12 ? ODR_200_CUTOFF_12_5 : cutoff_hz == 25 ? ODR_200_CUTOFF_25
+             : cutoff_hz == 50 ? ODR_200_CUTOFF_50 : cutoff_hz == 70 ? ODR_200_CUTOFF_70 : GYRO_INVALID;
+    }
+    if (odr_hz == 400)
+    {
+        return cutoff_hz == 20 ? ODR_400_CUTOFF_20 : cutoff_hz == 25 ? ODR_400_CUTOFF_25
+             : cutoff_hz == 50 ? ODR_400_CUTOFF_50 : cutoff_hz == 110 ? ODR_400_CUTOFF_110 : GYRO_INVALID;
+    }
+    if (odr_hz == 800)
+    {
+        return cutoff_hz == 30 ? ODR_800_CUTOFF_30 : cutoff_hz == 35 ? ODR_800_CUTOFF_35
+             : cutoff_hz == 50 ? ODR_800_CUTOFF_50 : cutoff_hz == 110 ? ODR_800_CUTOFF_110 : GYRO_INVALID;
+    }
+    return GYRO_INVALID;
+}
+
+// Control register 4 full-scale bits
+constexpr uint8_t GyroFullScaleBits(uint32_t full_scale_dps)
+{
+    return full_scale_dps == 245 ? FULL_SCALE_245 : full_scale_dps == 500 ? FULL_SCALE_500
+         : full_scale_dps == 2000 ? FULL_SCALE_2000 : GYRO_INVALID;
+}
+
+// Control register 2 high pass cutoff near 0.45 Hz, which removes the zero-rate level but keeps gestures
+constexpr uint8_t GyroHighPassBits(uint32_t odr_hz)
+{
+    return odr_hz == 100 ? HIGH_PASS_0_45_AT_100 : odr_hz == 200 ? HIGH_PASS_0_45_AT_100 + 1
+         : odr_hz == 400 ? HIGH_PASS_0_45_AT_100 + 2 : odr_hz == 800 ? HIGH_PASS_0_45_AT_100 + 3 : GYRO_INVALID;
+}
+
+// Sensitivity in dps/digit
+constexpr float GyroSensitivity(uint32_t full_scale_dps)
+{
+    return full_scale_dps == 245 ? SENSITIVITY_245 : full_scale_dps == 500 ? SENSITIVITY_500 : SENSITIVITY_2000;
+}
+
+/*******************************************************************************
+ * Class: Gyro
+ * -----------------------------------------------------------------------------
+ * Template parameters:
+ *  - ODR_HZ: Output data rate, 100, 200, 400 or 800.
+ *  - FULL_SCALE_DPS: Measurement range, 245, 500 or 2000.
+ *  - CUTOFF_HZ: Low-pass bandwidth, one the sensor offers at ODR_HZ.
+ ******************************************************************************/
+template <uint32_t ODR_HZ, uint32_t FULL_SCALE_DPS, uint32_t CUTOFF_HZ>
+class Gyro
+{
+public:
+    static constexpr uint32_t odr_hz = ODR_HZ;                                   // Samples per second
+    static constexpr uint8_t ctrl_reg1 = GyroOdrBits(ODR_HZ, CUTOFF_HZ);         // Rate and bandwidth bits
+    static constexpr uint8_t ctrl_reg4 = GyroFullScaleBits(FULL_SCALE_DPS);      // Full-scale bits
+    static constexpr uint8_t ctrl_reg2 = GyroHighPassBits(ODR_HZ);               // High-pass cutoff for wake-on-motion
+    static constexpr float sensitivity = GyroSensitivity(FULL_SCALE_DPS);        // dps per digit
+    static constexpr float sample_period = 1.0f / ODR_HZ;                        // Seconds between samples
+
+    static_assert(ctrl_reg1 != GYRO_INVALID, "L3GD20 has no such ODR and cutoff combination");
+    static_assert(ctrl_reg4 != GYRO_INVALID, "L3GD20 full scale must be 245, 500 or 2000 dps");
+
+    // Register values for ConfigureGyroscope, with the given CTRL_REG_3 interrupt setup
+    static Gyroscope_Init_Parameters parameters(uint8_t interrupts)
+    {
+        Gyroscope_Init_Parameters init_parameters;
+        init_parameters.conf1 = ctrl_reg1;
+        init_parameters.conf3 = interrupts;
+        init_parameters.conf4 = ctrl_reg4;
+        return init_parameters;
+    }
+
+    // Data conversion: raw -> dps
+    static float to_dps(int16_t raw)
+    {
+        return raw * sensitivity;
+    }
+
+    // Data conversion: dps -> raw, for interrupt thresholds
+    static constexpr uint16_t to_raw(float dps)
+    {
+        return (uint16_t)(dps / sensitivity);
+    }
+};
+
+template <uint32_t ODR_HZ, uint32_t FULL_SCALE_DPS, uint32_t CUTOFF_HZ>
+constexpr float Gyro<ODR_HZ, FULL_SCALE_DPS, CUTOFF_HZ>::sensitivity;
+template <uint32_t ODR_HZ, uint32_t FULL_SCALE_DPS, uint32_t CUTOFF_HZ>
+constexpr float Gyro<ODR_HZ, FULL_SCALE_DPS, CUTOFF_HZ>::sample_period;
+
 // Raw data
 typedef struct
 {
@@ -104,37 +236,38 @@ typedef struct
     int16_t z_raw; // Z-axis raw data
 } Gyroscope_RawData;
 
-// Calibrated data
-typedef struct
-{
-    int16_t x_calibrated; // X-axis calibrated data
-    int16_t y_calibrated; // Y-axis calibrated data
-    int16_t z_calibrated; // Z-axis calibrated data
-} Gyroscope_CalibratedData;
-
 // Write IO
 void WriteByte(uint8_t address, uint8_t data);
 
+// Read one register
+uint8_t ReadByte(uint8_t address);
+
 // Read IO
 void GetGyroValue(Gyroscope_RawData *rawdata);
 
-// Gyroscope calibration
-void CalibrateGyroscope(Gyroscope_RawData *rawdata);
+// Gyroscope calibration; wait_sample(i) returns once sample i is ready, nullptr polls STATUS_REG
+void CalibrateGyroscope(Gyroscope_RawData *rawdata, void (*wait_sample)(int sample) = nullptr);
+
+// Gyroscope register setup, leaves the sensor active without calibrating it
+void ConfigureGyroscope(Gyroscope_Init_Parameters *init_parameters, Gyroscope_RawData *init_raw_data);
+
+// Switch the power mode, keeping the configured rate and bandwidth
+void SetGyroscopePower(Gyroscope_PowerMode mode);
 
-// Gyroscope initialization
-void InitiateGyroscope(Gyroscope_Init_Parameters *init_parameters, Gyroscope_RawData *init_raw_data);
+// Current power mode
+Gyroscope_PowerMode GetGyroscopePower();
 
-// Data conversion: raw -> dps
-float ConvertToDPS(int16_t rawdata);
+// Milliseconds spent in a power mode since boot, including the current stretch
+uint32_t GetGyroscopePowerTime(Gyroscope_PowerMode mode);
 
-// Data conversion: dps -> m/s
-float ConvertToVelocity(int16_t rawdata);
+// Route threshold events to INT1 and keep the latest samples in the FIFO; DRDY is disabled meanwhile
+void EnableMotionInterrupt(uint16_t threshold, uint8_t duration, uint8_t high_pass);
 
-// Calculate distance from raw data array;
-float GetDistance(int16_t arr[]);
+// Undo EnableMotionInterrupt, restoring the configured interrupt routing
+void DisableMotionInterrupt();
 
-// Get calibrated data
-void GetCalibratedRawData();
+// Samples waiting in the FIFO
+uint32_t GetGyroFifoLevel();
 
-// Turn off the gyroscope
-void PowerOff();
\ No newline at end of file
+// Get zero-rate corrected data
+void GetOffsetCorrectedRawData();
\ No newline at end of file
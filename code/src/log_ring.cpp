@@ -0,0 +1,274 @@
+#include <stdio.h>                               // Include snprintf
+#include <atomic>                                // Include the atomic indices
+#include "log_ring.h"                            // Include the log ring header
+
+#if defined(__MBED__)
+#include "hal/us_ticker_api.h"                   // Include the microsecond ticker
+#else
+#include <chrono>                                // Include the host clock
+#endif
+
+// Ring slot; sequence == index + 1 once the entry is published, index + LOG_RING_SIZE once it is read
+typedef struct
+{
+    std::atomic<uint32_t> sequence;              // Publication state of the slot
+    Log_Entry entry;                             // Payload
+} Log_Slot;
+
+static Log_Slot log_slots[LOG_RING_SIZE];        // Entry storage
+static std::atomic<uint32_t> log_head;           // Next index to claim, shared by all producers
+static std::atomic<uint32_t> log_tail;           // Next index to read, owned by the consumer
+static std::atomic<uint32_t> log_drops;          // Entries lost to a full ring
+static void (*log_notify)();                     // Consumer wake-up
+
+// Microseconds since boot, wrapping like the ticker
+static uint32_t log_timestamp()
+{
+#if defined(__MBED__)
+    return us_ticker_read();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*******************************************************************************
+ * Function: log_init
+ * -----------------------------------------------------------------------------
+ * Empties the ring. Call once at boot before any thread logs.
+ *
+ * Parameters:
+ *  - notify: Called by the producer whose entry lands in an empty ring, so the
+ *            consumer can sleep between bursts. Must be ISR safe.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void log_init(void (*notify)())
+{
+    for (uint32_t i = 0; i < LOG_RING_SIZE; i++)
+    {
+        log_slots[i].sequence.store(i, std::memory_order_relaxed); // Every slot free for its first lap
+    }
+    log_head.store(0, std::memory_order_relaxed);
+    log_tail.store(0, std::memory_order_relaxed);
+    log_drops.store(0, std::memory_order_relaxed);
+    log_notify = notify;
+}
+
+/*******************************************************************************
+ * Function: log_write
+ * -----------------------------------------------------------------------------
+ * Claims the next slot with a compare-and-swap on log_head, fills it and
+ * publishes it through its sequence number. Producers only ever retry when
+ * another producer claimed the same slot first, so the call is lock-free and
+ * safe from interrupts.
+ *
+ * Parameters:
+ *  - format: Format string with static storage.
+ *  - args: Packed arguments.
+ *  - count: Number of arguments, at most LOG_MAX_ARGS.
+ *
+ * Returns:
+ *  - true if the entry was queued, false if the ring was full.
+ ******************************************************************************/
+bool log_write(const char *format, const Log_Arg *args, uint32_t count)
+{
+    uint32_t index = log_head.load(std::memory_order_relaxed);
+    Log_Slot *slot;
+    while (1)
+    {
+        slot = &log_slots[index & (LOG_RING_SIZE - 1)];
+        int32_t lap = (int32_t)(slot->sequence.load(std::memory_order_acquire) - index);
+        if (lap == 0)
+        {
+            // Slot is free; claim it unless another producer got there first
+            if (log_head.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (lap < 0)
+        {
+            log_drops.fetch_add(1, std::memory_order_relaxed); // Consumer has not read this slot yet
+            return false;
+        }
+        else
+        {
+            index = log_head.load(std::memory_order_relaxed); // Another producer claimed it, try the next one
+        }
+    }
+
+    slot->entry.format = format;
+    slot->entry.timestamp_us = log_timestamp();
+    slot->entry.count = count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        slot->entry.args[i] = args[i];
+    }
+    slot->sequence.store(index + 1, std::memory_order_release); // Publish to the consumer
+
+    // Only the first entry after the consumer caught up needs to wake it
+    if (log_notify != nullptr && index == log_tail.load(std::memory_order_acquire))
+    {
+        log_notify();
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function: log_read
+ * -----------------------------------------------------------------------------
+ * Copies out the oldest entry and frees its slot for the next lap. Entries
+ * are read in claim order, so an entry still being written holds back the
+ * ones behind it until its producer finishes.
+ *
+ * Parameters:
+ *  - entry: Receives the entry.
+ *
+ * Returns:
+ *  - true if an entry was read.
+ ******************************************************************************/
+bool log_read(Log_Entry &entry)
+{
+    uint32_t index = log_tail.load(std::memory_order_relaxed);
+    Log_Slot &slot = log_slots[index & (LOG_RING_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+    {
+        return false;                                // Empty, or the producer is still writing
+    }
+    entry = slot.entry;
+    slot.sequence.store(index + LOG_RING_SIZE, std::memory_order_release); // Free for the next lap
+    log_tail.store(index + 1, std::memory_order_release);
+    return true;
+}
+
+/*******************************************************************************
+ * Function: log_pending
+ * -----------------------------------------------------------------------------
+ * Tells the consumer whether to retry instead of sleeping after log_read()
+ * failed: a producer that claimed a slot but was preempted before publishing
+ * it does not notify again.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - true if a claimed slot has not been read yet.
+ ******************************************************************************/
+bool log_pending()
+{
+    return log_head.load(std::memory_order_acquire) != log_tail.load(std::memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * Function: log_dropped
+ * -----------------------------------------------------------------------------
+ * Returns the number of entries dropped because the ring was full.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - Dropped entries since log_init().
+ ******************************************************************************/
+uint32_t log_dropped()
+{
+    return log_drops.load(std::memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * Function: log_format
+ * -----------------------------------------------------------------------------
+ * Expands an entry's format with its stored arguments. Literal text is copied
+ * directly and every conversion is handed to snprintf with its argument cast
+ * back to the type the conversion expects. Missing arguments print as 0.
+ *
+ * Parameters:
+ *  - entry: Entry to format.
+ *  - out: Output buffer, always terminated.
+ *  - size: Size of out in bytes, at least 1.
+ *
+ * Returns:
+ *  - Number of characters written, excluding the terminator.
+ ******************************************************************************/
+size_t log_format(const Log_Entry &entry, char *out, size_t size)
+{
+    const char *p = entry.format;                    // Next format character
+    uint32_t arg = 0;                                // Next argument
+    size_t used = 0;                                 // Characters written
+
+    while (*p != '\0' && used + 1 < size)
+    {
+        if (*p != '%')
+        {
+            out[used++] = *p++;                      // Literal text
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out[used++] = '%';                       // Escaped percent sign
+            p += 2;
+            continue;
+        }
+
+        // Copy the conversion specification up to and including its conversion character
+        char spec[16];
+        size_t length = 0;
+        bool is_long = false;                        // l modifier present
+        spec[length++] = *p++;
+        while (*p != '\0' && strchr("diuxXcspfFeEgG", *p) == nullptr && length < sizeof(spec) - 2)
+        {
+            is_long |= (*p == 'l');
+            spec[length++] = *p++;
+        }
+        if (*p == '\0')
+        {
+            break;                                   // Truncated specification
+        }
+        char conversion = *p++;
+        spec[length++] = conversion;
+        spec[length] = '\0';
+
+        Log_Arg value = arg < entry.count ? entry.args[arg] : 0;
+        arg++;
+        int written;
+        switch (conversion)
+        {
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        {
+            float number;
+            memcpy(&number, &value, sizeof(number)); // Undo log_arg(float)
+            written = snprintf(out + used, size - used, spec, (double)number);
+            break;
+        }
+        case 's':
+            written = snprintf(out + used, size - used, spec, value ? (const char *)value : "(null)");
+            break;
+        case 'p':
+            written = snprintf(out + used, size - used, spec, (void *)value);
+            break;
+        default:
+            if (is_long)
+            {
+                written = snprintf(out + used, size - used, spec, (unsigned long)value);
+            }
+            else
+            {
+                written = snprintf(out + used, size - used, spec, (unsigned)value);
+            }
+            break;
+        }
+        if (written > 0)
+        {
+            used += (size_t)written < size - used ? (size_t)written : size - used - 1; // snprintf truncated at the end
+        }
+    }
+    out[used] = '\0';
+    return used;
+}
@@ -0,0 +1,103 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Deferred-formatting log ring
+ *
+ * log_printf() stores the address of its format string, a timestamp and its
+ * arguments as raw words in a fixed ring; a low-priority thread formats and
+ * prints the entries later with log_read() and log_format(). Logging from the
+ * capture or matcher path is therefore a slot claim and a few stores, and it
+ * never waits for the UART. When the ring is full the entry is dropped and
+ * counted.
+ *
+ * The ring accepts any number of producers, threads or ISRs: a slot is
+ * claimed with a compare-and-swap on the write index (LDREX/STREX on the M4)
+ * and published through its own sequence number, so a producer preempted
+ * half-way never blocks another one. There is exactly one consumer.
+ *
+ * Formats and %s arguments are kept by address, so both must have static
+ * storage (string literals). Supported conversions are d i u x X c s p and
+ * f e g with the usual flags, width, precision and l modifier; '*' widths
+ * are not.
+ ******************************************************************************/
+
+#define LOG_RING_SIZE 64           // Entries in the ring, a power of two
+#define LOG_MAX_ARGS 6             // Arguments per entry
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+// One argument word; pointer sized so %s and %p survive on host builds
+typedef uintptr_t Log_Arg;
+
+// One deferred log line
+typedef struct
+{
+    const char *format;            // Format string, doubles as the message ID
+    uint32_t timestamp_us;         // Time of the log_printf call
+    uint32_t count;                // Arguments used
+    Log_Arg args[LOG_MAX_ARGS];    // Arguments as raw words, floats by bit pattern
+} Log_Entry;
+
+// Clear the ring; notify runs when an entry lands in an empty ring (may be nullptr)
+void log_init(void (*notify)());
+
+// Append one entry; returns false if the ring was full and the entry dropped
+bool log_write(const char *format, const Log_Arg *args, uint32_t count);
+
+// Take the oldest published entry (consumer only); returns false if there is none
+bool log_read(Log_Entry &entry);
+
+// True while a producer has claimed a slot that is not read yet
+bool log_pending();
+
+// Entries dropped because the ring was full
+uint32_t log_dropped();
+
+// Format an entry like snprintf would have, returns the length written
+size_t log_format(const Log_Entry &entry, char *out, size_t size);
+
+// Argument packing: floats keep their bit pattern, everything else is a word
+static inline Log_Arg log_arg(float value)
+{
+    Log_Arg word = 0;
+    memcpy(&word, &value, sizeof(value));            // Low word on little-endian targets
+    return word;
+}
+
+static inline Log_Arg log_arg(double value)
+{
+    return log_arg((float)value);                    // Logged at float precision
+}
+
+template <typename T>
+static inline Log_Arg log_arg(T value)
+{
+    return (Log_Arg)value;                           // Integers, enums and pointers
+}
+
+/*******************************************************************************
+ * Function: log_printf
+ * -----------------------------------------------------------------------------
+ * Queues a printf-style message without formatting it.
+ *
+ * Parameters:
+ *  - format: printf format string with static storage.
+ *  - args: Up to LOG_MAX_ARGS arguments.
+ *
+ * Returns:
+ *  - true if the entry was queued, false if the ring was full.
+ ******************************************************************************/
+template <typename... Args>
+static inline bool log_printf(const char *format, Args... args)
+{
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+    const Log_Arg words[sizeof...(Args) + 1] = {log_arg(args)..., 0}; // Trailing word keeps the array non-empty
+    return log_write(format, words, sizeof...(Args));
+}
+
+#endif
@@ -7,30 +7,234 @@ Project Team Members:
 
 
 #include <mbed.h>                                // Include the mbed OS header
-#include <vector>                                // Include the vector container
 #include <array>                                 // Include the array container
 #include <limits>                                // Include limits for numeric limits
 #include <cmath>                                 // Include cmath for mathematical functions
 #include <math.h>                                // Include math.h for additional math functions
 #include "gyro.h"                                // Include custom gyroscope header
+#include "spsc_queue.h"                          // Include lock-free queue used between pipeline stages
+#include "sample_ring.h"                         // Include the pre-trigger history ring
+#include "gesture_arena.h"                       // Include the static bump allocator
+#include "gesture_trace.h"                       // Include fixed-capacity gesture traces
+#include "filter.h"                              // Include the per-sample filter stages
+#include "decimator.h"                           // Include the polyphase decimator
+#include "segmenter.h"                           // Include the energy-based gesture segmenter
+#include "gesture_template.h"                    // Include gesture traces with their resampled copies
+#include "gesture_codec.h"                       // Include the compressed trace format for flash
+#include "controller_state.h"                    // Include the controller states and the erase gate
+#include "matcher.h"                             // Include the correlation and DTW matchers
+#include "ensemble.h"                            // Include the fused matcher ensemble
+#include "orientation.h"                         // Include the quaternion orientation tracker
+#include "profiler.h"                            // Include the cycle profiler
+#include "telemetry.h"                           // Include the binary telemetry framing
+#include "log_ring.h"                            // Include the deferred log
+#include "metrics.h"                             // Include the runtime metrics registry
 #include "drivers/LCD_DISCO_F429ZI.h"           // Include LCD driver for DISCO_F429ZI board
 #include "drivers/TS_DISCO_F429ZI.h"            // Include Touch Screen driver for DISCO_F429ZI board
 
 // Define event flags using bitmask values
-#define KEY_FLAG 1                                // Flag for key recording event
-#define UNLOCK_FLAG 2                             // Flag for unlock event
-#define ERASE_FLAG 4                              // Flag for erase event
 #define DATA_READY_FLAG 8                         // Flag indicating gyroscope data is ready
+#define CALIBRATE_FLAG 16                         // Flag asking the capture thread to calibrate the gyroscope
+#define CAPTURE_FLAG 32                           // Flag asking the capture thread to record a gesture
+#define CAPTURE_STOP_FLAG 64                      // Flag asking the capture thread to end the recording
+#define LOG_READY_FLAG 128                        // Flag telling the log thread that entries are waiting
+#define TOUCH_FLAG 256                            // Flag raised by the touch controller interrupt
+#define MOTION_FLAG 512                           // Flag raised by the gyroscope threshold interrupt
+#define MOTION_ARM_FLAG 1024                      // Flag asking the capture thread to watch for motion
+#define MOTION_DISARM_FLAG 2048                   // Flag asking the capture thread to stop watching
+#define CONSOLE_WAKE_FLAG 4096                    // Flag raised by a falling edge on the idle console RX line
+#define CONSOLE_INPUT_FLAG 8192                   // Flag raised when the console receives a character
+
+// Define pipeline wake-up flags
+#define RAW_READY_FLAG 1                          // Raw samples are waiting for the preprocess stage
+#define TRACE_READY_FLAG 2                        // Preprocessed samples are waiting for the matcher stage
+
+// Define telemetry wake-up flags
+#define TELEMETRY_DATA_FLAG 1                     // Records are waiting to be framed
+#define TELEMETRY_TX_DONE_FLAG 2                  // The previous DMA transfer finished
 
 // Define LCD font size
 #define FONT_SIZE 16                              // Font size for LCD text
 
-// Define the correlation threshold for unlocking
-#define CORRELATION_THRESHOLD 0.0005f               // Threshold value for gesture correlation
+// Define the monitored threads, one stack gauge each
+#define THREAD_COUNT 9                            // Threads started by main
+
+// Define state machine timings
+#define TOUCH_CAPTURE_TARGET_US 200000            // Longest acceptable time from a touch to the capture start
+#define PROGRESS_HEIGHT 4                         // Height of the progress bar under the status line
+#define RESULT_HOLD_TIME 3s                       // Time a result stays on screen before returning to idle
+
+// Define message queue depths
+#define CONTROLLER_QUEUE_SIZE 16                  // Maximum pending events for the controller thread
+#define UI_QUEUE_SIZE 16                          // Maximum pending LCD updates for the UI thread
+#define UI_TEXT_SIZE 32                           // Maximum length of a status line message
+#define PIPELINE_QUEUE_SIZE 32                    // Depth of each queue between pipeline stages
+#define TELEMETRY_RAW_QUEUE_SIZE 128              // Raw samples buffered for the telemetry thread (160 ms at 800 Hz)
+#define TELEMETRY_FILTERED_QUEUE_SIZE 32          // Segment-rate samples buffered for the telemetry thread
+#define TELEMETRY_MAIL_SIZE 4                     // Match and profile records buffered for the telemetry thread
+#define TELEMETRY_TX_BUFFER 1024                  // Bytes per DMA transfer, two buffers alternate
+#define LOG_LINE_SIZE 160                         // Longest formatted log line
+#define METRIC_LINE_SIZE 64                       // Longest metric line on the diagnostics screen
+
+// Define the sensor configuration, resolved at compile time
+typedef Gyro<800, 500, 50> CaptureGyro;           // 800Hz ODR, ±500 dps, 50Hz bandwidth
+
+// Define the sample rates: ODR -> SEGMENT_RATE_HZ for segmentation -> GESTURE_RATE_HZ for matching
+#define CAPTURE_DECIMATION (CaptureGyro::odr_hz / SEGMENT_RATE_HZ) // DRDY samples per segmenter sample
+#define MATCH_DECIMATION (SEGMENT_RATE_HZ / GESTURE_RATE_HZ) // Segmenter samples per matcher sample
+static_assert(CaptureGyro::odr_hz % SEGMENT_RATE_HZ == 0, "ODR must be a multiple of the segment rate");
+
+// Define capture timing
+#define DRDY_TIMEOUT 2ms                          // Poll the sensor if a DRDY edge was missed
+#define CAPTURE_SAMPLE_US (1000000 / CaptureGyro::odr_hz) // Spacing of the samples taken from the FIFO
+#define PRETRIGGER_MS MBED_CONF_APP_PRETRIGGER_MS // History kept before a capture starts, set in mbed_app.json
+#define PRETRIGGER_SAMPLES (PRETRIGGER_MS * SEGMENT_RATE_HZ / 1000) // The same history in segment-rate samples
+#define PRETRIGGER_RING_SIZE sample_ring_size(PRETRIGGER_SAMPLES + PIPELINE_QUEUE_SIZE) // History plus room for a busy preprocess stage
+#define CAPTURE_TIMEOUT 10s                       // Hard limit on a recording if the segmenter never stops it
+
+// Define the power policy
+#define GYRO_POWER_DOWN_DELAY 30s                 // Idle time in sleep mode before the gyroscope powers down
+#define GYRO_WAKE_TIMEOUT 300ms                   // Longest wait for the first sample after a wake-up
+#define CONSOLE_IDLE_TIMEOUT 30s                  // Quiet time before the console receiver is turned off
+#define GYRO_WAKE_DISCARD 8                       // Samples dropped after a wake-up while the output settles
+#define CALIBRATION_LIFETIME 10min                // Zero-rate levels older than this are measured again
+#define TOUCH_RELEASE_POLL 20ms                   // Poll interval while a finger stays on the screen
+
+// Define wake-on-motion, checked by the gyroscope while the CPU sleeps
+#define MOTION_WAKE_DPS 60.0f                     // High-pass filtered rate on any axis that starts a hands-free unlock
+#define MOTION_WAKE_DURATION 4                    // Samples the rate must stay above it, 5 ms at 800 Hz
+
+// Define segmentation limits at the segment rate
+#define SEGMENT_START_TIMEOUT (5 * SEGMENT_RATE_HZ) // Give up if no motion starts within 5 seconds
+
+// Define the capture filter, run on every axis of every DRDY sample before decimation
+typedef FilterChain<Median3> CaptureFilter;       // Spike removal at the full rate
+typedef PolyphaseDecimator<CAPTURE_DECIMATION, 8> CaptureDecimator; // Anti-alias to 40 Hz, down to the segment rate
+#define FILTER_BUDGET_CYCLES 64                   // Cycle budget per axis per sample
+static_assert(CaptureFilter::cost + CaptureDecimator::cost <= FILTER_BUDGET_CYCLES, "Capture filter chain exceeds its per-sample cycle budget");
+
+// Define the matcher decimator, run in the preprocess stage on the segment-rate stream
+typedef PolyphaseDecimator<MATCH_DECIMATION, 6> MatchDecimator; // Anti-alias to 8 Hz, down to the gesture rate
+#define MATCH_DELAY (MatchDecimator::length / 2)  // Group delay of MatchDecimator in segment-rate samples
+static_assert(MATCH_DELAY < 32, "Moving flags are delayed through a 32-bit shift register");
+#define SEGMENT_PREROLL ((SEGMENT_WINDOW + SEGMENT_START_HOLD) / MATCH_DECIMATION + 1) // Matcher samples before the onset kept with the gesture
+
+// Define the gesture arena; all gesture buffers and matcher scratch live here
+#define GESTURE_ARENA_SIZE (16 * 1024)            // Arena size in bytes
+#ifndef GESTURE_ARENA_SECTION
+#define GESTURE_ARENA_SECTION                     // Define as __attribute__((section(".ccmram"))) to place the arena in CCM RAM
+#endif
+static_assert(3 * TEMPLATE_ARENA_BYTES <= GESTURE_ARENA_SIZE, "Gesture arena cannot hold the key, record and temporary templates");
+
+// Define where and how the gesture key is kept in flash
+#define KEY_CODEC_FORMAT (CODEC_INT8 | CODEC_RICE) // 8-bit Rice-coded differences, about 5x smaller than raw samples
+#define KEY_FLASH_ADDRESS 0x08100000              // Sector 12, 16 KB at the start of bank 2; mbed_app.json ends the image before it
+#define KEY_SLOT_BYTES ((CODEC_MAX_BYTES + 255) & ~255) // Flash bytes per encoded trace; the rates, then the path
+static_assert(2 * KEY_SLOT_BYTES <= 16 * 1024, "The key does not fit its flash sector");
+
+/*******************************************************************************
+ * State Machine Types
+ * ****************************************************************************/
+// Events consumed by the gesture controller
+typedef enum
+{
+    EVENT_RECORD_REQUEST,                         // RECORD or RESET button was touched
+    EVENT_UNLOCK_REQUEST,                         // UNLOCK button was touched
+    EVENT_ERASE_REQUEST,                          // User button was pressed
+    EVENT_CALIBRATION_DONE,                       // Capture thread finished calibrating
+    EVENT_CAPTURE_DONE,                           // Capture thread finished recording
+    EVENT_MATCH_DONE,                             // Matcher thread finished comparing
+    EVENT_RESULT_TIMEOUT,                         // Result hold timer expired
+    EVENT_MOTION_CAPTURE,                         // Capture thread started an unlock on a motion interrupt
+    EVENT_MOTION_MODE                             // Hands-free unlock was switched on or off
+} Controller_EventType;
+
+typedef struct
+{
+    Controller_EventType type;                    // Event type
+    bool success;                                 // Outcome for EVENT_MATCH_DONE
+} Controller_Event;
+
+// LCD updates consumed by the UI thread
+typedef enum
+{
+    UI_STATUS,                                    // Redraw the status line
+    UI_KEY_BUTTONS,                               // Replace RECORD with the RESET and UNLOCK buttons
+    UI_PROGRESS,                                  // Redraw the progress bar under the status line
+    UI_DIAGNOSTICS                                // Toggle between the metrics and the home screen
+} Ui_MessageType;
+
+typedef struct
+{
+    Ui_MessageType type;                          // Message type
+    uint32_t fill_color;                          // Status line background color
+    uint32_t text_color;                          // Status line text color
+    char text[UI_TEXT_SIZE];                      // Status line text
+    uint32_t percent;                             // Progress bar fill, 0 hides the bar
+} Ui_Message;
+
+// Message kinds travelling through the pipeline
+typedef enum
+{
+    PIPELINE_START,                               // A new gesture begins, stages reset their state
+    PIPELINE_SAMPLE,                              // One gyroscope sample
+    PIPELINE_END                                  // The recording window closed
+} Pipeline_Kind;
+
+// Capture -> preprocess message
+typedef struct
+{
+    Pipeline_Kind kind;                           // Message kind
+    uint32_t timestamp_us;                        // DRDY time of the sample
+    Gyroscope_RawData raw;                        // Calibrated raw sample
+    Quaternion orientation;                       // Orientation integrated over every DRDY sample
+} Pipeline_RawSample;
+
+// Preprocess -> matcher message
+typedef struct
+{
+    Pipeline_Kind kind;                           // Message kind
+    uint32_t timestamp_us;                        // DRDY time of the sample
+    array<float, 3> dps;                          // Sample in degrees per second
+    Quaternion orientation;                       // Orientation at this sample
+    bool moving;                                  // True if the segmenter energy is above its end threshold
+} Pipeline_Sample;
+
+// Per-stage counters, each written only by its own stage
+typedef struct
+{
+    uint32_t processed;                           // Samples handled in the current gesture
+    uint32_t dropped;                             // Samples lost because the output queue was full
+    uint32_t max_occupancy;                       // Highest depth of the queue feeding this stage
+    uint32_t last_latency_us;                     // DRDY-to-done latency of the last sample
+    uint32_t max_latency_us;                      // Worst DRDY-to-done latency
+} Stage_Stats;
+
+/*******************************************************************************
+ * Class: TelemetrySerial
+ * -----------------------------------------------------------------------------
+ * Telemetry UART. SerialBase already implements the asynchronous DMA write;
+ * this only makes its constructor reachable. Pins and baud rate come from the
+ * telemetry-* settings in mbed_app.json.
+ ******************************************************************************/
+class TelemetrySerial : public SerialBase
+{
+public:
+    TelemetrySerial(PinName tx, PinName rx, int baud) : SerialBase(tx, rx, baud) {}
+};
 
 // Initialize interrupt inputs with pull-down resistors
+InterruptIn gyro_int1(PA_1, PullDown);            // Interrupt for gyroscope threshold events on pin PA_1
 InterruptIn gyro_int2(PA_2, PullDown);            // Interrupt for gyroscope data ready on pin PA_2
 InterruptIn user_button(PC_13, PullDown);         // Interrupt for user button on pin PC_13
+InterruptIn touch_int(PA_15, PullUp);             // Interrupt from the touch controller, active low
+
+// The console is opened here rather than by the platform, so that its receiver
+// can be turned off while idle: an enabled UART receiver holds off deep sleep.
+// The edge interrupt is constructed first, the UART then takes the pin back for
+// its alternate function, and the EXTI line keeps seeing the pin.
+InterruptIn console_rx_edge(USBRX, PullUp);       // Start bit on the idle console RX line
+BufferedSerial console_serial(USBTX, USBRX, MBED_CONF_PLATFORM_STDIO_BAUD_RATE); // Console UART for stdio and commands
 
 // Initialize digital outputs for LEDs
 DigitalOut green_led(LED1);                        // Green LED indicator
@@ -40,9 +244,81 @@ DigitalOut red_led(LED2);                          // Red LED indicator
 LCD_DISCO_F429ZI lcd;                               // LCD display object for DISCO_F429ZI
 TS_DISCO_F429ZI ts;                                 // Touch screen object for DISCO_F429ZI
 
-// Initialize event flags and timer
+// Initialize event flags, message queues and timers
 EventFlags flags;                                    // Event flags object for inter-thread communication
+Mail<Controller_Event, CONTROLLER_QUEUE_SIZE> controller_mail; // Events for the controller thread
+Mail<Ui_Message, UI_QUEUE_SIZE> ui_mail;             // LCD updates for the UI thread
 Timer timer;                                        // Timer object for measuring elapsed time
+LowPowerTimeout result_timeout;                     // Timer returning from the result state to idle, allows deep sleep
+
+// Pipeline queues and counters
+EventFlags pipeline_flags;                          // Wake-up flags for the pipeline stages
+SpscQueue<Pipeline_RawSample, PIPELINE_QUEUE_SIZE> raw_queue;  // Capture -> preprocess
+SpscQueue<Pipeline_Sample, PIPELINE_QUEUE_SIZE> trace_queue;   // Preprocess -> matcher
+Stage_Stats capture_stats;                          // Capture stage counters
+Stage_Stats preprocess_stats;                       // Preprocess stage counters
+Stage_Stats matcher_stats;                          // Matcher stage counters
+volatile uint32_t drdy_timestamp_us;                // Time of the last DRDY edge
+volatile bool capture_for_unlock;                   // True when the running capture is an unlock attempt
+volatile uint32_t motion_timestamp_us;              // Time of the last threshold interrupt
+volatile uint32_t touch_timestamp_us;               // Time of the last touch interrupt
+volatile uint32_t request_timestamp_us;             // Touch time of the pending record or unlock request, 0 if none
+volatile bool motion_wake_enabled;                  // True when motion starts an unlock without a touch
+CaptureFilter capture_filter[3];                    // Filter state per axis, owned by the capture thread
+CaptureDecimator capture_decimator[3];              // Decimator state per axis, owned by the capture thread
+SampleRing<Pipeline_RawSample, PRETRIGGER_RING_SIZE> pretrigger; // Latest segment-rate samples, owned by the capture thread
+MatchDecimator match_decimator[3];                  // Decimator state per axis, owned by the preprocess thread
+
+// Telemetry queues and counters
+EventFlags telemetry_flags;                         // Wake-up flags for the telemetry thread
+SpscQueue<Telemetry_Sample, TELEMETRY_RAW_QUEUE_SIZE> telemetry_raw_queue;           // Capture -> telemetry
+SpscQueue<Telemetry_Sample, TELEMETRY_FILTERED_QUEUE_SIZE> telemetry_filtered_queue; // Preprocess -> telemetry
+Mail<Telemetry_Record, TELEMETRY_MAIL_SIZE> telemetry_mail; // Matcher and console -> telemetry
+uint8_t telemetry_buffers[2][TELEMETRY_TX_BUFFER];  // One buffer is filled while the other is on the wire
+volatile bool telemetry_enabled;                    // True while the host wants the stream
+
+// Production metrics, listed by the 'm' console command and the diagnostics screen
+Counter unlock_attempts("unlock.attempts");         // Unlock requests accepted by the controller
+Counter unlock_success("unlock.success");           // Attempts that matched the key
+Counter unlock_failure("unlock.failure");           // Attempts that were compared and rejected
+Counter drdy_missed("drdy.missed");                 // DRDY edges that never came, the sample was polled
+Counter pipeline_dropped("pipeline.dropped");       // Samples lost between pipeline stages
+Counter flash_writes("flash.writes");               // Flash program operations
+Counter lcd_redraws("lcd.redraws");                 // LCD updates drawn by the UI thread
+Counter telemetry_dropped("telemetry.dropped");     // Records lost because a telemetry queue was full
+Gauge log_lost("log.dropped");                      // Log entries lost to a full ring
+Gauge heap_current("heap.current", "B");            // Heap in use
+Gauge heap_peak("heap.peak", "B");                  // Heap high-water mark
+Gauge arena_peak("arena.peak", "B");                // Gesture arena high-water mark
+Gauge stack_peak[THREAD_COUNT] = {                  // Stack high-water mark per thread, in thread_list order
+    {"stack.capture", "B"}, {"stack.preprocess", "B"}, {"stack.controller", "B"},
+    {"stack.touch", "B"}, {"stack.matcher", "B"}, {"stack.ui", "B"},
+    {"stack.console", "B"}, {"stack.telemetry", "B"}, {"stack.log", "B"}};
+Histogram verdict_latency("latency.verdict");       // End of gesture to unlock verdict
+Histogram matcher_latency[MATCHER_COUNT] = {        // Time per matcher, in Matcher_Id order
+    {"latency.match.features"}, {"latency.match.correlation"},
+    {"latency.match.rate_dtw"}, {"latency.match.derivative_dtw"},
+    {"latency.match.znorm_dtw"}, {"latency.match.path_dtw"}};
+Counter matcher_pivotal[MATCHER_COUNT] = {          // Verdicts that would flip without the matcher
+    {"match.pivotal.features"}, {"match.pivotal.correlation"},
+    {"match.pivotal.rate_dtw"}, {"match.pivotal.derivative_dtw"},
+    {"match.pivotal.znorm_dtw"}, {"match.pivotal.path_dtw"}};
+Histogram sample_latency("latency.sample");         // DRDY edge to the matcher stage
+Histogram lcd_latency("latency.lcd");               // Drawing one LCD update
+Histogram gyro_wake_latency("latency.gyro_wake");   // Gyroscope wake-up to its first sample
+Histogram motion_wake_latency("latency.motion_wake"); // Threshold interrupt to the start of the capture
+Histogram motion_pretrigger("motion.pretrigger", "samples"); // FIFO samples recorded before the capture started
+Counter motion_wakes("motion.wakes");               // Unlocks started by the threshold interrupt
+Counter console_wakes("console.wakes");             // Console receiver turned on by an RX edge
+Histogram pretrigger_samples("capture.pretrigger", "samples"); // Ring samples forwarded ahead of each capture
+Histogram touch_capture_latency("latency.touch_to_capture"); // Touch to the start of the capture
+Counter slow_capture_starts("capture.slow_starts");  // Captures that started later than TOUCH_CAPTURE_TARGET_US after the touch
+Gauge gyro_active_share("gyro.active", "%");        // Share of uptime the gyroscope measured
+Gauge gyro_sleep_share("gyro.sleep", "%");          // Share of uptime in sleep mode
+Gauge gyro_off_share("gyro.off", "%");              // Share of uptime powered down
+Gauge cpu_active_share("cpu.active", "%");          // Share of uptime the CPU was not idle, needs platform.cpu-stats-enabled
+Gauge cpu_deep_sleep_share("cpu.deep_sleep", "%");  // Share of uptime in deep sleep
+Thread *thread_list[THREAD_COUNT];                  // Threads whose stacks are sampled, set by main
 
 /*******************************************************************************
  * Function Prototypes for LCD and Touch Screen Operations
@@ -50,33 +326,77 @@ Timer timer;                                        // Timer object for measurin
 void draw_button(int x, int y, int width, int height, const char *label); // Function to draw a button on the LCD
 bool is_touch_inside_button(int touch_x, int touch_y, int button_x, int button_y, int button_width, int button_height); // Function to check if touch is inside a button
 void remove_button(int x, int y, int width, int height); // Function to remove a button from the LCD
+void show_status(const char *text, uint32_t fill_color, uint32_t text_color); // Queue a status line update for the UI thread
+void show_progress(uint32_t percent);               // Queue a progress bar update for the UI thread
+void report_copies(const char *flow, uint32_t since); // Log the bytes a controller flow copied
+void controller_enter(Controller_State &state, Controller_State next, Erase_Gate &gate); // Change state, serving a held erase
 
 /*******************************************************************************
  * Function Prototypes for Data Processing
  * ****************************************************************************/
-float euclidean_distance(const array<float, 3> &a, const array<float, 3> &b); // Calculate Euclidean distance between two 3D vectors
-float dtw(const vector<array<float, 3>> &s, const vector<array<float, 3>> &t); // Calculate Dynamic Time Warping distance between two gesture sequences
-void trim_gyro_data(vector<array<float, 3>> &data); // Trim insignificant gyroscope data from a gesture sequence
-float correlation(const vector<float> &a, const vector<float> &b); // Calculate Pearson correlation between two vectors
-array<float, 3> calculateCorrelationVectors(vector<array<float, 3>>& vec1, vector<array<float, 3>>& vec2); // Calculate correlation for each axis between two gesture sequences
+uint32_t stage_record(Stage_Stats &stats, uint32_t timestamp_us); // Update stage latency counters for one sample
+void gyro_wake(Gyroscope_RawData &raw_data);        // Bring the gyroscope to active mode
+void capture_restart(Quaternion &orientation);      // Reset the capture chain and the pre-trigger ring
+uint32_t capture_wait();                            // Wait for DRDY, returns the sample time
+bool capture_step(Gyroscope_RawData &raw_data, uint32_t sample_us, uint32_t &last_us, Quaternion &orientation,
+                  Pipeline_RawSample &message);     // Run one DRDY sample through the capture chain
+void capture_forward(uint32_t &cursor, uint32_t live); // Forward pre-trigger ring entries to the preprocess stage
+void calibration_wait(int sample);                  // Wait for one calibration sample and show progress
+void motion_wake_update(bool idle);                 // Arm or disarm the threshold interrupt
+void print_stage_stats(const char *name, const Stage_Stats &stats); // Log the counters of one pipeline stage
+template <typename Queue>
+void telemetry_push_sample(Queue &queue, uint32_t timestamp_us, const Gyroscope_RawData &raw); // Queue one sample for the telemetry thread
+bool telemetry_post(const Telemetry_Record &record, Kernel::Clock::duration_u32 timeout); // Queue one record for the telemetry thread
+void telemetry_send_gesture(const Gesture_Template &gesture, uint32_t end_us); // Stream a finished capture for the host corpus
+void metrics_refresh();                             // Sample every gauge
+void draw_diagnostics();                            // Draw the metrics on the LCD
+void draw_home_screen();                            // Redraw the buttons and banners
 
 /*******************************************************************************
  * Function Prototypes for Threads
  * ****************************************************************************/
-void gyroscope_thread();                            // Thread function for handling gyroscope data and gesture recording
+void controller_thread();                           // Thread function running the gesture state machine
+void capture_thread();                              // Thread function for calibrating the gyroscope and recording gestures
+void preprocess_thread();                           // Thread function converting and trimming samples
+void matcher_thread();                              // Thread function for comparing gestures
+void ui_thread();                                   // Thread function for drawing on the LCD
 void touch_screen_thread();                         // Thread function for handling touch screen input
+void console_thread();                              // Thread function for serial commands
+void console_command(int command);                  // Run one console command
+void telemetry_thread();                            // Thread function streaming telemetry frames
+void log_thread();                                  // Thread function printing the deferred log
 
 /*******************************************************************************
  * Function Prototypes for Flash Memory Operations
  * ****************************************************************************/
-bool storeGyroDataToFlash(vector<array<float, 3>> &gesture_key, uint32_t flash_address); // Store gyroscope data to flash memory
-vector<array<float, 3>> readGyroDataFromFlash(uint32_t flash_address, size_t data_size); // Read gyroscope data from flash memory
+bool storeGyroDataToFlash(const Gesture_Template &gesture_key, uint32_t flash_address); // Store gyroscope data to flash memory
+bool readGyroDataFromFlash(Gesture_Template &gesture_key, uint32_t flash_address); // Read gyroscope data from flash memory
+bool eraseGyroDataFromFlash(uint32_t flash_address); // Erase gyroscope data from flash memory
 
 /*******************************************************************************
  * Function Prototypes for Filters
  * ****************************************************************************/
-// moving average filter will be defined after main()
-float movingAverageFilter(float input, float display_buffer[], size_t N, size_t &index, float &sum); // Apply a moving average filter to input data
+// The capture filter chain is defined in filter.h and configured by CaptureFilter above;
+// the decimators are defined in decimator.h and configured by CaptureDecimator and MatchDecimator
+
+/*******************************************************************************
+ * @brief Post an Event to the Controller Thread
+ * @param type: The event type
+ * @param success: Outcome attached to the event
+ *
+ * Safe to call from ISR context. The event is dropped if the queue is full.
+ ******************************************************************************/
+void post_event(Controller_EventType type, bool success = false)
+{
+    Controller_Event *event = controller_mail.try_alloc(); // Take a free slot without blocking
+    if (event == nullptr)
+    {
+        return;                                     // Queue full, drop the event
+    }
+    event->type = type;                             // Store the event type
+    event->success = success;                       // Store the event outcome
+    controller_mail.put(event);                     // Hand the event to the controller thread
+}
 
 /*******************************************************************************
  * ISR Callback Functions
@@ -84,24 +404,94 @@ float movingAverageFilter(float input, float display_buffer[], size_t N, size_t
 /**
  * @brief Callback function for user button press interrupt
  */
-void button_press() 
+void button_press()
 {
-    flags.set(ERASE_FLAG);                          // Set the ERASE_FLAG when button is pressed
+    post_event(EVENT_ERASE_REQUEST);                // Ask the controller to erase the key
 }
 
 /**
  * @brief Callback function for gyroscope data ready interrupt
  */
-void onGyroDataReady() 
+void onGyroDataReady()
 {
+    drdy_timestamp_us = us_ticker_read();           // Timestamp the sample for latency counters
     flags.set(DATA_READY_FLAG);                     // Set the DATA_READY_FLAG when gyroscope data is ready
 }
 
+/**
+ * @brief Callback function for the gyroscope threshold interrupt
+ */
+void onMotion()
+{
+    motion_timestamp_us = us_ticker_read();         // Timestamp the trigger for the wake latency
+    flags.set(MOTION_FLAG);                         // Wake the capture thread
+}
+
+/**
+ * @brief Callback function for the touch controller interrupt
+ */
+void onTouch()
+{
+    touch_timestamp_us = us_ticker_read();          // Timestamp the touch for the start latency
+    flags.set(TOUCH_FLAG);                          // Wake the touch screen thread
+}
+
+/**
+ * @brief Hand the console UART to stdio in place of the platform's own
+ */
+FileHandle *mbed::mbed_override_console(int fd)
+{
+    return &console_serial;
+}
+
+/**
+ * @brief Callback function for a falling edge on the idle console RX line
+ */
+void onConsoleWake()
+{
+    flags.set(CONSOLE_WAKE_FLAG);                   // Wake the console thread
+}
+
+/**
+ * @brief Callback function for characters received by the console
+ */
+void onConsoleInput()
+{
+    flags.set(CONSOLE_INPUT_FLAG);                  // Wake the console thread
+}
+
+/**
+ * @brief Callback function for the first entry in an empty log ring
+ */
+void onLogReady()
+{
+    flags.set(LOG_READY_FLAG);                      // Wake the log thread
+}
+
+/**
+ * @brief Callback function for a finished telemetry DMA transfer
+ */
+void onTelemetrySent(int event)
+{
+    telemetry_flags.set(TELEMETRY_TX_DONE_FLAG);    // Release the buffer that was on the wire
+}
+
+/**
+ * @brief Callback function for the result hold timer
+ */
+void onResultTimeout()
+{
+    post_event(EVENT_RESULT_TIMEOUT);               // Return the controller to idle
+}
+
 /*******************************************************************************
  * @brief Global Variables
  * ****************************************************************************/
-vector<array<float, 3>> gesture_key;                // Vector to store the recorded gesture key
-vector<array<float, 3>> unlocking_record;           // Vector to store the unlocking gesture record
+MBED_ALIGN(8) uint8_t gesture_arena_storage[GESTURE_ARENA_SIZE] GESTURE_ARENA_SECTION; // Backing store of the arena
+BumpArena gesture_arena(gesture_arena_storage, GESTURE_ARENA_SIZE); // Allocator for all gesture buffers
+Gesture_Template gesture_key;                       // Template of the recorded gesture key
+Gesture_Template unlocking_record;                  // Template of the unlocking gesture record
+Gesture_Template temp_key;                          // Template filled by the matcher stage
 
 // Define button positions, sizes, and labels
 const int button1_x = 60;                           // X-coordinate for the first button
@@ -123,20 +513,40 @@ const char *text_0 = "NO KEY RECORDED";             // Message when no key is re
 const char *text_1 = "LOCKED";                      // Message when the system is locked
 const char *button3 = "RESET ";                     // Label for the reset button
 
-int err = 0;                                        // Variable for error checking
-
 /*******************************************************************************
  * @brief Main Function
  * ****************************************************************************/
 int main()
 {
-    lcd.Clear(LCD_COLOR_ORANGE);                     // Clear the LCD with orange background color
+    profiler_init();                                 // Start the cycle counter before any probe runs
+    log_init(&onLogReady);                           // Empty the log ring before any thread logs
+
+    // Carve the gesture traces out of the arena once; nothing is allocated after boot
+    if (!template_init(gesture_key, gesture_arena) || !template_init(unlocking_record, gesture_arena) ||
+        !template_init(temp_key, gesture_arena))
+    {
+        error("Gesture arena exhausted at boot\r\n");  // Halt rather than run with null sample buffers
+    }
+    log_printf("Gesture arena: %u of %u bytes used\r\n", (unsigned)gesture_arena.used(), (unsigned)gesture_arena.size());
 
-    // Draw the first button labeled "RECORD"
-    draw_button(button1_x, button1_y + 50, button1_width, button1_height, button1_label);
+    // Restore the key saved before the last reset, if any
+    if (readGyroDataFromFlash(gesture_key, KEY_FLASH_ADDRESS))
+    {
+        log_printf("Key restored from flash, %u samples\r\n", (unsigned)gesture_key.trace.size);
+    }
 
-    // Optionally draw the second button labeled "UNLOCK" (currently commented out)
-    //draw_button(button2_x, button2_y, button2_width, button2_height, button2_label);
+    lcd.Clear(LCD_COLOR_ORANGE);                     // Clear the LCD with orange background color
+
+    // Draw "RECORD", or "RESET" and "UNLOCK" when a key was restored
+    if (gesture_key.trace.size == 0)
+    {
+        draw_button(button1_x, button1_y + 50, button1_width, button1_height, button1_label);
+    }
+    else
+    {
+        draw_button(button1_x, button1_y, button1_width, button1_height, button3);
+        draw_button(button2_x, button2_y, button2_width, button2_height, button2_label);
+    }
 
     // Display the welcome message at specified coordinates in center mode
     lcd.DisplayStringAt(message_x, message_y, (uint8_t *)message, CENTER_MODE);
@@ -144,9 +554,10 @@ int main()
     // Initialize interrupt handlers for user button and gyroscope data ready
     user_button.rise(&button_press);                 // Attach button_press callback to rising edge of user_button
     gyro_int2.rise(&onGyroDataReady);                // Attach onGyroDataReady callback to rising edge of gyro_int2
+    gyro_int1.rise(&onMotion);                       // Attach onMotion callback to rising edge of gyro_int1
 
     // Initialize LEDs based on whether a gesture key is already recorded
-    if (gesture_key.empty())
+    if (gesture_key.trace.size == 0)
     {
         red_led = 0;                                 // Turn off red LED
         green_led = 1;                               // Turn on green LED
@@ -159,310 +570,1339 @@ int main()
         lcd.DisplayStringAt(text_x, text_y, (uint8_t *)text_1, CENTER_MODE); // Display "LOCKED" message
     }
 
-    // Create and start the gyroscope handling thread
-    Thread key_saving;                                // Define a thread object for gyroscope handling
-    key_saving.start(callback(gyroscope_thread));     // Start the gyroscope_thread
+    // Create the worker threads; sample acquisition runs above everything else
+    // so that matching and LCD updates never delay a gyroscope read
+    Thread capture(osPriorityHigh);                  // Calibration and gesture recording
+    Thread preprocess(osPriorityAboveNormal);        // Sample conversion and trimming
+    Thread controller(osPriorityAboveNormal);        // Gesture state machine
+    Thread touch_thread(osPriorityNormal);           // Touch screen polling
+    Thread matcher(osPriorityBelowNormal);           // Gesture comparison
+    Thread ui(osPriorityLow);                        // LCD drawing
+    Thread console(osPriorityLow);                   // Serial commands
+    Thread telemetry(osPriorityBelowNormal);         // Telemetry framing, the UART itself runs on DMA
+    Thread logger(osPriorityLow);                    // Log formatting and printing
+
+    ui.start(callback(ui_thread));                   // Start the ui_thread
+    capture.start(callback(capture_thread));         // Start the capture_thread
+    preprocess.start(callback(preprocess_thread));   // Start the preprocess_thread
+    matcher.start(callback(matcher_thread));         // Start the matcher_thread
+    controller.start(callback(controller_thread));   // Start the controller_thread
+    touch_thread.start(callback(touch_screen_thread)); // Start the touch_screen_thread
+    console.start(callback(console_thread));         // Start the console_thread
+
+    // Register the threads for the stack gauges, in stack_peak order
+    Thread *threads[THREAD_COUNT] = {&capture, &preprocess, &controller, &touch_thread, &matcher, &ui, &console, &telemetry, &logger};
+    for (int i = 0; i < THREAD_COUNT; i++)
+    {
+        thread_list[i] = threads[i];
+    }
+    telemetry.start(callback(telemetry_thread));     // Start the telemetry_thread
+    logger.start(callback(log_thread));              // Start the log_thread
+
+    // Park the main thread for good; nothing sets its flags, so it never wakes
+    // the system and the idle thread can sleep until the next interrupt
+    ThisThread::flags_wait_any(0x1);
+}
+
+/*******************************************************************************
+ *
+ * @brief Erase the Recorded Gesture Key
+ *
+ * Clears the key, its copy in flash and any pending unlocking record and
+ * resets the LEDs.
+ *
+ ******************************************************************************/
+void erase_key()
+{
+    show_status("Erasing....", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display erasing message
+
+    template_clear(gesture_key);                             // Clear the recorded gesture key
+    template_clear(unlocking_record);                        // Clear the unlocking record
+    if (!eraseGyroDataFromFlash(KEY_FLASH_ADDRESS))
+    {
+        log_printf("Key flash erase failed\r\n");           // The old key comes back after a reset
+    }
+
+    // Reset LEDs and display "All Erasing finish." message
+    green_led = 1;                                           // Turn on green LED
+    red_led = 0;                                             // Turn off red LED
+    show_status("All Erasing finish.", LCD_COLOR_ORANGE, LCD_COLOR_BLACK);
+}
+
+/*******************************************************************************
+ *
+ * @brief Save the Captured Gesture as the Key
+ *
+ * Replaces any previous key with the gesture in temp_key and writes it to
+ * flash, so it survives a reset. The key and capture slots swap their
+ * storage, so the old key's buffer becomes the next capture buffer and no
+ * samples are copied.
+ *
+ ******************************************************************************/
+void save_key()
+{
+    if (gesture_key.trace.size == 0)                             // If no key is currently recorded
+    {
+        show_status("Saving Key...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display saving message
+
+        template_swap(gesture_key, temp_key);                // Hand the capture buffer over to the key
+        template_clear(temp_key);                            // Empty the buffer that becomes the next capture
+
+        // Toggle LEDs to indicate key is saved
+        red_led = 1;                                         // Turn on red LED
+        green_led = 0;                                       // Turn off green LED
+
+        show_status("Key saved...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display saved message
+
+        // Update buttons on the LCD
+        Ui_Message *buttons = ui_mail.try_alloc();           // Take a free UI slot without blocking
+        if (buttons != nullptr)
+        {
+            buttons->type = UI_KEY_BUTTONS;                  // Swap RECORD for RESET and UNLOCK
+            ui_mail.put(buttons);                            // Hand the update to the UI thread
+        }
+    }
+    else
+    {
+        show_status("Removing old key...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display removing message
+
+        template_swap(gesture_key, temp_key);                // Hand the capture buffer over to the key
+        template_clear(temp_key);                            // Drop the old key, its buffer becomes the next capture
+
+        show_status("New key is saved.", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display saved message
+
+        // Toggle LEDs to indicate new key is saved
+        red_led = 1;                                         // Turn on red LED
+        green_led = 0;                                       // Turn off green LED
+    }
+
+    if (!storeGyroDataToFlash(gesture_key, KEY_FLASH_ADDRESS))
+    {
+        log_printf("Key flash write failed\r\n");           // The key only lasts until the next reset
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Change the Controller State
+ * @param state: The controller's current state, updated
+ * @param next: The state to enter
+ * @param gate: The controller's erase gate
+ *
+ * Every state change goes through here, so an erase held while the key was
+ * in use runs on whichever path leaves the busy state.
+ *
+ ******************************************************************************/
+void controller_enter(Controller_State &state, Controller_State next, Erase_Gate &gate)
+{
+    state = next;
+    if (erase_gate_enter(gate, next))
+    {
+        uint32_t erase_copies = trace_bytes_copied;   // Start copy accounting for the erase
+        erase_key();                                  // Serve the erase held while the key was in use
+        report_copies("erase", erase_copies);
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Gesture Controller Thread
+ *
+ * This thread owns the recorded key and runs the state machine
+ * Idle -> Calibrating -> Capturing -> [Matching] -> Result -> Idle.
+ * There is no countdown: the capture opens as soon as the sensor is ready,
+ * the pre-trigger ring covers a gesture that starts early and the segmenter
+ * waits for the onset, with a progress bar showing the time left.
+ * In hands-free mode the gyroscope watches for motion while the controller is
+ * idle with a key, and a motion interrupt moves it straight to Capturing.
+ * It never blocks on anything but its event queue; calibration and capture
+ * run on the capture thread, comparison streams through the pipeline while
+ * the gesture is performed, and all LCD output runs on the UI thread. Erase
+ * requests are served in every state; the erase gate holds them while the
+ * gyroscope is sampling or the matcher is reading the key, because a sector
+ * erase stalls the CPU, and releases them on the next state change.
+ *
+ ******************************************************************************/
+void controller_thread()
+{
+    Controller_State state = STATE_IDLE;              // Current controller state
+    bool recording_key = false;                       // True when the capture will become the key
+    Erase_Gate erase_gate = {false};                  // Holds an erase while the key is in use
+    uint32_t flow_copies = 0;                         // trace_bytes_copied when the current flow started
+
+    motion_wake_update(true);                         // Start out idle
+
+    while (1)
+    {
+        // Wait for the next event and release its queue slot
+        Controller_Event *event = controller_mail.try_get_for(Kernel::wait_for_u32_forever);
+        Controller_EventType type = event->type;       // Event type
+        bool success = event->success;                 // Event outcome
+        controller_mail.free(event);                   // Return the slot to the queue
+
+        switch (type)
+        {
+        case EVENT_RECORD_REQUEST:
+        case EVENT_UNLOCK_REQUEST:
+            if (state != STATE_IDLE && state != STATE_RESULT)
+            {
+                break;                                  // Busy with another gesture, ignore the request
+            }
+            result_timeout.detach();                    // Leave the result state early
+            recording_key = (type == EVENT_RECORD_REQUEST);
+            if (!recording_key)
+            {
+                unlock_attempts.add();                  // Count the attempt, whatever its outcome
+            }
+            flow_copies = trace_bytes_copied;           // Start copy accounting for this flow
+            show_status("Hold still...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Calibration, if due, needs a still board
+            flags.set(CALIBRATE_FLAG);                  // Ask the capture thread to calibrate
+            controller_enter(state, STATE_CALIBRATING, erase_gate);
+            break;
+
+        case EVENT_ERASE_REQUEST:
+            if (!erase_gate_request(erase_gate, state))
+            {
+                break;                                  // Sampling or matching, erase afterwards
+            }
+            {
+                uint32_t erase_copies = trace_bytes_copied; // Start copy accounting for the erase
+                erase_key();                            // Erase the key immediately
+                report_copies("erase", erase_copies);
+            }
+            motion_wake_update(state == STATE_IDLE);    // Nothing to unlock any more
+            break;
+
+        case EVENT_CALIBRATION_DONE:
+            if (state != STATE_CALIBRATING)
+            {
+                break;                                  // Stale event
+            }
+            show_status("Recording... move now", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display recording message
+            show_progress(100);                         // Time left for the onset, drained by the preprocess stage
+            capture_for_unlock = !recording_key;        // Tell the matcher stage what the capture is for
+            flags.set(CAPTURE_FLAG);                    // Ask the capture thread to record
+            controller_enter(state, STATE_CAPTURING, erase_gate);
+            break;
+
+        case EVENT_CAPTURE_DONE:
+            if (state != STATE_CAPTURING)
+            {
+                break;                                  // Stale event
+            }
+            show_status("Finished...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display finished message
+            show_progress(0);                           // Hide the bar if the onset never came
+
+            // Leave Capturing first: a held erase applies to the key of the attempt, not to a key saved now
+            controller_enter(state, !recording_key && gesture_key.trace.size != 0 ? STATE_MATCHING : STATE_RESULT,
+                             erase_gate);
+            if (recording_key && temp_key.trace.size == 0)
+            {
+                show_status("No motion, key not saved.", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Nothing survived trimming
+            }
+            else if (recording_key)
+            {
+                save_key();                             // Store the capture as the new key
+                report_copies("save", flow_copies);     // Account for the save flow
+            }
+            else
+            {
+                template_swap(unlocking_record, temp_key); // Hand the capture buffer over to the unlocking record
+                template_clear(temp_key);               // Empty the buffer that becomes the next capture
+
+                if (state == STATE_MATCHING)
+                {
+                    // The matcher stage compared the capture before handing it over, its verdict follows
+                    show_status("Unlocking...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display unlocking message
+                    break;
+                }
+
+                show_status("NO KEY SAVED.", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display no key message
+                template_clear(unlocking_record);       // Clear the unlocking record
+
+                // Toggle LEDs to indicate no key is saved
+                green_led = 1;                          // Turn on green LED
+                red_led = 0;                            // Turn off red LED
+                report_copies("unlock", flow_copies);   // Account for the unlock flow
+            }
+            result_timeout.attach(&onResultTimeout, RESULT_HOLD_TIME); // Hold the result on screen
+            break;
+
+        case EVENT_MATCH_DONE:
+            if (state != STATE_MATCHING)
+            {
+                break;                                  // Stale event
+            }
+            (success ? unlock_success : unlock_failure).add(); // Count the verdict
+            if (success)
+            {
+                show_status("UNLOCK: SUCCESS", LCD_COLOR_GREEN, LCD_COLOR_BLACK); // Display success message
+                green_led = 1;                          // Turn on green LED
+                red_led = 0;                            // Turn off red LED
+            }
+            else
+            {
+                show_status("UNLOCK: FAILED", LCD_COLOR_RED, LCD_COLOR_BLACK); // Display failure message
+                green_led = 0;                          // Turn off green LED
+                red_led = 1;                            // Turn on red LED
+            }
+            template_clear(unlocking_record);           // Clear the unlocking record
+            report_copies("unlock", flow_copies);       // Account for the unlock flow
+
+            controller_enter(state, STATE_RESULT, erase_gate); // Serves an erase held during matching
+            result_timeout.attach(&onResultTimeout, RESULT_HOLD_TIME); // Hold the result on screen
+            break;
+
+        case EVENT_RESULT_TIMEOUT:
+            if (state != STATE_RESULT)
+            {
+                break;                                  // Stale event
+            }
+            // Restore the idle banner
+            show_status(gesture_key.trace.size == 0 ? text_0 : text_1, LCD_COLOR_ORANGE, LCD_COLOR_BLACK);
+            controller_enter(state, STATE_IDLE, erase_gate);
+            motion_wake_update(true);                   // Watch for the next hands-free unlock
+            break;
+
+        case EVENT_MOTION_CAPTURE:
+            if (state != STATE_IDLE)
+            {
+                break;                                  // A touch request won the race, its calibration disarmed the watch
+            }
+            recording_key = false;                      // Hands-free captures are always unlock attempts
+            unlock_attempts.add();
+            flow_copies = trace_bytes_copied;           // Start copy accounting for this flow
+            show_status("Recording...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK); // Display recording message
+            controller_enter(state, STATE_CAPTURING, erase_gate);
+            break;
+
+        case EVENT_MOTION_MODE:
+            motion_wake_update(state == STATE_IDLE);    // Applies now if idle, otherwise on return to idle
+            break;
+        }
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Gyroscope Capture Thread
+ *
+ * This thread owns the gyroscope and its power mode. On CALIBRATE_FLAG it
+ * brings the sensor up: the registers are written once after boot, later
+ * requests only wake it from sleep or power-down, and the zero-rate levels
+ * are measured again only once they are older than CALIBRATION_LIFETIME.
+ * After every capture the sensor goes to sleep, and after
+ * GYRO_POWER_DOWN_DELAY without a request it powers down. On
+ * CAPTURE_FLAG it streams samples into raw_queue framed by PIPELINE_START and
+ * PIPELINE_END messages until the preprocess stage sets CAPTURE_STOP_FLAG
+ * (or CAPTURE_TIMEOUT passes). Every DRDY sample is read and
+ * run through CaptureFilter so the sensor never stalls. That full-rate stream
+ * drives the orientation tracker, integrated with the measured DRDY spacing,
+ * and CaptureDecimator turns it into the SEGMENT_RATE_HZ stream that is
+ * forwarded, each sample carrying the orientation at its time.
+ *
+ * Between CALIBRATE_FLAG and CAPTURE_FLAG the chain already runs, filling the
+ * pre-trigger ring. The capture opens with the last PRETRIGGER_MS of it,
+ * forwarded in place, so motion that starts before the request is kept.
+ * Live samples pass through the same ring, which buffers them whenever
+ * raw_queue is full.
+ *
+ * MOTION_ARM_FLAG prepares the sensor like a calibration request and hands
+ * motion detection to its INT1 threshold generator, with DRDY off so the CPU
+ * can sleep. A threshold event starts an unlock capture without waiting for
+ * the controller: the FIFO samples from before the event are processed first,
+ * then the capture continues on DRDY as usual.
+ *
+ ******************************************************************************/
+void capture_thread()
+{
+    // Register values come from CaptureGyro; only the interrupt routing is chosen here
+    Gyroscope_Init_Parameters init_parameters = CaptureGyro::parameters(INT2_DRDY); // Data ready on INT2
+
+    // Define a structure to hold raw gyroscope data
+    Gyroscope_RawData raw_data;                       // Structure to store raw gyroscope data
+
+    Pipeline_RawSample message;                       // Message pushed to the preprocess stage
+    Quaternion orientation;                           // Integrated orientation since the chain was restarted
+    uint32_t last_us = 0;                             // Time of the previous integrated sample
+    bool configured = false;                          // True once the control registers were written
+    bool calibrated = false;                          // True once the zero-rate levels were measured
+    Kernel::Clock::time_point calibrated_at;          // Time of the last calibration
+    bool watching = false;                            // True while the threshold interrupt is armed
+
+    while (1)
+    {
+        // Wait for a calibration or capture command from the controller; a sleeping
+        // sensor powers down if none comes, an idle one waits without a timer
+        Kernel::Clock::duration_u32 idle_timeout = GetGyroscopePower() == GYRO_SLEEP
+                                                       ? Kernel::Clock::duration_u32(GYRO_POWER_DOWN_DELAY)
+                                                       : Kernel::wait_for_u32_forever;
+        uint32_t command = flags.wait_any_for(CALIBRATE_FLAG | CAPTURE_FLAG | MOTION_FLAG | MOTION_ARM_FLAG | MOTION_DISARM_FLAG,
+                                              idle_timeout);
+        if (command & osFlagsError)
+        {
+            SetGyroscopePower(GYRO_POWER_DOWN);       // Idle for long, drop to a few microamps
+            log_printf("Gyroscope powered down\r\n");
+            continue;
+        }
+
+        // Requests from the controller supersede the watch and a pending motion event
+        bool requested = command & (CALIBRATE_FLAG | CAPTURE_FLAG | MOTION_DISARM_FLAG);
+        bool motion_start = watching && (command & MOTION_FLAG) && !requested; // Hands-free unlock begins
+        bool arm = !watching && (command & MOTION_ARM_FLAG) && !requested;      // Start watching
+        if (watching && requested)
+        {
+            DisableMotionInterrupt();                 // Back to DRDY
+            watching = false;
+            if (!(command & (CALIBRATE_FLAG | CAPTURE_FLAG)))
+            {
+                SetGyroscopePower(GYRO_SLEEP);        // Disarmed while idle
+            }
+        }
+
+        if (command & CALIBRATE_FLAG || arm)
+        {
+            PROFILE_SCOPE(PROBE_CALIBRATION);
+            if (!configured)
+            {
+                ConfigureGyroscope(&init_parameters, &raw_data); // First use, write the registers
+                configured = true;
+            }
+            gyro_wake(raw_data);                      // Power up and wait until the output settled
+
+            if (!calibrated || Kernel::Clock::now() - calibrated_at > CALIBRATION_LIFETIME)
+            {
+                CalibrateGyroscope(&raw_data, &calibration_wait); // Zero-rate levels drift with temperature, refresh them
+                calibrated = true;
+                calibrated_at = Kernel::Clock::now();
+            }
+        }
+
+        if (command & CALIBRATE_FLAG)
+        {
+            post_event(EVENT_CALIBRATION_DONE);       // Report calibration to the controller
+
+            // Run the chain into the pre-trigger ring until the controller asks for the capture
+            capture_restart(orientation);
+            last_us = us_ticker_read();
+            timer.start();                                            // Start the timer
+            while (!(flags.get() & (CALIBRATE_FLAG | CAPTURE_FLAG | MOTION_ARM_FLAG | MOTION_DISARM_FLAG)) &&
+                   timer.elapsed_time() < CAPTURE_TIMEOUT)            // Safety limit only
+            {
+                uint32_t sample_us = capture_wait();                  // Time the sample was taken
+                PROFILE_SCOPE(PROBE_CAPTURE);                         // Time everything up to the next wait
+                if (capture_step(raw_data, sample_us, last_us, orientation, message))
+                {
+                    pretrigger.push(message);                         // Oldest history falls out
+                }
+            }
+            timer.stop();                                             // Stop the timer
+            timer.reset();                                            // Reset the timer
+            if (!(flags.get() & CAPTURE_FLAG))
+            {
+                pretrigger.clear();                                   // Too old for whatever comes next
+            }
+        }
+
+        if (arm)
+        {
+            flags.clear(MOTION_FLAG);                 // Forget events from an earlier watch
+            EnableMotionInterrupt(CaptureGyro::to_raw(MOTION_WAKE_DPS), MOTION_WAKE_DURATION, CaptureGyro::ctrl_reg2);
+            watching = true;
+        }
+
+        if (command & CAPTURE_FLAG || motion_start)
+        {
+            if (motion_start)
+            {
+                capture_for_unlock = true;            // Hands-free captures are unlock attempts
+                post_event(EVENT_MOTION_CAPTURE);     // Tell the controller the capture already runs
+                motion_wakes.add();
+            }
+            gyro_wake(raw_data);                      // Normally still active from the calibration request
+            memset(&capture_stats, 0, sizeof(capture_stats)); // Reset the stage counters
+
+            // Continue the pre-roll chain if there is one, otherwise start from the current pose
+            if (motion_start || pretrigger.size() == 0)
+            {
+                capture_restart(orientation);
+                last_us = us_ticker_read();
+            }
+            uint32_t live = pretrigger.end();                         // Sequence number of the first live sample
+            uint32_t cursor = live - min(pretrigger.size(), (uint32_t)PRETRIGGER_SAMPLES); // Next ring entry to forward
+            pretrigger_samples.record(live - cursor);
+
+            // Open the gesture; framing messages are never dropped
+            message.kind = PIPELINE_START;
+            message.timestamp_us = us_ticker_read();
+            while (!raw_queue.push(message))
+            {
+                ThisThread::yield();                  // Let the preprocess stage make room
+            }
+            pipeline_flags.set(RAW_READY_FLAG);       // Wake the preprocess stage
+            capture_forward(cursor, live);            // The pre-roll goes first, straight from the ring
+
+            // Measure the touch-to-capture latency of touch requests
+            uint32_t touched_us = request_timestamp_us;
+            if (touched_us != 0 && !motion_start)
+            {
+                request_timestamp_us = 0;
+                uint32_t start_latency = us_ticker_read() - touched_us;
+                touch_capture_latency.record(start_latency);
+                if (start_latency > TOUCH_CAPTURE_TARGET_US)
+                {
+                    slow_capture_starts.add();
+                    log_printf("Capture started %lu us after the touch\r\n", start_latency);
+                }
+            }
+
+            // Record until the segmenter sees the gesture end
+            flags.clear(CAPTURE_STOP_FLAG);                           // Drop a stop request from the last gesture
+            bool draining = motion_start;                             // FIFO still holds samples from before the trigger
+            if (motion_start)
+            {
+                uint32_t backlog = GetGyroFifoLevel();                // Pre-trigger samples in the FIFO
+                motion_wake_latency.record(last_us - motion_timestamp_us);
+                motion_pretrigger.record(backlog);
+                last_us -= backlog * CAPTURE_SAMPLE_US;               // The FIFO reaches back this far
+            }
+            timer.start();                                            // Start the timer
+            while (timer.elapsed_time() < CAPTURE_TIMEOUT)            // Safety limit only
+            {
+                if (flags.get() & CAPTURE_STOP_FLAG)
+                {
+                    flags.clear(CAPTURE_STOP_FLAG);                   // Gesture over or never started
+                    break;
+                }
+
+                if (draining && GetGyroFifoLevel() == 0)
+                {
+                    // Pre-trigger history consumed, continue from the output registers on DRDY
+                    DisableMotionInterrupt();
+                    watching = false;
+                    draining = false;
+                    flags.clear(DATA_READY_FLAG);                     // Edges from the watch are stale
+                }
+
+                // FIFO samples are evenly spaced, live ones are timed by their DRDY edge
+                uint32_t sample_us = draining ? last_us + CAPTURE_SAMPLE_US : capture_wait();
+                PROFILE_SCOPE(PROBE_CAPTURE);                         // Time everything up to the next wait
+                if (capture_step(raw_data, sample_us, last_us, orientation, message))
+                {
+                    pretrigger.push(message);                         // The ring absorbs a slow preprocess stage
+                    capture_forward(cursor, live);
+                }
+            }
+            timer.stop();                                             // Stop the timer
+            timer.reset();                                            // Reset the timer
+            pretrigger.clear();                                       // Unforwarded samples came after the gesture
+            if (watching)
+            {
+                DisableMotionInterrupt();                             // Stopped before the FIFO was drained
+                watching = false;
+            }
+
+            // Close the gesture
+            message.kind = PIPELINE_END;
+            message.timestamp_us = us_ticker_read();
+            while (!raw_queue.push(message))
+            {
+                ThisThread::yield();                  // Let the preprocess stage make room
+            }
+            pipeline_flags.set(RAW_READY_FLAG);       // Wake the preprocess stage
+
+            SetGyroscopePower(GYRO_SLEEP);            // Nothing to measure until the next request
+        }
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Wait for a Calibration Sample
+ * @param sample: Index of the sample about to be taken
+ *
+ * Sleeps until DRDY and advances the progress bar every 16 samples.
+ * Runs on the capture thread inside CalibrateGyroscope.
+ *
+ ******************************************************************************/
+void calibration_wait(int sample)
+{
+    if (sample % 16 == 0)
+    {
+        show_progress((sample + 16) * 100 / CALIBRATION_SAMPLES); // Never zero, that hides the bar
+    }
+    capture_wait();
+}
+
+/*******************************************************************************
+ *
+ * @brief Restart the Capture Chain
+ * @param orientation: Orientation to reset
+ *
+ * Clears the filter and decimator state, the orientation and the pre-trigger
+ * ring, so the chain starts over from the current pose.
+ *
+ ******************************************************************************/
+void capture_restart(Quaternion &orientation)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        capture_filter[axis].reset();                 // Forget the previous gesture
+        capture_decimator[axis].reset();
+    }
+    orientation_reset(orientation);                   // Integrate from the current pose
+    pretrigger.clear();
+}
+
+/*******************************************************************************
+ *
+ * @brief Wait for the Next Sample
+ *
+ * Waits for DRDY; on timeout the caller reads anyway so a missed edge cannot
+ * stall the sensor.
+ *
+ * @return Time the sample was taken
+ *
+ ******************************************************************************/
+uint32_t capture_wait()
+{
+    if (flags.wait_all_for(DATA_READY_FLAG, DRDY_TIMEOUT) & osFlagsError)
+    {
+        drdy_missed.add();                            // Timed out, the edge was missed
+        return us_ticker_read();
+    }
+    return drdy_timestamp_us;
+}
+
+/*******************************************************************************
+ *
+ * @brief Run One Sample Through the Capture Chain
+ * @param raw_data: Sample buffer the gyroscope driver reads into
+ * @param sample_us: Time the sample was taken
+ * @param last_us: Time of the previous sample, advanced to sample_us
+ * @param orientation: Orientation, integrated over the sample
+ * @param message: Receives the segment-rate sample
+ *
+ * Reads the sample (from the FIFO while it is enabled), filters it, updates
+ * the orientation and decimates it to the segment rate.
+ *
+ * @return True when message holds a new segment-rate sample
+ *
+ ******************************************************************************/
+bool capture_step(Gyroscope_RawData &raw_data, uint32_t sample_us, uint32_t &last_us, Quaternion &orientation,
+                  Pipeline_RawSample &message)
+{
+    // Rate in rad/s per raw digit, folded into one constant
+    const float rad_per_digit = CaptureGyro::sensitivity * ORIENTATION_DEG_TO_RAD;
+
+    GetOffsetCorrectedRawData();                      // Retrieve zero-rate corrected gyroscope data
+    telemetry_push_sample(telemetry_raw_queue, sample_us, raw_data); // Stream the unfiltered sample
+
+    bool ready;                                       // True when the decimators produced a sample
+    {
+        PROFILE_SCOPE(PROBE_FILTER);
+
+        // Filter instead of zeroing small values, so low-amplitude motion survives
+        raw_data.x_raw = capture_filter[0].process(raw_data.x_raw);
+        raw_data.y_raw = capture_filter[1].process(raw_data.y_raw);
+        raw_data.z_raw = capture_filter[2].process(raw_data.z_raw);
+
+        // Anti-alias and decimate; the three axes run in lock step
+        ready = capture_decimator[0].process(raw_data.x_raw, message.raw.x_raw);
+        capture_decimator[1].process(raw_data.y_raw, message.raw.y_raw);
+        capture_decimator[2].process(raw_data.z_raw, message.raw.z_raw);
+    }
+
+    // Integrate over the true sample spacing
+    float dt = (sample_us - last_us) * 1e-6f;
+    last_us = sample_us;
+    orientation_update(orientation,
+                       raw_data.x_raw * rad_per_digit,
+                       raw_data.y_raw * rad_per_digit,
+                       raw_data.z_raw * rad_per_digit,
+                       dt);
+
+    if (!ready)
+    {
+        return false;                                 // Read only to keep DRDY toggling
+    }
+    message.kind = PIPELINE_SAMPLE;
+    message.timestamp_us = sample_us;                 // Latency is measured from the DRDY edge
+    message.orientation = orientation;                // and the pose it left the board in
+    return true;
+}
+
+/*******************************************************************************
+ *
+ * @brief Forward Ring Entries to the Preprocess Stage
+ * @param cursor: Sequence number of the next entry to forward, advanced
+ * @param live: Sequence number of the first sample taken after the start
+ *
+ * Pushes the pre-trigger ring entries from cursor on into raw_queue until the
+ * queue is full; the rest wait in the ring for the next call. Entries the
+ * ring overwrote before they were forwarded count as dropped. Only samples
+ * from live on enter the latency counters, the pre-roll is old by design.
+ *
+ ******************************************************************************/
+void capture_forward(uint32_t &cursor, uint32_t live)
+{
+    if ((int32_t)(pretrigger.begin() - cursor) > 0)
+    {
+        capture_stats.dropped += pretrigger.begin() - cursor; // Preprocess stage fell too far behind
+        cursor = pretrigger.begin();
+    }
+
+    RingView<Pipeline_RawSample> pending = pretrigger.since(cursor); // Entries not forwarded yet, in place
+    uint32_t sent = 0;
+    while (sent < pending.size() && raw_queue.push(pending[sent]))
+    {
+        if ((int32_t)(cursor + sent - live) >= 0)
+        {
+            stage_record(capture_stats, pending[sent].timestamp_us); // Count the forwarded sample
+        }
+        sent++;
+    }
+    cursor += sent;
+    if (sent > 0)
+    {
+        pipeline_flags.set(RAW_READY_FLAG);           // Wake the preprocess stage
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Wake the Gyroscope
+ * @param raw_data: Scratch sample buffer of the capture thread
+ *
+ * Switches the sensor to active mode, records the time to its first DRDY
+ * edge in latency.gyro_wake and drops GYRO_WAKE_DISCARD samples while the
+ * output settles. Does nothing if the sensor is already active. Runs on the
+ * capture thread.
+ *
+ ******************************************************************************/
+void gyro_wake(Gyroscope_RawData &raw_data)
+{
+    if (GetGyroscopePower() == GYRO_ACTIVE)
+    {
+        return;
+    }
+
+    uint32_t wake_us = us_ticker_read();              // Time of the wake-up
+    SetGyroscopePower(GYRO_ACTIVE);
+    GetGyroValue(&raw_data);                          // Read once so DRDY falls and the next sample raises an edge
+    flags.clear(DATA_READY_FLAG);                     // Forget edges from before the wake-up
+    if (!(flags.wait_all_for(DATA_READY_FLAG, GYRO_WAKE_TIMEOUT) & osFlagsError))
+    {
+        gyro_wake_latency.record(drdy_timestamp_us - wake_us);
+    }
+
+    for (int i = 0; i < GYRO_WAKE_DISCARD; i++)
+    {
+        GetGyroValue(&raw_data);                      // Read and drop while the output settles
+        flags.wait_all_for(DATA_READY_FLAG, DRDY_TIMEOUT);
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Arm or Disarm Wake-on-Motion
+ * @param idle: True if the controller is idle
+ *
+ * The gyroscope watches for motion only while the controller is idle,
+ * hands-free unlock is on and there is a key to compare against. Runs on the
+ * controller thread; the capture thread applies the request.
+ *
+ ******************************************************************************/
+void motion_wake_update(bool idle)
+{
+    if (idle && motion_wake_enabled && gesture_key.trace.size != 0)
+    {
+        flags.clear(MOTION_DISARM_FLAG);              // Only the latest request counts
+        flags.set(MOTION_ARM_FLAG);
+    }
+    else
+    {
+        flags.clear(MOTION_ARM_FLAG);
+        flags.set(MOTION_DISARM_FLAG);
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Preprocess Thread
+ *
+ * This thread runs the energy segmenter on the SEGMENT_RATE_HZ stream, so
+ * gesture boundaries are found to within 1 / SEGMENT_RATE_HZ. In parallel
+ * MatchDecimator reduces the same stream to the GESTURE_RATE_HZ samples the
+ * matcher works on. Nothing is forwarded until motion onset; the matcher
+ * samples that led up to it are then flushed from a short history so the
+ * gesture start is not lost. Once the segmenter confirms stillness (or no
+ * motion starts within SEGMENT_START_TIMEOUT) the capture thread is told to
+ * stop, so the user never waits out a fixed recording window. Each forwarded
+ * sample carries the segmenter's moving flag, delayed by MATCH_DELAY to line
+ * up with the filtered sample, which the matcher stage uses to cut the still
+ * tail.
+ *
+ ******************************************************************************/
+void preprocess_thread()
+{
+    Pipeline_RawSample input;                         // Message from the capture stage
+    Pipeline_Sample output;                           // Message to the matcher stage
+    SampleRing<Pipeline_Sample, sample_ring_size(SEGMENT_PREROLL)> history; // Latest matcher samples before the onset
+    uint32_t idle_count = 0;                          // Segmenter samples seen before the onset
+    uint32_t moving_bits = 0;                         // Moving flags of the last 32 segmenter samples, newest in bit 0
+    bool in_segment = false;                          // True between onset and stillness
+    bool finished = false;                            // True once the segment closed
+    Gyroscope_RawData decimated;                      // Matcher-rate sample in raw digits
+
+    Segmenter segmenter;                              // Energy segmenter, keeps its noise floor across gestures
+    segmenter_init(segmenter, segmenter_default_config());
+
+    while (1)
+    {
+        pipeline_flags.wait_any(RAW_READY_FLAG);      // Wait for the capture stage
+
+        uint32_t occupancy = raw_queue.size();        // Queue depth before draining
+        preprocess_stats.max_occupancy = max(preprocess_stats.max_occupancy, occupancy);
+
+        while (raw_queue.pop(input))
+        {
+            output.kind = input.kind;
+            output.timestamp_us = input.timestamp_us;
+
+            if (input.kind == PIPELINE_SAMPLE)
+            {
+                if (finished)
+                {
+                    continue;                         // Segment closed, capture is stopping
+                }
+
+                telemetry_push_sample(telemetry_filtered_queue, input.timestamp_us, input.raw); // Stream the decimated sample
+
+                // Segment at the full segment rate
+                Gesture_Sample dps = {CaptureGyro::to_dps(input.raw.x_raw), CaptureGyro::to_dps(input.raw.y_raw), CaptureGyro::to_dps(input.raw.z_raw)};
+                Segment_Event boundary;
+                {
+                    PROFILE_SCOPE(PROBE_SEGMENT);
+                    boundary = segmenter_update(segmenter, dps);
+                }
+                moving_bits = (moving_bits << 1) | (segmenter_moving(segmenter) ? 1 : 0);
+                bool onset = !in_segment && boundary == SEGMENT_START;
+                bool close = in_segment && boundary == SEGMENT_END;
+
+                if (!in_segment && !onset && ++idle_count >= SEGMENT_START_TIMEOUT)
+                {
+                    finished = true;                  // Nobody moved, give up
+                    flags.set(CAPTURE_STOP_FLAG);
+                    show_progress(0);
+                    continue;
+                }
+                if (!in_segment && !onset && idle_count % (SEGMENT_RATE_HZ / 4) == 0)
+                {
+                    show_progress(100 - idle_count * 100 / SEGMENT_START_TIMEOUT); // Time left for the onset
+                }
+
+                if (onset)
+                {
+                    // Forward the matcher samples that led up to the onset, oldest first
+                    in_segment = true;
+                    show_status("Gesture detected...", LCD_COLOR_ORANGE, LCD_COLOR_BLACK);
+                    show_progress(0);                 // The onset came, no more waiting
+                    RingView<Pipeline_Sample> preroll = history.latest(SEGMENT_PREROLL); // In place, no staging copy
+                    for (uint32_t i = 0; i < preroll.size(); i++)
+                    {
+                        if (!trace_queue.push(preroll[i]))
+                        {
+                            preprocess_stats.dropped++; // Matcher stage fell behind
+                        }
+                    }
+                    pipeline_flags.set(TRACE_READY_FLAG); // Wake the matcher stage
+                }
+
+                if (close)
+                {
+                    in_segment = false;
+                    finished = true;                  // Stillness confirmed, stop recording
+                    flags.set(CAPTURE_STOP_FLAG);
+                }
+
+                // Decimate to the gesture rate; the three axes run in lock step
+                bool ready = match_decimator[0].process(input.raw.x_raw, decimated.x_raw);
+                match_decimator[1].process(input.raw.y_raw, decimated.y_raw);
+                match_decimator[2].process(input.raw.z_raw, decimated.z_raw);
+                if (!ready)
+                {
+                    continue;
+                }
+
+                output.dps = {CaptureGyro::to_dps(decimated.x_raw), CaptureGyro::to_dps(decimated.y_raw), CaptureGyro::to_dps(decimated.z_raw)};
+                output.orientation = input.orientation;
+                output.moving = (moving_bits >> MATCH_DELAY) & 1; // Flag of the segmenter sample this output is centred on
+
+                if (!in_segment && !close)
+                {
+                    history.push(output);             // Remember for the pre-roll
+                    continue;
+                }
+
+                if (trace_queue.push(output))
+                {
+                    stage_record(preprocess_stats, input.timestamp_us); // Count the forwarded sample
+                }
+                else
+                {
+                    preprocess_stats.dropped++;       // Matcher stage fell behind
+                }
+            }
+            else
+            {
+                if (input.kind == PIPELINE_START)
+                {
+                    memset(&preprocess_stats, 0, sizeof(preprocess_stats)); // Reset the stage counters
+                    preprocess_stats.max_occupancy = occupancy;
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        match_decimator[axis].reset(); // Forget the previous gesture
+                    }
+                }
+                segmenter_reset(segmenter);           // Wait for the next onset
+                history.clear();
+                idle_count = 0;
+                moving_bits = 0;
+                in_segment = false;
+                finished = false;
+
+                // Framing messages are never dropped
+                while (!trace_queue.push(output))
+                {
+                    ThisThread::yield();              // Let the matcher stage make room
+                }
+            }
+            pipeline_flags.set(TRACE_READY_FLAG);     // Wake the matcher stage
+        }
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Gesture Matcher Thread
+ *
+ * This thread collects the gesture into temp_key, together with its rotation
+ * path relative to the first sample. The length at the last moving sample is
+ * remembered, so trailing stillness is cut off at PIPELINE_END. The trace is
+ * then resampled to RESAMPLE_LENGTH and summarized into an embedding and,
+ * for unlock attempts, scored against gesture_key by the matcher ensemble.
+ * The matchers run cheapest first and the dearer DTW ones are skipped once
+ * the verdict is settled. Each matcher's latency and how often it decided
+ * the verdict go to the metrics. It runs below the capture thread so that
+ * matching never delays sample acquisition.
+ *
+ ******************************************************************************/
+void matcher_thread()
+{
+    Pipeline_Sample input;                            // Message from the preprocess stage
+    size_t active_size = 0;                           // Trace length at the last moving sample
+    mbed_stats_heap_t heap_stats;                     // Heap statistics, needs platform.heap-stats-enabled
+    uint32_t heap_allocations = 0;                    // Heap allocation count when the gesture started
+    bool unlocking = false;                           // True when the gesture is compared to the key
+    Ensemble_Result result;                           // Scores of the last comparison
+    Quaternion origin;                                // Orientation at the first sample of the gesture
+
+    while (1)
+    {
+        pipeline_flags.wait_any(TRACE_READY_FLAG);    // Wait for the preprocess stage
+
+        uint32_t occupancy = trace_queue.size();      // Queue depth before draining
+        matcher_stats.max_occupancy = max(matcher_stats.max_occupancy, occupancy);
+
+        while (trace_queue.pop(input))
+        {
+            if (input.kind == PIPELINE_START)
+            {
+                memset(&matcher_stats, 0, sizeof(matcher_stats)); // Reset the stage counters
+                matcher_stats.max_occupancy = occupancy;
+                active_size = 0;
+                mbed_stats_heap_get(&heap_stats);     // Snapshot the heap allocation counter
+                heap_allocations = heap_stats.alloc_cnt;
+                template_clear(temp_key);             // Drop any stale capture
+                unlocking = capture_for_unlock && gesture_key.trace.size != 0; // Latch the capture purpose
+                continue;
+            }
+
+            if (input.kind == PIPELINE_SAMPLE)
+            {
+                if (temp_key.trace.size == 0)
+                {
+                    origin = input.orientation;       // Paths start at zero rotation
+                }
+                Gesture_Sample rotation;              // Rotation since the first sample
+                orientation_relative(origin, input.orientation, rotation);
+                if (!trace_push(temp_key.trace, input.dps) || !trace_push(temp_key.path, rotation)) // Keep the gesture
+                {
+                    matcher_stats.dropped++;          // Longer than GESTURE_MAX_SAMPLES
+                    continue;
+                }
+                if (input.moving)
+                {
+                    active_size = temp_key.trace.size; // Everything up to here belongs to the gesture
+                }
+                sample_latency.record(stage_record(matcher_stats, input.timestamp_us)); // Count the consumed sample
+                continue;
+            }
+
+            // PIPELINE_END: trim trailing stillness, normalize the length, report the capture
+            temp_key.trace.size = active_size;
+            temp_key.path.size = active_size;
+            {
+                PROFILE_SCOPE(PROBE_FINALIZE);
+                template_finalize(temp_key);          // Cache the fixed-length copy and embedding used for matching
+            }
+            uint32_t end_us = input.timestamp_us;     // Time the recording window closed
+
+            if (unlocking)
+            {
+                // Compare before handing temp_key over, the controller swaps it out on CAPTURE_DONE
+                bool unlock = ensemble_match(ensemble_default_model, gesture_key, temp_key, gesture_arena, result);
+                telemetry_send_gesture(temp_key, end_us); // Also before the hand-over
+                post_event(EVENT_CAPTURE_DONE);       // Hand temp_key to the controller
+                post_event(EVENT_MATCH_DONE, unlock); // Report the verdict
+
+                if (telemetry_enabled)
+                {
+                    Telemetry_Record record;          // Scores for the host
+                    telemetry_ensemble_record(record, end_us, result);
+                    telemetry_post(record, 0ms);      // Never wait, the verdict is already out
+                }
+
+                // Log the score, term and cost of every matcher that ran
+                for (int m = 0; m < MATCHER_COUNT; m++)
+                {
+                    if (!(result.run & (1u << m)))
+                    {
+                        log_printf("Matcher %s skipped\r\n", matcher_name((Matcher_Id)m));
+                        continue;
+                    }
+                    uint32_t matcher_us = result.cycles[m] / (SystemCoreClock / 1000000); // Cycles to microseconds
+                    matcher_latency[m].record(matcher_us);
+                    if (ensemble_pivotal(ensemble_default_model, result, (Matcher_Id)m))
+                    {
+                        matcher_pivotal[m].add();     // This matcher decided the verdict
+                    }
+                    log_printf("Matcher %s: score %f, term %+.2f, %lu us\r\n", matcher_name((Matcher_Id)m),
+                               result.score[m], result.contribution[m], (unsigned long)matcher_us);
+                }
+                log_printf("Match probability: %f (decision %f)\r\n", result.probability, ensemble_default_model.decision);
+                uint32_t verdict_us = us_ticker_read() - end_us; // End of gesture to verdict
+                verdict_latency.record(verdict_us);
+                log_printf("Verdict latency: %lu us\r\n", (unsigned long)verdict_us);
+            }
+            else
+            {
+                telemetry_send_gesture(temp_key, end_us); // Stream the capture before handing it over
+                post_event(EVENT_CAPTURE_DONE);       // Hand temp_key to the controller
+            }
+
+            print_stage_stats("capture", capture_stats);
+            print_stage_stats("preprocess", preprocess_stats);
+            print_stage_stats("matcher", matcher_stats);
+            pipeline_dropped.add(capture_stats.dropped + preprocess_stats.dropped + matcher_stats.dropped);
+
+            // The steady-state gesture cycle must not touch the heap
+            mbed_stats_heap_get(&heap_stats);
+            log_printf("Heap allocations during gesture: %lu\r\n", (unsigned long)(heap_stats.alloc_cnt - heap_allocations));
+        }
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief UI Thread
+ *
+ * This thread is the only writer to the LCD after start-up. It drains the UI
+ * queue at low priority so that drawing never competes with capture.
+ *
+ ******************************************************************************/
+void ui_thread()
+{
+    bool diagnostics = false;                                         // True while the metrics cover the buttons
+
+    while (1)
+    {
+        Ui_Message *ui_message = ui_mail.try_get_for(Kernel::wait_for_u32_forever); // Wait for the next update
+        PROFILE_SCOPE(PROBE_LCD);                                     // Time the drawing of this update
+        uint32_t start_us = us_ticker_read();                         // Start of the drawing
+
+        switch (ui_message->type)
+        {
+        case UI_STATUS:
+            lcd.SetTextColor(ui_message->fill_color);                 // Set the status line background color
+            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
+            lcd.SetTextColor(ui_message->text_color);                 // Set the status line text color
+            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)ui_message->text, CENTER_MODE); // Display message
+            break;
+
+        case UI_PROGRESS:
+        {
+            uint32_t width = lcd.GetXSize() * ui_message->percent / 100; // Filled part of the bar
+            lcd.SetTextColor(LCD_COLOR_ORANGE);                       // Clear the bar to the background
+            lcd.FillRect(0, text_y + FONT_SIZE, lcd.GetXSize(), PROGRESS_HEIGHT);
+            if (width > 0)
+            {
+                lcd.SetTextColor(LCD_COLOR_DARKBLUE);
+                lcd.FillRect(0, text_y + FONT_SIZE, width, PROGRESS_HEIGHT);
+            }
+            break;
+        }
 
-    // Create and start the touch screen handling thread
-    Thread touch_thread;                              // Define a thread object for touch screen handling
-    touch_thread.start(callback(touch_screen_thread)); // Start the touch_screen_thread
+        case UI_KEY_BUTTONS:
+            if (diagnostics)
+            {
+                break;                                                // The home screen is redrawn when diagnostics close
+            }
+            draw_button(button1_x, button1_y, button1_width, button1_height, button3); // Draw "RESET" button
+            remove_button(button1_x, button1_y + 50, button1_width, button1_height); // Remove the "RECORD" button
+            draw_button(button2_x, button2_y, button2_width, button2_height, button2_label); // Draw "UNLOCK" button
+            break;
+
+        case UI_DIAGNOSTICS:
+            diagnostics = !diagnostics;
+            if (diagnostics)
+            {
+                draw_diagnostics();                                   // Snapshot of every metric
+            }
+            else
+            {
+                draw_home_screen();                                   // Back to the buttons
+            }
+            break;
+        }
 
-    // Keep the main thread alive indefinitely
-    while (1)
-    {
-        ThisThread::sleep_for(100ms);                 // Sleep for 100 milliseconds
+        ui_mail.free(ui_message);                                     // Return the slot to the queue
+        lcd_redraws.add();
+        lcd_latency.record(us_ticker_read() - start_us);
     }
 }
 
 /*******************************************************************************
  *
- * @brief Gyroscope Gesture Key Saving Thread
+ * @brief Run one console command
  *
- * This thread handles recording gestures, saving gesture keys, and unlocking by comparing recorded gestures.
+ * @param command Character received on the console
  *
  ******************************************************************************/
-void gyroscope_thread()
+void console_command(int command)
 {
-    // Define and initialize gyroscope parameters
-    Gyroscope_Init_Parameters init_parameters;        // Structure to hold gyroscope initialization parameters
-    init_parameters.conf1 = ODR_200_CUTOFF_50;       // Set Output Data Rate to 200Hz and cutoff to 50Hz
-    init_parameters.conf3 = INT2_DRDY;               // Configure interrupt 2 for data ready
-    init_parameters.conf4 = FULL_SCALE_500;          // Set full scale to ±500 degrees per second
-
-    // Define a structure to hold raw gyroscope data
-    Gyroscope_RawData raw_data;                       // Structure to store raw gyroscope data
-
-    // Define a buffer to hold status messages for display on the LCD
-    char display_buffer[50];                          // Buffer to store display messages
-
-    // Check if gyroscope data ready flag is not set and the interrupt pin is high
-    if (!(flags.get() & DATA_READY_FLAG) && (gyro_int2.read() == 1))
-    {
-        flags.set(DATA_READY_FLAG);                   // Manually set DATA_READY_FLAG if data is already ready
-    }
-
-    // Infinite loop to handle events
-    while (1)
+    switch (command)
     {
-        vector<array<float, 3>> temp_key;             // Temporary vector to store recorded gyroscope data
-
-        // Wait for any of the KEY_FLAG, UNLOCK_FLAG, or ERASE_FLAG to be set
-        auto flag_check = flags.wait_any(KEY_FLAG | UNLOCK_FLAG | ERASE_FLAG);
-
-        // Handle ERASE_FLAG event
-        if (flag_check & ERASE_FLAG)
+    case 'p':
+        profiler_dump();                                           // Print the histograms
+        break;
+
+    case 'r':
+        profiler_reset();                                          // Start a new measurement
+        log_printf("Profiler cleared\r\n");
+        break;
+
+    case 't':
+        telemetry_enabled = !telemetry_enabled;                    // Toggle the stream
+        if (telemetry_enabled)
         {
-            // Display "Erasing..." message on the LCD
-            sprintf(display_buffer, "Erasing....");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange (background color)
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display message
-
-            gesture_key.clear();                                      // Clear the recorded gesture key
+            // Open the stream with the scale factors the host needs to decode it
+            Telemetry_Record record;
+            telemetry_info_record(record, CaptureGyro::odr_hz, CaptureGyro::sensitivity, SEGMENT_RATE_HZ, GESTURE_RATE_HZ);
+            telemetry_post(record, 100ms);
+        }
+        log_printf("Telemetry %s, %lu records dropped so far\r\n", telemetry_enabled ? "on" : "off", (unsigned long)telemetry_dropped.value());
+        break;
 
-            // Display "Key Erasing finish." message
-            sprintf(display_buffer, "Key Erasing finish.");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display message
+    case 'w':
+        motion_wake_enabled = !motion_wake_enabled;                // Toggle hands-free unlock
+        post_event(EVENT_MOTION_MODE);                             // The controller arms the gyroscope when idle
+        log_printf("Hands-free unlock %s\r\n", motion_wake_enabled ? "on" : "off");
+        break;
 
-            unlocking_record.clear();                                 // Clear the unlocking record
+    case 'm':
+        metrics_refresh();                                         // Sample the gauges first
+        metrics_dump();
+        break;
 
-            // Reset LEDs and display "All Erasing finish." message
-            green_led = 1;                                           // Turn on green LED
-            red_led = 0;                                             // Turn off red LED
-            sprintf(display_buffer, "All Erasing finish.");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display message
+    case 'd':
+    {
+        Ui_Message *ui_message = ui_mail.try_alloc_for(100ms);     // The screen is not urgent, wait for a slot
+        if (ui_message != nullptr)
+        {
+            ui_message->type = UI_DIAGNOSTICS;                     // Toggle the diagnostics screen
+            ui_mail.put(ui_message);
         }
+        break;
+    }
 
-        // Handle KEY_FLAG or UNLOCK_FLAG events
-        if (flag_check & (KEY_FLAG | UNLOCK_FLAG))
+    case 's':
+        for (int probe = 0; probe < PROBE_COUNT; probe++)
         {
-            // Display "Hold On" message
-            sprintf(display_buffer, "Hold On");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display message
-
-            ThisThread::sleep_for(1s);                                // Wait for 1 second
-
-            // Display "Calibrating..." message
-            sprintf(display_buffer, "Calibrating...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display message
-
-            // Initialize gyroscope with the defined parameters
-            InitiateGyroscope(&init_parameters, &raw_data);           // Call function to initiate gyroscope
-
-            // Display countdown messages before recording
-            sprintf(display_buffer, "Recording in 3...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display countdown message
-            ThisThread::sleep_for(1s);                                // Wait for 1 second
-
-            sprintf(display_buffer, "Recording in 2...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display countdown message
-            ThisThread::sleep_for(1s);                                // Wait for 1 second
+            Telemetry_Record record;                               // Histogram of one probe
+            telemetry_profile_record(record, probe, profile_stats[probe]);
+            telemetry_post(record, 100ms);                         // The mail is small, wait for the UART
+        }
+        break;
+    }
+}
 
-            sprintf(display_buffer, "Recording in 1...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display countdown message
-            ThisThread::sleep_for(1s);                                // Wait for 1 second
+/*******************************************************************************
+ *
+ * @brief Console Thread
+ *
+ * This thread reads single-character commands from the serial console:
+ *  - p: print the profiler histograms
+ *  - r: clear the profiler histograms
+ *  - t: start or stop the binary telemetry stream
+ *  - s: send the profiler histograms as telemetry records
+ *  - m: print the runtime metrics
+ *  - d: show or hide the metrics on the LCD
+ *  - w: turn hands-free unlock on or off
+ * An enabled UART receiver keeps the CPU out of deep sleep, so the receiver is
+ * off while the console is idle and an edge interrupt on the RX pin watches
+ * the line instead. The first character only wakes the console; commands are
+ * read until the line stays quiet for CONSOLE_IDLE_TIMEOUT.
+ *
+ ******************************************************************************/
+void console_thread()
+{
+    console_rx_edge.fall(&onConsoleWake);                              // A start bit pulls the idle line low
+    console_serial.sigio(callback(onConsoleInput));                    // Received characters wake the thread
 
-            // Display "Recording..." message
-            sprintf(display_buffer, "Recording...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display recording message
-            
-            // Start recording gyroscope data for 5 seconds
-            timer.start();                                            // Start the timer
-            while (timer.elapsed_time() < 5s)                         // Loop for 5 seconds
+    while (1)
+    {
+        console_serial.enable_input(false);                            // Release the deep sleep lock
+        console_rx_edge.enable_irq();
+        flags.clear(CONSOLE_WAKE_FLAG);                                // Drop an edge latched while the UART had the line
+        flags.wait_any(CONSOLE_WAKE_FLAG);                             // Sleep until the line moves
+        console_rx_edge.disable_irq();                                 // The UART watches the line from now on
+        flags.clear(CONSOLE_INPUT_FLAG);
+        console_serial.enable_input(true);
+        console_wakes.add();
+        mbed_stats_cpu_t cpu_stats;                                    // Deep sleep share, needs platform.cpu-stats-enabled
+        mbed_stats_cpu_get(&cpu_stats);
+        log_printf("Console on, %lu %% of uptime in deep sleep\r\n",
+                   (unsigned long)(cpu_stats.uptime > 0 ? cpu_stats.deep_sleep_time * 100 / cpu_stats.uptime : 0));
+
+        do
+        {
+            char command;
+            while (console_serial.readable() && console_serial.read(&command, 1) == 1)
             {
-                flags.wait_all(DATA_READY_FLAG);                      // Wait until DATA_READY_FLAG is set
-                GetCalibratedRawData();                               // Retrieve calibrated raw gyroscope data
-                // Add the converted data to the temporary gesture key vector
-                temp_key.push_back({ConvertToDPS(raw_data.x_raw), ConvertToDPS(raw_data.y_raw), ConvertToDPS(raw_data.z_raw)});
-                ThisThread::sleep_for(50ms);                           // Wait for 50 milliseconds (20Hz sampling rate)
+                console_command(command);
             }
-            timer.stop();                                             // Stop the timer
-            timer.reset();                                            // Reset the timer
+        } while (!(flags.wait_any_for(CONSOLE_INPUT_FLAG, CONSOLE_IDLE_TIMEOUT) & osFlagsError));
+        log_printf("Console off, type any key to wake it\r\n");
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Telemetry Thread
+ *
+ * This thread frames queued records into one of two buffers and hands the
+ * buffer to the UART's DMA, then fills the other buffer while the first is on
+ * the wire. Raw samples are framed first since their queue fills fastest.
+ * Sequence numbers run across all record types, so the host sees every lost
+ * frame. The UART is opened here, so nothing is transmitted before the
+ * thread runs.
+ *
+ ******************************************************************************/
+void telemetry_thread()
+{
+    TelemetrySerial uart(MBED_CONF_APP_TELEMETRY_TX, MBED_CONF_APP_TELEMETRY_RX, MBED_CONF_APP_TELEMETRY_BAUD);
+    uart.set_dma_usage_tx(DMA_USAGE_ALWAYS);          // Transmit without a byte-by-byte interrupt
 
-            // Remove insignificant data from the recorded gesture
-            trim_gyro_data(temp_key);                                 // Trim the temporary gesture key data
+    Telemetry_Sample sample;                          // Sample taken from a queue
+    uint8_t sequence = 0;                             // Sequence number of the next frame
+    int active = 0;                                   // Buffer being filled
+    bool sending = false;                             // True while a DMA transfer may be running
 
-            // Display "Finished..." message
-            sprintf(display_buffer, "Finished...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display finished message
-        }
+    while (1)
+    {
+        uint8_t *buffer = telemetry_buffers[active];  // Buffer not on the wire
+        size_t used = 0;                              // Bytes framed into it
 
-        // Check if the event was for recording a key or unlocking
-        if (flag_check & KEY_FLAG)
+        while (used + TELEMETRY_MAX_FRAME <= TELEMETRY_TX_BUFFER)
         {
-            if (gesture_key.empty())                                // If no key is currently recorded
-            {
-                // Display "Saving Key..." message
-                sprintf(display_buffer, "Saving Key...");
-                lcd.SetTextColor(LCD_COLOR_ORANGE);                  // Set text color to orange
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_BLACK);                   // Set text color to black
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display saving message
-
-                gesture_key = temp_key;                              // Save the temporary gesture key as the main gesture key
-                temp_key.clear();                                    // Clear the temporary gesture key vector
-
-                // Toggle LEDs to indicate key is saved
-                red_led = 1;                                         // Turn on red LED
-                green_led = 0;                                       // Turn off green LED
-
-                // Display "Key saved..." message
-                sprintf(display_buffer, "Key saved...");
-                lcd.SetTextColor(LCD_COLOR_ORANGE);                  // Set text color to orange
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_BLACK);                   // Set text color to black
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display saved message
-
-                // Update buttons on the LCD
-                draw_button(button1_x, button1_y, button1_width, button1_height, button3); // Draw "RESET" button
-                remove_button(button1_x, button1_y + 50, button1_width, button1_height); // Remove the "RECORD" button
-                draw_button(button2_x, button2_y, button2_width, button2_height, button2_label); // Draw "UNLOCK" button
+            if (telemetry_raw_queue.pop(sample))
+            {
+                used += telemetry_frame_sample(TELEMETRY_RAW, sequence++, sample, buffer + used);
+            }
+            else if (telemetry_filtered_queue.pop(sample))
+            {
+                used += telemetry_frame_sample(TELEMETRY_FILTERED, sequence++, sample, buffer + used);
             }
             else
             {
-                // Display "Removing old key..." message
-                sprintf(display_buffer, "Removing old key...");
-                lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display removing message
-
-                ThisThread::sleep_for(1s);                                // Wait for 1 second
-                
-                gesture_key.clear();                                      // Clear the existing gesture key
-                gesture_key = temp_key;                                  // Save the new temporary gesture key as the main gesture key
-
-                // Display "New key is saved." message
-                sprintf(display_buffer, "New key is saved.");
-                lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display saved message
-
-                temp_key.clear();                                        // Clear the temporary gesture key vector
-
-                // Toggle LEDs to indicate new key is saved
-                red_led = 1;                                             // Turn on red LED
-                green_led = 0;                                           // Turn off green LED
+                Telemetry_Record *record = telemetry_mail.try_get(); // Take a record without blocking
+                if (record == nullptr)
+                {
+                    break;                            // Every queue is empty
+                }
+                used += telemetry_frame_record(*record, sequence++, buffer + used);
+                telemetry_mail.free(record);          // Return the slot to the queue
             }
         }
-        else if (flag_check & UNLOCK_FLAG)                           // If the event was for unlocking
-        {
-            flags.clear(UNLOCK_FLAG);                                 // Clear the UNLOCK_FLAG
-            // Display "Unlocking..." message
-            sprintf(display_buffer, "Unlocking...");
-            lcd.SetTextColor(LCD_COLOR_ORANGE);                      // Set text color to orange
-            lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE);       // Clear the specific line on LCD
-            lcd.SetTextColor(LCD_COLOR_BLACK);                       // Set text color to black
-            lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display unlocking message
-
-            unlocking_record = temp_key;                               // Save the temporary gesture key as the unlocking record
-            temp_key.clear();                                         // Clear the temporary gesture key vector
 
-            if (gesture_key.empty())                                  // If no gesture key is recorded
-            {
-                // Display "NO KEY SAVED." message
-                sprintf(display_buffer, "NO KEY SAVED.");
-                lcd.SetTextColor(LCD_COLOR_ORANGE);                  // Set text color to orange
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_BLACK);                   // Set text color to black
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display no key message
+        if (used == 0)
+        {
+            telemetry_flags.wait_any(TELEMETRY_DATA_FLAG); // Sleep until a producer queues something
+            continue;
+        }
 
-                unlocking_record.clear();                             // Clear the unlocking record
+        if (sending)
+        {
+            telemetry_flags.wait_any(TELEMETRY_TX_DONE_FLAG); // The other buffer must leave the wire first
+        }
+        uart.write(buffer, used, callback(onTelemetrySent), SERIAL_EVENT_TX_COMPLETE); // Start the DMA transfer
+        sending = true;
+        active ^= 1;                                  // Fill the other buffer next
+    }
+}
 
-                // Toggle LEDs to indicate no key is saved
-                green_led = 1;                                       // Turn on green LED
-                red_led = 0;                                         // Turn off red LED
-            }
-            else // If a gesture key is recorded, compare it with the unlocking record
-            {
-                int unlock = 0;                                        // Counter for correlated axes
+/*******************************************************************************
+ *
+ * @brief Log Thread
+ *
+ * This thread formats the entries queued with log_printf and prints them on
+ * the console, each prefixed with the time it was logged. It runs at the
+ * lowest priority, so only this thread ever waits for the UART. It sleeps
+ * while the ring is empty and reports entries lost to a full ring.
+ *
+ ******************************************************************************/
+void log_thread()
+{
+    Log_Entry entry;                                  // Entry taken from the ring
+    char line[LOG_LINE_SIZE];                         // Formatted line
+    uint32_t reported_drops = 0;                      // Dropped entries already reported
 
-                // Calculate correlation for each axis between gesture_key and unlocking_record
-                array<float, 3> correlationResult = calculateCorrelationVectors(gesture_key, unlocking_record); // Get correlation results
+    while (1)
+    {
+        if (log_read(entry))
+        {
+            int prefix = snprintf(line, sizeof(line), "[%6lu.%03lu] ",
+                                  (unsigned long)(entry.timestamp_us / 1000000), (unsigned long)(entry.timestamp_us / 1000 % 1000));
+            log_format(entry, line + prefix, sizeof(line) - prefix);
+            fputs(line, stdout);                      // Buffered console, blocks only this thread
+            continue;
+        }
 
-                if (err != 0)                                         // Check for correlation calculation errors
-                {
-                    printf("Error calculating correlation: vectors have different sizes\n"); // Print error message
-                }
-                else
-                {
-                    // Print correlation values for each axis
-                    printf("Correlation values: x = %f, y = %f, z = %f\n", correlationResult[0], correlationResult[1], correlationResult[2]);
-                    
-                    // Iterate through correlation results to check against threshold
-                    for (size_t i = 0; i < correlationResult.size(); i++)
-                    {
-                        if (correlationResult[i] > CORRELATION_THRESHOLD) // If correlation exceeds threshold
-                        {
-                            unlock++;                                   // Increment unlock counter
-                        }
-                    }
-                }
+        uint32_t drops = log_dropped();
+        if (drops != reported_drops)
+        {
+            printf("[log] %lu entries dropped\r\n", (unsigned long)(drops - reported_drops));
+            reported_drops = drops;
+        }
 
-                if (unlock == 3)                                      // If all three axes exceed threshold
-                {
-                    // Display "UNLOCK: SUCCESS" message
-                    sprintf(display_buffer, "UNLOCK: SUCCESS");
-                    lcd.SetTextColor(LCD_COLOR_GREEN);               // Set text color to green
-                    lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                    lcd.SetTextColor(LCD_COLOR_BLACK);               // Set text color to black
-                    lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display success message
-                    
-                    // Toggle LEDs to indicate successful unlock
-                    green_led = 1;                                   // Turn on green LED
-                    red_led = 0;                                     // Turn off red LED
-
-                    unlocking_record.clear();                        // Clear the unlocking record
-                    unlock = 0;                                      // Reset unlock counter
-                }
-                else
-                {
-                    // Display "UNLOCK: FAILED" message
-                    sprintf(display_buffer, "UNLOCK: FAILED");
-                    lcd.SetTextColor(LCD_COLOR_RED);                 // Set text color to red
-                    lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                    lcd.SetTextColor(LCD_COLOR_BLACK);               // Set text color to black
-                    lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display failure message
-
-                    // Toggle LEDs to indicate failed unlock
-                    green_led = 0;                                   // Turn off green LED
-                    red_led = 1;                                     // Turn on red LED
-
-                    unlocking_record.clear();                        // Clear the unlocking record
-                    unlock = 0;                                      // Reset unlock counter
-                }
-            }
+        if (log_pending())
+        {
+            ThisThread::yield();                      // A producer is still filling its slot
+            continue;
         }
-        ThisThread::sleep_for(100ms);                                 // Sleep for 100 milliseconds before next iteration
+        flags.wait_any(LOG_READY_FLAG);               // Sleep until the next entry
     }
 }
 
@@ -470,7 +1910,8 @@ void gyroscope_thread()
  *
  * @brief Touch Screen Thread
  *
- * This thread handles touch screen input, determining which button was pressed and setting corresponding flags.
+ * This thread handles touch screen input, determining which button was pressed and posting the corresponding event.
+ * It sleeps on the controller's INT line instead of polling, and polls only while a finger is held down.
  *
  ******************************************************************************/
 void touch_screen_thread()
@@ -481,16 +1922,16 @@ void touch_screen_thread()
     // Initialize the touch screen with the LCD's dimensions
     if (ts.Init(lcd.GetXSize(), lcd.GetYSize()) != TS_OK)          // Initialize touch screen and check for success
     {
-        printf("Failed to initialize the touch screen!\r\n");      // Print error message if initialization fails
+        log_printf("Failed to initialize the touch screen!\r\n");  // Print error message if initialization fails
         return;                                                    // Exit the thread if initialization fails
     }
-
-    // Define a buffer to hold display messages
-    char display_buffer[50];                                      // Buffer to store display messages
+    ts.ITConfig();                                                 // Let the controller signal touches on its INT pin
+    touch_int.fall(&onTouch);                                      // INT goes low when a finger lands
 
     // Infinite loop to handle touch inputs
     while (1)
     {
+        flags.wait_all(TOUCH_FLAG);                               // Sleep until the controller reports a touch
         ts.GetState(&ts_state);                                   // Get the current state of the touch screen
         if (ts_state.TouchDetected)                               // Check if a touch is detected
         {
@@ -500,94 +1941,273 @@ void touch_screen_thread()
             // Check if the touch is inside the "RECORD" button area (adjusted Y-coordinate)
             if (is_touch_inside_button(touch_x, touch_y + 50, button2_x, button2_y, button1_width, button1_height))
             {
-                // Display "Recording Initiated..." message
-                sprintf(display_buffer, "Recording Initiated...");
-                lcd.SetTextColor(LCD_COLOR_LIGHTBLUE);            // Set text color to light blue
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_DARKRED);              // Set text color to dark red
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display initiation message
-                ThisThread::sleep_for(1s);                         // Wait for 1 second
-                flags.set(KEY_FLAG);                               // Set KEY_FLAG to initiate recording
+                request_timestamp_us = touch_timestamp_us;         // Start the touch-to-capture clock
+                post_event(EVENT_RECORD_REQUEST);                  // Ask the controller to record a key
             }
 
             // Check if the touch is inside the "RESET" button area
             if (is_touch_inside_button(touch_x, touch_y, button2_x, button2_y, button1_width, button1_height))
             {
-                // Display "Resetting Key Initiated" message
-                sprintf(display_buffer, "Resetting Key Initiated");
-                lcd.SetTextColor(LCD_COLOR_LIGHTBLUE);            // Set text color to light blue
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_DARKRED);              // Set text color to dark red
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display reset message
-                ThisThread::sleep_for(1s);                         // Wait for 1 second
-                flags.set(KEY_FLAG);                               // Set KEY_FLAG to initiate key reset
+                request_timestamp_us = touch_timestamp_us;         // Start the touch-to-capture clock
+                post_event(EVENT_RECORD_REQUEST);                  // Ask the controller to record a new key
             }
 
             // Check if the touch is inside the "UNLOCK" button area
             if (is_touch_inside_button(touch_x, touch_y, button1_x, button1_y, button2_width, button2_height))
             {
-                // Display "Unlocking Initiated..." message
-                sprintf(display_buffer, "Unlocking Initiated...");
-                lcd.SetTextColor(LCD_COLOR_LIGHTBLUE);            // Set text color to light blue
-                lcd.FillRect(0, text_y, lcd.GetXSize(), FONT_SIZE); // Clear the specific line on LCD
-                lcd.SetTextColor(LCD_COLOR_DARKGREEN);             // Set text color to dark green
-                lcd.DisplayStringAt(text_x, text_y, (uint8_t *)display_buffer, CENTER_MODE); // Display unlocking message
-                ThisThread::sleep_for(1s);                         // Wait for 1 second
-                flags.set(UNLOCK_FLAG);                            // Set UNLOCK_FLAG to initiate unlocking
+                request_timestamp_us = touch_timestamp_us;         // Start the touch-to-capture clock
+                post_event(EVENT_UNLOCK_REQUEST);                  // Ask the controller to unlock
             }
         }
-        ThisThread::sleep_for(10ms);                                // Sleep for 10 milliseconds before next touch check
+
+        // One press is one request: wait for the finger to lift before re-arming the interrupt
+        do
+        {
+            ThisThread::sleep_for(TOUCH_RELEASE_POLL);              // Short polls only while the screen is held
+            ts.GetState(&ts_state);
+        } while (ts_state.TouchDetected);
+        ts.ITClear();                                               // Release INT for the next touch
+        flags.clear(TOUCH_FLAG);                                    // Drop edges raised during this press
+    }
+}
+
+/*******************************************************************************
+ *
+ * @brief Queue a Status Line Update for the UI Thread
+ * @param text: Message to display
+ * @param fill_color: Background color of the status line
+ * @param text_color: Text color of the message
+ *
+ * The update is dropped if the UI queue is full; the next one redraws the line.
+ *
+ ******************************************************************************/
+void show_status(const char *text, uint32_t fill_color, uint32_t text_color)
+{
+    Ui_Message *ui_message = ui_mail.try_alloc();                 // Take a free slot without blocking
+    if (ui_message == nullptr)
+    {
+        return;                                                    // Queue full, drop the update
+    }
+    ui_message->type = UI_STATUS;                                  // Status line update
+    ui_message->fill_color = fill_color;                           // Store the background color
+    ui_message->text_color = text_color;                           // Store the text color
+    strncpy(ui_message->text, text, UI_TEXT_SIZE - 1);             // Copy the message
+    ui_message->text[UI_TEXT_SIZE - 1] = '\0';                     // Always terminate the message
+    ui_mail.put(ui_message);                                       // Hand the update to the UI thread
+}
+
+/*******************************************************************************
+ *
+ * @brief Queue a Progress Bar Update for the UI Thread
+ * @param percent: Filled share of the bar, 0 hides it
+ *
+ * Replaces a blocking wait with visible progress. The update is dropped if
+ * the UI queue is full; the next one redraws the bar.
+ *
+ ******************************************************************************/
+void show_progress(uint32_t percent)
+{
+    Ui_Message *ui_message = ui_mail.try_alloc();                 // Take a free slot without blocking
+    if (ui_message == nullptr)
+    {
+        return;                                                    // Queue full, drop the update
     }
+    ui_message->type = UI_PROGRESS;                                // Progress bar update
+    ui_message->percent = percent > 100 ? 100 : percent;           // Store the fill
+    ui_mail.put(ui_message);                                       // Hand the update to the UI thread
 }
 
 /*******************************************************************************
  *
  * @brief Store Gyroscope Data to Flash Memory
- * @param gesture_key: The gesture data to store
- * @param flash_address: The starting address in flash memory to store the data
+ * @param gesture_key: The gesture key to store
+ * @param flash_address: The start of the flash sector to store the data in
  * @return true if data is stored successfully, false otherwise
  *
+ * The rates and the rotation path are written in the gesture codec's
+ * KEY_CODEC_FORMAT, see gesture_codec.h, one KEY_SLOT_BYTES slot each, after
+ * erasing the whole sector.
+ *
  ******************************************************************************/
-bool storeGyroDataToFlash(vector<array<float, 3>> &gesture_key, uint32_t flash_address)
+bool storeGyroDataToFlash(const Gesture_Template &gesture_key, uint32_t flash_address)
 {
-    FlashIAP flash;                                               // Create a FlashIAP object for flash memory operations
-    flash.init();                                                // Initialize the flash interface
+    static uint8_t encoded[CODEC_MAX_BYTES];                     // Encoded trace, static to keep it off the caller's stack
+    const Gesture_Trace *traces[2] = {&gesture_key.trace, &gesture_key.path};
 
-    // Calculate the total size of the data to be stored in bytes
-    uint32_t data_size = gesture_key.size() * sizeof(array<float, 3>); // Total size in bytes
+    if (!eraseGyroDataFromFlash(flash_address))
+    {
+        return false;                                            // Programming needs an erased sector
+    }
 
-    // Erase the flash sector where data will be stored
-    flash.erase(flash_address, data_size);                      // Erase flash memory at specified address
+    FlashIAP flash;                                               // Create a FlashIAP object for flash memory operations
+    flash.init();                                                // Initialize the flash interface
+    uint32_t page_size = flash.get_page_size();                  // Program granularity
+    bool stored = true;
+    for (int slot = 0; slot < 2 && stored; slot++)
+    {
+        // Compress the trace; the size is padded to whole program pages
+        size_t data_size = codec_encode(*traces[slot], KEY_CODEC_FORMAT, encoded, sizeof(encoded));
+        uint32_t program_size = (data_size + page_size - 1) / page_size * page_size;
+        if (data_size == 0 || program_size > sizeof(encoded))
+        {
+            stored = false;                                      // Cannot happen for a trace of at most GESTURE_MAX_SAMPLES
+            break;
+        }
+        memset(encoded + data_size, 0xFF, program_size - data_size); // Pad with the erased value
 
-    // Write the gesture data to flash memory
-    int write_result = flash.program(gesture_key.data(), flash_address, data_size); // Program flash with gesture data
+        PROFILE_SCOPE(PROBE_FLASH);                              // Time the program operation
+        stored = flash.program(encoded, flash_address + slot * KEY_SLOT_BYTES, program_size) == 0;
+        flash_writes.add();                                      // Count the program operation
+    }
 
     flash.deinit();                                              // Deinitialize the flash interface
-
-    return write_result == 0;                                    // Return true if programming was successful
+    return stored;
 }
 
 /*******************************************************************************
  *
  * @brief Read Gyroscope Data from Flash Memory
+ * @param gesture_key: Preallocated template receiving the data
  * @param flash_address: The starting address in flash memory to read from
- * @param data_size: The number of data elements to read
- * @return A vector containing the read gyroscope data
+ * @return true if a valid key was read, false if there is none or it does not fit
+ *
+ * The internal flash is memory-mapped, so the rates and the path decode
+ * straight out of it with no staging buffer, and the template is finalized
+ * like a fresh capture. Erased flash fails the codec's header check.
  *
  ******************************************************************************/
-vector<array<float, 3>> readGyroDataFromFlash(uint32_t flash_address, size_t data_size)
+bool readGyroDataFromFlash(Gesture_Template &gesture_key, uint32_t flash_address)
 {
-    vector<array<float, 3>> gesture_key(data_size);               // Initialize a vector to hold the read data
+    PROFILE_SCOPE(PROBE_FLASH);                                  // Time the decode
+    const uint8_t *slots = reinterpret_cast<const uint8_t *>(flash_address);
+    if (!codec_decode(slots, KEY_SLOT_BYTES, gesture_key.trace) ||
+        !codec_decode(slots + KEY_SLOT_BYTES, KEY_SLOT_BYTES, gesture_key.path) ||
+        gesture_key.trace.size == 0 || gesture_key.path.size != gesture_key.trace.size)
+    {
+        template_clear(gesture_key);                             // No key, or a damaged one
+        return false;
+    }
+    template_finalize(gesture_key);                              // Rebuild the resampled copy and embedding
+    return true;
+}
 
+/*******************************************************************************
+ *
+ * @brief Erase Gyroscope Data from Flash Memory
+ * @param flash_address: The start of the flash sector holding the data
+ * @return true if the sector was erased, false otherwise
+ *
+ ******************************************************************************/
+bool eraseGyroDataFromFlash(uint32_t flash_address)
+{
     FlashIAP flash;                                               // Create a FlashIAP object for flash memory operations
     flash.init();                                                // Initialize the flash interface
+    PROFILE_SCOPE(PROBE_FLASH);                                  // Time the erase
+    int erase_result = flash.erase(flash_address, flash.get_sector_size(flash_address)); // Erase the whole sector
+    flash.deinit();                                              // Deinitialize the flash interface
+    return erase_result == 0;                                    // Return true if erasing was successful
+}
 
-    // Read the gesture data from flash memory
-    flash.read(gesture_key.data(), flash_address, data_size * sizeof(array<float, 3>)); // Read data from flash
+/*******************************************************************************
+ *
+ * @brief Sample Every Gauge
+ *
+ * Gauges are measured on demand rather than kept up to date, so the hot
+ * paths never pay for them. Thread stack peaks need
+ * platform.stack-stats-enabled.
+ *
+ ******************************************************************************/
+void metrics_refresh()
+{
+    mbed_stats_heap_t heap_stats;                                // Heap statistics, needs platform.heap-stats-enabled
+    mbed_stats_heap_get(&heap_stats);
+    heap_current.set(heap_stats.current_size);
+    heap_peak.set(heap_stats.max_size);
+    arena_peak.set(gesture_arena.high_water());
+    log_lost.set(log_dropped());
+
+    // Duty cycles as shares of uptime
+    uint32_t gyro_total_ms = 0;                                  // Time accounted over all power modes
+    for (int mode = 0; mode < GYRO_POWER_MODES; mode++)
+    {
+        gyro_total_ms += GetGyroscopePowerTime((Gyroscope_PowerMode)mode);
+    }
+    if (gyro_total_ms > 0)
+    {
+        gyro_active_share.set((uint32_t)((uint64_t)GetGyroscopePowerTime(GYRO_ACTIVE) * 100 / gyro_total_ms));
+        gyro_sleep_share.set((uint32_t)((uint64_t)GetGyroscopePowerTime(GYRO_SLEEP) * 100 / gyro_total_ms));
+        gyro_off_share.set((uint32_t)((uint64_t)GetGyroscopePowerTime(GYRO_POWER_DOWN) * 100 / gyro_total_ms));
+    }
+    mbed_stats_cpu_t cpu_stats;                                  // CPU time split, needs platform.cpu-stats-enabled
+    mbed_stats_cpu_get(&cpu_stats);
+    if (cpu_stats.uptime > 0)
+    {
+        cpu_active_share.set((uint32_t)((cpu_stats.uptime - cpu_stats.idle_time) * 100 / cpu_stats.uptime));
+        cpu_deep_sleep_share.set((uint32_t)(cpu_stats.deep_sleep_time * 100 / cpu_stats.uptime));
+    }
+    for (int i = 0; i < THREAD_COUNT; i++)
+    {
+        if (thread_list[i] != nullptr)
+        {
+            stack_peak[i].set(thread_list[i]->max_stack());      // Deepest use so far
+        }
+    }
+}
 
-    flash.deinit();                                              // Deinitialize the flash interface
+/*******************************************************************************
+ *
+ * @brief Draw the Metrics on the LCD
+ *
+ * Lists every metric in the small font above the status line; metrics that
+ * do not fit are left out. Runs on the UI thread.
+ *
+ ******************************************************************************/
+void draw_diagnostics()
+{
+    char line[METRIC_LINE_SIZE];                                 // One formatted metric
+    sFONT *font = lcd.GetFont();                                 // Font of the home screen
+    uint32_t back_color = lcd.GetBackColor();                    // Text background of the home screen
+    metrics_refresh();                                           // Sample the gauges first
+
+    lcd.Clear(LCD_COLOR_BLACK);
+    lcd.SetFont(&Font8);                                         // 48 columns, one metric per line
+    lcd.SetBackColor(LCD_COLOR_BLACK);
+    lcd.SetTextColor(LCD_COLOR_WHITE);
+    int y = 0;                                                   // Top of the next line
+    for (const Metric *metric = Metric::first(); metric != nullptr && y + Font8.Height <= text_y; metric = metric->next())
+    {
+        metric_format(*metric, line, sizeof(line));
+        lcd.DisplayStringAt(0, y, (uint8_t *)line, LEFT_MODE);
+        y += Font8.Height;
+    }
+    lcd.SetFont(font);                                           // Restore the home screen font
+    lcd.SetBackColor(back_color);
+}
 
-    return gesture_key;                                         // Return the read gesture data
+/*******************************************************************************
+ *
+ * @brief Redraw the Buttons and Banners
+ *
+ * Restores the screen main() draws at start-up, with the buttons matching
+ * whether a key is recorded. Runs on the UI thread.
+ *
+ ******************************************************************************/
+void draw_home_screen()
+{
+    lcd.Clear(LCD_COLOR_ORANGE);                                 // Clear the LCD with orange background color
+    lcd.SetTextColor(LCD_COLOR_BLACK);
+    lcd.DisplayStringAt(message_x, message_y, (uint8_t *)message, CENTER_MODE); // Display the welcome message
+    if (gesture_key.trace.size == 0)
+    {
+        draw_button(button1_x, button1_y + 50, button1_width, button1_height, button1_label); // Draw "RECORD" button
+        lcd.DisplayStringAt(text_x, text_y, (uint8_t *)text_0, CENTER_MODE); // Display "NO KEY RECORDED" message
+    }
+    else
+    {
+        draw_button(button1_x, button1_y, button1_width, button1_height, button3); // Draw "RESET" button
+        draw_button(button2_x, button2_y, button2_width, button2_height, button2_label); // Draw "UNLOCK" button
+        lcd.DisplayStringAt(text_x, text_y, (uint8_t *)text_1, CENTER_MODE); // Display "LOCKED" message
+    }
 }
 
 /*******************************************************************************
@@ -646,185 +2266,126 @@ bool is_touch_inside_button(int touch_x, int touch_y, int button_x, int button_y
 
 /*******************************************************************************
  *
- * @brief Calculate the Euclidean Distance Between Two 3D Vectors
- * @param a: The first 3D vector
- * @param b: The second 3D vector
- * @return The Euclidean distance between vectors a and b
+ * @brief Update Stage Latency Counters for One Sample
+ * @param stats: Counters of the stage that handled the sample
+ * @param timestamp_us: DRDY time of the sample
+ * @return Latency of the sample in microseconds
  *
  ******************************************************************************/
-float euclidean_distance(const array<float, 3> &a, const array<float, 3> &b)
+uint32_t stage_record(Stage_Stats &stats, uint32_t timestamp_us)
 {
-    float sum = 0;                                                // Initialize sum of squared differences
-    for (size_t i = 0; i < 3; ++i)                               // Iterate over each axis
-    {
-        sum += (a[i] - b[i]) * (a[i] - b[i]);                    // Accumulate squared differences
-    }
-    return sqrt(sum);                                            // Return the square root of the sum (Euclidean distance)
+    uint32_t latency = us_ticker_read() - timestamp_us;         // Time since the DRDY edge
+    stats.processed++;                                          // Count the sample
+    stats.last_latency_us = latency;                            // Keep the latest latency
+    stats.max_latency_us = max(stats.max_latency_us, latency);  // Keep the worst latency
+    return latency;
 }
 
 /*******************************************************************************
  *
- * @brief Calculate the Dynamic Time Warping (DTW) Distance Between Two Gesture Sequences
- * @param s: The first gesture sequence
- * @param t: The second gesture sequence
- * @return The DTW distance between sequences s and t
+ * @brief Log the Counters of One Pipeline Stage
+ * @param name: Stage name, a string literal
+ * @param stats: Counters to print
  *
  ******************************************************************************/
-float dtw(const vector<array<float, 3>> &s, const vector<array<float, 3>> &t)
+void print_stage_stats(const char *name, const Stage_Stats &stats)
 {
-    // Initialize DTW matrix with infinities
-    vector<vector<float>> dtw_matrix(s.size() + 1, vector<float>(t.size() + 1, numeric_limits<float>::infinity()));
-
-    dtw_matrix[0][0] = 0;                                        // Set the starting point to zero
-
-    for (size_t i = 1; i <= s.size(); ++i)                      // Iterate over the first sequence
-    {
-        for (size_t j = 1; j <= t.size(); ++j)                  // Iterate over the second sequence
-        {
-            float cost = euclidean_distance(s[i - 1], t[j - 1]); // Calculate cost between current elements
-            // Update DTW matrix with the minimum cost path
-            dtw_matrix[i][j] = cost + min({dtw_matrix[i - 1][j], dtw_matrix[i][j - 1], dtw_matrix[i - 1][j - 1]});
-        }
-    }
-
-    return dtw_matrix[s.size()][t.size()];                       // Return the final DTW distance
+    log_printf("Stage %s: processed = %lu, dropped = %lu, max queue = %lu, latency = %lu us (max %lu us)\r\n",
+           name, (unsigned long)stats.processed, (unsigned long)stats.dropped, (unsigned long)stats.max_occupancy,
+           (unsigned long)stats.last_latency_us, (unsigned long)stats.max_latency_us);
 }
 
 /*******************************************************************************
  *
- * @brief Trim Insignificant Gyroscope Data from a Gesture Sequence
- * @param data: The gesture data to trim
+ * @brief Queue One Sample for the Telemetry Thread
+ * @param queue: Telemetry queue owned by the calling stage
+ * @param timestamp_us: DRDY time of the sample
+ * @param raw: Sample in raw digits
+ *
+ * Does nothing while the stream is off. A full queue drops the sample and
+ * counts it; the gap shows up as missing sequence numbers on the host.
  *
  ******************************************************************************/
-void trim_gyro_data(vector<array<float, 3>> &data)
+template <typename Queue>
+void telemetry_push_sample(Queue &queue, uint32_t timestamp_us, const Gyroscope_RawData &raw)
 {
-    float threshold = 1e-8f;                                     // Define a small threshold to identify insignificant data
-    auto ptr = data.begin();                                     // Iterator to traverse the data
-
-    // Find the first element where any axis exceeds the threshold
-    while (ptr != data.end() && 
-           abs((*ptr)[0]) <= threshold && 
-           abs((*ptr)[1]) <= threshold && 
-           abs((*ptr)[2]) <= threshold)
-    {
-        ptr++;                                                    // Move to the next element
-    }
-
-    if (ptr == data.end())                                       // If all data points are below threshold
-        return;                                                  // No trimming needed
-
-    auto lptr = ptr;                                             // Left boundary pointer
-
-    // Start searching from the end to find the last significant data point
-    ptr = data.end() - 1;                                        // Set pointer to the last element
-    while (abs((*ptr)[0]) <= threshold && 
-           abs((*ptr)[1]) <= threshold && 
-           abs((*ptr)[2]) <= threshold && 
-           ptr != data.begin())
+    if (!telemetry_enabled)
     {
-        ptr--;                                                    // Move to the previous element
+        return;                                                 // Nobody is listening
     }
-
-    auto rptr = ptr;                                             // Right boundary pointer
-
-    // Move significant data to the front of the vector
-    auto replace_ptr = data.begin();                             // Pointer for replacement
-    for (; replace_ptr != lptr && lptr <= rptr; replace_ptr++, lptr++)
-    {
-        *replace_ptr = *lptr;                                    // Replace data with significant data
-    }
-
-    // Trim the end of the vector based on the boundaries
-    if (lptr > rptr)
+    Telemetry_Sample sample = {timestamp_us, raw.x_raw, raw.y_raw, raw.z_raw};
+    if (queue.push(sample))
     {
-        data.erase(replace_ptr, data.end());                     // Erase from replacement pointer to the end
+        telemetry_flags.set(TELEMETRY_DATA_FLAG);               // Wake the telemetry thread
     }
     else
     {
-        data.erase(rptr + 1, data.end());                        // Erase from the last significant point to the end
+        telemetry_dropped.add();                                // The UART fell behind
     }
 }
 
 /*******************************************************************************
  *
- * @brief Calculate the Pearson Correlation Between Two Vectors
- * @param a: The first vector
- * @param b: The second vector
- * @return The Pearson correlation coefficient between vectors a and b
+ * @brief Queue One Record for the Telemetry Thread
+ * @param record: Serialized record, copied into the queue
+ * @param timeout: Time to wait for a free slot
+ * @return true if the record was queued, false if it was dropped
  *
  ******************************************************************************/
-float correlation(const vector<float> &a, const vector<float> &b)
+bool telemetry_post(const Telemetry_Record &record, Kernel::Clock::duration_u32 timeout)
 {
-    // Check if both vectors are of the same size
-    if (a.size() != b.size())
-    {
-        err = -1;                                                // Set error flag if sizes differ
-        return 0.0f;                                             // Return zero correlation
-    }
-
-    float sum_a = 0, sum_b = 0, sum_ab = 0, sq_sum_a = 0, sq_sum_b = 0; // Initialize sums
-
-    for (size_t i = 0; i < a.size(); ++i)                      // Iterate over each element
+    Telemetry_Record *slot = telemetry_mail.try_alloc_for(timeout); // Take a free slot
+    if (slot == nullptr)
     {
-        sum_a += a[i];                                          // Sum of elements in vector a
-        sum_b += b[i];                                          // Sum of elements in vector b
-        sum_ab += a[i] * b[i];                                  // Sum of element-wise products
-        sq_sum_a += a[i] * a[i];                                // Sum of squares of vector a
-        sq_sum_b += b[i] * b[i];                                // Sum of squares of vector b
+        telemetry_dropped.add();                                // Queue full, drop the record
+        return false;
     }
-
-    size_t n = a.size();                                        // Number of elements
-
-    float numerator = n * sum_ab - sum_a * sum_b;               // Calculate covariance
-
-    float denominator = sqrt((n * sq_sum_a - sum_a * sum_a) * 
-                             (n * sq_sum_b - sum_b * sum_b));  // Calculate product of standard deviations
-
-    return numerator / denominator;                             // Return Pearson correlation coefficient
+    *slot = record;                                             // Copy the record
+    telemetry_mail.put(slot);                                   // Hand it to the telemetry thread
+    telemetry_flags.set(TELEMETRY_DATA_FLAG);                   // Wake the telemetry thread
+    return true;
 }
 
 /*******************************************************************************
  *
- * @brief Calculate Pearson Correlation for Each Axis Between Two Gesture Sequences
- * @param vec1: The first gesture sequence
- * @param vec2: The second gesture sequence
- * @return An array containing correlation coefficients for x, y, and z axes
+ * @brief Stream a Finished Capture to the Host
+ * @param gesture: Finalized capture, still owned by the matcher thread
+ * @param end_us: Time the capture ended, identifies the capture on the host
+ *
+ * Sends one TELEMETRY_GESTURE record per sample while telemetry is on, so
+ * serial_dump.py can collect a corpus for the host tools. Waits for the UART
+ * to drain, which delays the hand-over by a few tens of milliseconds per
+ * capture; a capture that cannot be sent completely is abandoned.
  *
  ******************************************************************************/
-array<float, 3> calculateCorrelationVectors(vector<array<float, 3>>& vec1, vector<array<float, 3>>& vec2) 
+void telemetry_send_gesture(const Gesture_Template &gesture, uint32_t end_us)
 {
-    array<float, 3> result;                                     // Array to store correlation results for each axis
-
-    // Calculate correlation for each of the three axes
-    for (int i = 0; i < 3; i++) 
+    if (!telemetry_enabled)
     {
-        vector<float> a;                                        // Vector to hold axis i data from vec1
-        vector<float> b;                                        // Vector to hold axis i data from vec2
-
-        // Populate 'a' with the i-th coordinate from vec1
-        for (const auto& arr : vec1) 
-        {
-            a.push_back(arr[i]);                                 // Add i-th coordinate to vector a
-        }
-        // Populate 'b' with the i-th coordinate from vec2
-        for (const auto& arr : vec2) 
-        {
-            b.push_back(arr[i]);                                 // Add i-th coordinate to vector b
-        }
-
-        // Resize vectors to match sizes by padding with zeros if necessary
-        if (a.size() > b.size()) 
-        {
-            a.resize(b.size(), 0);                               // Resize a to match b's size, pad with zeros
-        } 
-        else if (b.size() > a.size()) 
+        return;
+    }
+    for (size_t i = 0; i < gesture.trace.size; i++)
+    {
+        Telemetry_Record record;                                // One sample of the capture
+        telemetry_gesture_record(record, end_us, gesture, i);
+        if (!telemetry_post(record, 10ms))
         {
-            b.resize(a.size(), 0);                               // Resize b to match a's size, pad with zeros
+            break;                                              // The host drops partial captures
         }
-
-        // Calculate Pearson correlation for the current axis and store in result
-        result[i] = correlation(a, b);                          // Store correlation coefficient for axis i
     }
+}
 
-    return result;                                              // Return the array of correlation coefficients
+/*******************************************************************************
+ *
+ * @brief Log the Bytes a Controller Flow Copied
+ * @param flow: Flow name, a string literal
+ * @param since: trace_bytes_copied when the flow started
+ *
+ * Save, unlock and erase hand buffers over by swapping slots, so every flow
+ * is expected to report 0 bytes.
+ *
+ ******************************************************************************/
+void report_copies(const char *flow, uint32_t since)
+{
+    log_printf("Copy benchmark: %s flow copied %lu bytes\r\n", flow, (unsigned long)(trace_bytes_copied - since));
 }
@@ -0,0 +1,228 @@
+#include <math.h>                                // Include math functions
+#include <algorithm>                             // Include min and swap
+#include <limits>                                // Include limits for numeric limits
+#include "matcher.h"                             // Include the matcher header
+
+using namespace std;
+
+/*******************************************************************************
+ *
+ * @brief Calculate the Euclidean Distance Between Two 3D Vectors
+ * @param a: The first 3D vector
+ * @param b: The second 3D vector
+ * @return The Euclidean distance between vectors a and b
+ *
+ ******************************************************************************/
+float euclidean_distance(const array<float, 3> &a, const array<float, 3> &b)
+{
+    return L2Cost::distance(a, b);                               // Same expression the DTW cells inline
+}
+
+/*******************************************************************************
+ *
+ * @brief Calculate the Dynamic Time Warping (DTW) Distance Between Two Gesture Sequences
+ * @param s: The first gesture sequence
+ * @param t: The second gesture sequence
+ * @param scratch: Arena providing two rows of scratch, released on return
+ * @return The DTW distance between sequences s and t
+ *
+ ******************************************************************************/
+float dtw(const Gesture_Trace &s, const Gesture_Trace &t, BumpArena &scratch)
+{
+    return dtw_with<L2Cost>(s, t, scratch);                      // Euclidean cell cost, see dtw_cost.h
+}
+
+/*******************************************************************************
+ *
+ * @brief Calculate the DTW Distance Within a Sakoe-Chiba Band
+ * @param s: The first gesture sequence
+ * @param t: The second gesture sequence
+ * @param band: Largest distance in samples of t from the scaled diagonal
+ * @param scratch: Arena providing two rows of scratch, released on return
+ * @return The banded DTW distance between sequences s and t
+ *
+ * Row i only evaluates the columns within band of i * m / n, so the cost is
+ * O(n * band) instead of O(n * m) and pathological warpings that map most of
+ * one gesture onto a few samples of the other are ruled out. The band is
+ * widened to the slope of the diagonal when the lengths differ that much, so
+ * the corner stays reachable. Cells outside the band stay infinite: before a
+ * row is written, the window its buffer held two rows earlier is reset.
+ *
+ ******************************************************************************/
+float dtw_banded(const Gesture_Trace &s, const Gesture_Trace &t, size_t band, BumpArena &scratch)
+{
+    return dtw_banded_with<L2Cost>(s, t, band, scratch);         // Euclidean cell cost, see dtw_cost.h
+}
+
+/*******************************************************************************
+ *
+ * @brief Calculate the Banded DTW Distance of the First Derivatives
+ * @param s: The first gesture sequence
+ * @param t: The second gesture sequence
+ * @param band: Largest distance in samples of t from the scaled diagonal
+ * @param scratch: Arena providing both derivatives and two rows, released on return
+ * @return The banded DTW distance of the derivatives, infinity if either sequence is shorter than 3 samples
+ *
+ * Each sample is replaced by the slope estimate
+ *
+ *   d[i] = ((x[i] - x[i - 1]) + (x[i + 1] - x[i - 1]) / 2) / 2
+ *
+ * with the end samples copying their neighbours. DTW on the raw rates pairs
+ * samples of similar value, so a repetition performed with more swing is
+ * warped onto the wrong phase of the key; slopes pair rises with rises and
+ * peaks with peaks whatever their height.
+ *
+ ******************************************************************************/
+float dtw_derivative(const Gesture_Trace &s, const Gesture_Trace &t, size_t band, BumpArena &scratch)
+{
+    if (s.size < 3 || t.size < 3)
+    {
+        return numeric_limits<float>::infinity();               // No interior sample to estimate a slope at
+    }
+    size_t mark = scratch.mark();                               // Scratch is released on return
+    Gesture_Trace slopes[2];                                    // Derivatives of s and t
+    const Gesture_Trace *sources[2] = {&s, &t};
+    float distance = numeric_limits<float>::infinity();
+    for (int k = 0; k < 2; k++)
+    {
+        const Gesture_Trace &x = *sources[k];
+        trace_init(slopes[k], scratch.allocate<Gesture_Sample>(x.size), x.size);
+        if (slopes[k].capacity < x.size)
+        {
+            scratch.release(mark);
+            return distance;                                    // No scratch left, treat as no match
+        }
+        for (size_t i = 1; i + 1 < x.size; i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float back = x.samples[i][axis] - x.samples[i - 1][axis];
+                float across = x.samples[i + 1][axis] - x.samples[i - 1][axis];
+                slopes[k].samples[i][axis] = (back + across * 0.5f) * 0.5f;
+            }
+        }
+        slopes[k].samples[0] = slopes[k].samples[1];            // Ends copy their neighbours
+        slopes[k].samples[x.size - 1] = slopes[k].samples[x.size - 2];
+        slopes[k].size = x.size;
+    }
+    distance = dtw_banded(slopes[0], slopes[1], band, scratch);
+    scratch.release(mark);
+    return distance;
+}
+
+/*******************************************************************************
+ *
+ * @brief Calculate the Banded DTW Distance of the Z-Normalized Sequences
+ * @param s: The first gesture sequence
+ * @param s_features: Embedding of s, providing its per-axis mean and deviation
+ * @param t: The second gesture sequence
+ * @param t_features: Embedding of t, providing its per-axis mean and deviation
+ * @param band: Largest distance in samples of t from the scaled diagonal
+ * @param scratch: Arena providing both normalized copies and two rows, released on return
+ * @return The banded DTW distance of the normalized sequences, in standard deviations
+ *
+ * Every axis is shifted to zero mean and scaled to unit deviation before
+ * alignment, so repetitions that differ only in amplitude or offset score as
+ * identical. The moments were computed by features_extract() in the pass
+ * that built the embedding, which leaves one multiply-add per coordinate
+ * here. Deviations are floored at ZNORM_DEVIATION_FLOOR so an axis that
+ * barely moved is not blown up to unit noise.
+ *
+ ******************************************************************************/
+float dtw_znormalized(const Gesture_Trace &s, const Gesture_Features &s_features, const Gesture_Trace &t,
+                      const Gesture_Features &t_features, size_t band, BumpArena &scratch)
+{
+    size_t mark = scratch.mark();                               // Scratch is released on return
+    Gesture_Trace normalized[2];                                // Normalized copies of s and t
+    const Gesture_Trace *sources[2] = {&s, &t};
+    const Gesture_Features *moments[2] = {&s_features, &t_features};
+    for (int k = 0; k < 2; k++)
+    {
+        const Gesture_Trace &x = *sources[k];
+        trace_init(normalized[k], scratch.allocate<Gesture_Sample>(x.size), x.size);
+        if (normalized[k].capacity < x.size)
+        {
+            scratch.release(mark);
+            return numeric_limits<float>::infinity();           // No scratch left, treat as no match
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float mean = moments[k]->mean[axis];
+            float scale = 1.0f / max(moments[k]->deviation[axis], ZNORM_DEVIATION_FLOOR);
+            for (size_t i = 0; i < x.size; i++)
+            {
+                normalized[k].samples[i][axis] = (x.samples[i][axis] - mean) * scale;
+            }
+        }
+        normalized[k].size = x.size;
+    }
+    float distance = dtw_banded(normalized[0], normalized[1], band, scratch);
+    scratch.release(mark);
+    return distance;
+}
+
+/*******************************************************************************
+ *
+ * @brief Add One Pair to a Streaming Pearson Correlation
+ * @param sums: The running sums to update
+ * @param a: Element of the first sequence
+ * @param b: Element of the second sequence
+ *
+ ******************************************************************************/
+void correlation_accumulate(Correlation_Sums &sums, float a, float b)
+{
+    sums.sum_a += a;                                            // Sum of elements in a
+    sums.sum_b += b;                                            // Sum of elements in b
+    sums.sum_ab += a * b;                                       // Sum of element-wise products
+    sums.sq_sum_a += a * a;                                     // Sum of squares of a
+    sums.sq_sum_b += b * b;                                     // Sum of squares of b
+    sums.n++;                                                   // Number of elements
+}
+
+/*******************************************************************************
+ *
+ * @brief Calculate the Pearson Correlation from Running Sums
+ * @param sums: The accumulated sums
+ * @return The Pearson correlation coefficient of the accumulated pairs
+ *
+ ******************************************************************************/
+float correlation_finish(const Correlation_Sums &sums)
+{
+    size_t n = sums.n;                                          // Number of elements
+
+    float numerator = n * sums.sum_ab - sums.sum_a * sums.sum_b; // Calculate covariance
+
+    float denominator = sqrt((n * sums.sq_sum_a - sums.sum_a * sums.sum_a) *
+                             (n * sums.sq_sum_b - sums.sum_b * sums.sum_b)); // Calculate product of standard deviations
+
+    return numerator / denominator;                             // Return Pearson correlation coefficient
+}
+
+/*******************************************************************************
+ *
+ * @brief Calculate Pearson Correlation for Each Axis Between Two Gesture Sequences
+ * @param vec1: The first gesture sequence
+ * @param vec2: The second gesture sequence
+ * @return An array containing correlation coefficients for x, y, and z axes
+ *
+ ******************************************************************************/
+array<float, 3> calculateCorrelationVectors(const Gesture_Trace &vec1, const Gesture_Trace &vec2)
+{
+    array<float, 3> result;                                     // Array to store correlation results for each axis
+    size_t n = min(vec1.size, vec2.size);                       // Compare only the overlapping prefix
+
+    // Calculate correlation for each of the three axes
+    for (int i = 0; i < 3; i++)
+    {
+        Correlation_Sums sums = {0, 0, 0, 0, 0, 0};             // Initialize sums
+        for (size_t k = 0; k < n; k++)
+        {
+            correlation_accumulate(sums, vec1.samples[k][i], vec2.samples[k][i]); // Add the i-th coordinates
+        }
+
+        // Calculate Pearson correlation for the current axis and store in result
+        result[i] = correlation_finish(sums);                   // Store correlation coefficient for axis i
+    }
+
+    return result;                                              // Return the array of correlation coefficients
+}
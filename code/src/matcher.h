@@ -0,0 +1,56 @@
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <stddef.h>
+#include <array>
+#include "gesture_arena.h"
+#include "gesture_trace.h"
+#include "gesture_template.h"
+#include "dtw_cost.h"
+
+// Define the matching thresholds
+#define CORRELATION_THRESHOLD 0.0005f // Minimum per-axis correlation of the resampled traces
+#define DTW_THRESHOLD 0.35f           // Maximum DTW distance per warping step, in radians of rotation
+#define RATE_DTW_THRESHOLD 25.0f      // Maximum banded DTW distance of the resampled rates per warping step, in dps per sample
+#define DERIVATIVE_DTW_THRESHOLD 5.5f // Maximum banded DTW distance of the resampled rate derivatives per warping step, in dps per sample
+#define ZNORM_DTW_THRESHOLD 0.4f      // Maximum banded DTW distance of the z-normalized resampled rates per warping step
+#define RATE_DTW_BAND 6               // Sakoe-Chiba band half-width in resampled samples (10% of RESAMPLE_LENGTH)
+#define ZNORM_DEVIATION_FLOOR 5.0f    // Smallest deviation an axis is scaled by, in dps, about the sensor noise
+
+// Running sums for a streaming Pearson correlation
+typedef struct
+{
+    float sum_a;    // Sum of elements of a
+    float sum_b;    // Sum of elements of b
+    float sum_ab;   // Sum of element-wise products
+    float sq_sum_a; // Sum of squares of a
+    float sq_sum_b; // Sum of squares of b
+    size_t n;       // Number of pairs
+} Correlation_Sums;
+
+// Calculate Euclidean distance between two 3D vectors
+float euclidean_distance(const std::array<float, 3> &a, const std::array<float, 3> &b);
+
+// Calculate Dynamic Time Warping distance between two gesture sequences, using arena scratch; dtw_with<L2Cost>
+float dtw(const Gesture_Trace &s, const Gesture_Trace &t, BumpArena &scratch);
+
+// Calculate DTW distance restricted to a band around the diagonal, using arena scratch
+float dtw_banded(const Gesture_Trace &s, const Gesture_Trace &t, size_t band, BumpArena &scratch);
+
+// Calculate banded DTW distance of the first derivatives of two gesture sequences, using arena scratch
+float dtw_derivative(const Gesture_Trace &s, const Gesture_Trace &t, size_t band, BumpArena &scratch);
+
+// Calculate banded DTW distance of two gesture sequences z-normalized per axis with the moments in their embeddings
+float dtw_znormalized(const Gesture_Trace &s, const Gesture_Features &s_features, const Gesture_Trace &t,
+                      const Gesture_Features &t_features, size_t band, BumpArena &scratch);
+
+// Add one pair to a streaming correlation
+void correlation_accumulate(Correlation_Sums &sums, float a, float b);
+
+// Calculate Pearson correlation from running sums
+float correlation_finish(const Correlation_Sums &sums);
+
+// Calculate correlation for each axis between two gesture sequences
+std::array<float, 3> calculateCorrelationVectors(const Gesture_Trace &vec1, const Gesture_Trace &vec2);
+
+#endif
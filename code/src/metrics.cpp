@@ -0,0 +1,190 @@
+#include <stdio.h>                               // Include printf
+#include "metrics.h"                             // Include the metrics header
+
+static Metric *metrics_head;                     // First registered metric, zero-initialized before any constructor runs
+static Metric *metrics_tail;                     // Last registered metric
+
+/*******************************************************************************
+ * Function: Metric::Metric
+ * -----------------------------------------------------------------------------
+ * Appends the metric to the registry, so metrics are listed in the order
+ * their definitions are initialized.
+ *
+ * Parameters:
+ *  - metric_name: Dotted name with static storage.
+ *  - metric_unit: Unit with static storage, "" for plain counts.
+ *  - metric_type: Kind of metric.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+Metric::Metric(const char *metric_name, const char *metric_unit, Metric_Type metric_type)
+    : label(metric_name), units(metric_unit), kind(metric_type), link(nullptr)
+{
+    if (metrics_tail == nullptr)
+    {
+        metrics_head = this;
+    }
+    else
+    {
+        metrics_tail->link = this;
+    }
+    metrics_tail = this;
+}
+
+const Metric *Metric::first()
+{
+    return metrics_head;
+}
+
+Histogram::Histogram(const char *metric_name, const char *metric_unit)
+    : Metric(metric_name, metric_unit, METRIC_HISTOGRAM), samples(0), largest(0)
+{
+    for (int b = 0; b < METRIC_BUCKETS; b++)
+    {
+        buckets[b].store(0, std::memory_order_relaxed);
+    }
+}
+
+/*******************************************************************************
+ * Function: Histogram::record
+ * -----------------------------------------------------------------------------
+ * Adds one value. The bucket index is the bit length of the value, a single
+ * CLZ on the M4.
+ *
+ * Parameters:
+ *  - value: Value to record.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void Histogram::record(uint32_t value)
+{
+    uint32_t b = value ? 32 - __builtin_clz(value) : 0;
+    buckets[b < METRIC_BUCKETS ? b : METRIC_BUCKETS - 1].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t seen = largest.load(std::memory_order_relaxed);
+    while (value > seen && !largest.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+        // seen was reloaded, retry while value is still larger
+    }
+}
+
+/*******************************************************************************
+ * Function: Histogram::percentile
+ * -----------------------------------------------------------------------------
+ * Finds the bucket holding the given percentile.
+ *
+ * Parameters:
+ *  - percent: Percentile between 0 and 100.
+ *
+ * Returns:
+ *  - Upper edge of that bucket, capped at the largest recorded value; 0 if
+ *    nothing was recorded.
+ ******************************************************************************/
+uint32_t Histogram::percentile(uint32_t percent) const
+{
+    uint32_t total = count();
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(((uint64_t)total * percent + 99) / 100); // Samples at or below the percentile
+    uint32_t seen = 0;
+    for (int b = 0; b < METRIC_BUCKETS - 1; b++)
+    {
+        seen += bucket(b);
+        if (seen >= rank)
+        {
+            uint32_t edge = b ? (1UL << b) - 1 : 0;  // Largest value the bucket holds
+            return edge < max() ? edge : max();
+        }
+    }
+    return max();
+}
+
+/*******************************************************************************
+ * Function: metric_format
+ * -----------------------------------------------------------------------------
+ * Formats a metric for the console or the diagnostics screen. Histograms show
+ * count, median, 99th percentile and maximum.
+ *
+ * Parameters:
+ *  - metric: Metric to format.
+ *  - out: Output buffer, always terminated.
+ *  - size: Size of out in bytes.
+ *
+ * Returns:
+ *  - Length of the line, or the length it would have had if out is too short.
+ ******************************************************************************/
+size_t metric_format(const Metric &metric, char *out, size_t size)
+{
+    const char *space = metric.unit()[0] != '\0' ? " " : ""; // Separate the unit from the value
+    int length = 0;
+    switch (metric.type())
+    {
+    case METRIC_COUNTER:
+        length = snprintf(out, size, "%s %lu%s%s", metric.name(),
+                          (unsigned long)static_cast<const Counter &>(metric).value(), space, metric.unit());
+        break;
+
+    case METRIC_GAUGE:
+        length = snprintf(out, size, "%s %lu%s%s", metric.name(),
+                          (unsigned long)static_cast<const Gauge &>(metric).value(), space, metric.unit());
+        break;
+
+    case METRIC_HISTOGRAM:
+    {
+        const Histogram &histogram = static_cast<const Histogram &>(metric);
+        length = snprintf(out, size, "%s n=%lu p50<=%lu p99<=%lu max=%lu%s%s", metric.name(),
+                          (unsigned long)histogram.count(), (unsigned long)histogram.percentile(50),
+                          (unsigned long)histogram.percentile(99), (unsigned long)histogram.max(), space, metric.unit());
+        break;
+    }
+    }
+    return length > 0 ? (size_t)length : 0;
+}
+
+/*******************************************************************************
+ * Function: metrics_dump
+ * -----------------------------------------------------------------------------
+ * Prints every registered metric, followed by the non-empty buckets of each
+ * histogram.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void metrics_dump()
+{
+    char line[96];
+    printf("Metrics:\r\n");
+    for (const Metric *metric = Metric::first(); metric != nullptr; metric = metric->next())
+    {
+        metric_format(*metric, line, sizeof(line));
+        printf("  %s\r\n", line);
+        if (metric->type() != METRIC_HISTOGRAM)
+        {
+            continue;
+        }
+        const Histogram *histogram = static_cast<const Histogram *>(metric);
+        for (int b = 0; b < METRIC_BUCKETS; b++)
+        {
+            if (histogram->bucket(b) == 0)
+            {
+                continue;
+            }
+            if (b + 1 < METRIC_BUCKETS)
+            {
+                printf("    < %-10lu %lu\r\n", 1UL << b, (unsigned long)histogram->bucket(b));
+            }
+            else
+            {
+                printf("    >= %-9lu %lu\r\n", 1UL << (b - 1), (unsigned long)histogram->bucket(b));
+            }
+        }
+    }
+}
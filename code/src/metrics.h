@@ -0,0 +1,124 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/*******************************************************************************
+ * Runtime metrics registry
+ *
+ * Counters, gauges and latency histograms that stay enabled in production.
+ * Every metric is a global object that links itself into the registry from
+ * its constructor, so the set of metrics is fixed at link time and the
+ * registry costs no memory beyond the metrics themselves. Updates are relaxed
+ * atomic operations (LDREX/STREX on the M4), safe from any thread or ISR, and
+ * readers may observe a histogram mid-update, which only skews one sample.
+ *
+ * Metrics must have static storage duration; registration is not thread safe
+ * and happens before main().
+ ******************************************************************************/
+
+// Histogram buckets; bucket b counts values in [2^(b-1), 2^b), the last one everything larger
+#define METRIC_BUCKETS 20
+
+// Kinds of metric
+typedef enum
+{
+    METRIC_COUNTER,                // Monotonic event count
+    METRIC_GAUGE,                  // Last sampled level
+    METRIC_HISTOGRAM               // Distribution of a latency
+} Metric_Type;
+
+/*******************************************************************************
+ * Class: Metric
+ * -----------------------------------------------------------------------------
+ * Registry entry shared by all metric kinds.
+ ******************************************************************************/
+class Metric
+{
+public:
+    Metric(const char *metric_name, const char *metric_unit, Metric_Type metric_type);
+
+    Metric(const Metric &) = delete;
+    Metric &operator=(const Metric &) = delete;
+
+    const char *name() const { return label; }                // Dotted name, e.g. "unlock.success"
+    const char *unit() const { return units; }                // Unit of the value, "" for plain counts
+    Metric_Type type() const { return kind; }                 // Kind of metric
+    const Metric *next() const { return link; }               // Next registered metric
+
+    static const Metric *first();                              // First registered metric
+
+private:
+    const char *label;             // Metric name
+    const char *units;             // Unit of the value
+    Metric_Type kind;              // Metric kind
+    Metric *link;                  // Next metric in registration order
+};
+
+/*******************************************************************************
+ * Class: Counter
+ * -----------------------------------------------------------------------------
+ * Event count that only grows.
+ ******************************************************************************/
+class Counter : public Metric
+{
+public:
+    Counter(const char *metric_name, const char *metric_unit = "") : Metric(metric_name, metric_unit, METRIC_COUNTER), count(0) {}
+
+    void add(uint32_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t value() const { return count.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> count;   // Events so far
+};
+
+/*******************************************************************************
+ * Class: Gauge
+ * -----------------------------------------------------------------------------
+ * Sampled level such as memory in use; set by whoever measures it.
+ ******************************************************************************/
+class Gauge : public Metric
+{
+public:
+    Gauge(const char *metric_name, const char *metric_unit = "") : Metric(metric_name, metric_unit, METRIC_GAUGE), level(0) {}
+
+    void set(uint32_t value) { level.store(value, std::memory_order_relaxed); }
+    uint32_t value() const { return level.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> level;   // Last sampled value
+};
+
+/*******************************************************************************
+ * Class: Histogram
+ * -----------------------------------------------------------------------------
+ * Distribution of a latency in power-of-two buckets, plus count and maximum.
+ * Percentiles are reported as the upper edge of the bucket they fall in, so
+ * they are accurate to a factor of two.
+ ******************************************************************************/
+class Histogram : public Metric
+{
+public:
+    Histogram(const char *metric_name, const char *metric_unit = "us");
+
+    void record(uint32_t value);
+    uint32_t count() const { return samples.load(std::memory_order_relaxed); }
+    uint32_t max() const { return largest.load(std::memory_order_relaxed); }
+    uint32_t bucket(int b) const { return buckets[b].load(std::memory_order_relaxed); }
+    uint32_t percentile(uint32_t percent) const;
+
+private:
+    std::atomic<uint32_t> samples;                 // Recorded values
+    std::atomic<uint32_t> largest;                 // Largest recorded value
+    std::atomic<uint32_t> buckets[METRIC_BUCKETS]; // Power-of-two histogram
+};
+
+// Format one metric as "name value" on a single line, returns its length
+size_t metric_format(const Metric &metric, char *out, size_t size);
+
+// Print every metric, histograms with their non-empty buckets
+void metrics_dump();
+
+#endif
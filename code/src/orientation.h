@@ -0,0 +1,31 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include <stdint.h>
+#include "gesture_trace.h"
+
+// Convert constants
+#define ORIENTATION_DEG_TO_RAD 0.017453293f // rad = degree * (pi / 180)
+
+// Unit quaternion, rotation from the sensor frame at reset to the current one
+typedef struct
+{
+    float w;                       // Scalar part
+    float x;                       // Vector part
+    float y;
+    float z;
+} Quaternion;
+
+// Approximate 1 / sqrt(x) with the bit-level estimate and two Newton steps
+float fast_inv_sqrt(float x);
+
+// Return to the identity rotation
+void orientation_reset(Quaternion &q);
+
+// Integrate one sample of body rates in rad/s over dt seconds
+void orientation_update(Quaternion &q, float gx, float gy, float gz, float dt);
+
+// Rotation from origin to q as a rotation vector in radians
+void orientation_relative(const Quaternion &origin, const Quaternion &q, Gesture_Sample &rotation);
+
+#endif
@@ -0,0 +1,112 @@
+#include <stdio.h>                               // Include printf
+#include <string.h>                              // Include memset
+#include "profiler.h"                            // Include the profiler header
+
+#if !defined(__MBED__)
+#include <chrono>                                // Include the host clock
+#endif
+
+Profile_Stats profile_stats[PROBE_COUNT];        // Per-probe timings
+
+// Probe names for the dump, in Profile_Probe order
+static const char *const probe_names[PROBE_COUNT] = {
+    "capture", "calibration", "filter", "segment", "finalize",
+    "features", "correlation", "dtw", "rate_dtw", "derivative_dtw", "znorm_dtw", "flash", "lcd",
+};
+
+#if !defined(__MBED__)
+uint32_t profiler_cycles()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+/*******************************************************************************
+ * Function: profiler_init
+ * -----------------------------------------------------------------------------
+ * Starts the DWT cycle counter on the target and clears every probe. Call once
+ * at boot before any probe runs.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void profiler_init()
+{
+#if defined(__MBED__)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;  // Power the trace block
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;             // Start counting cycles
+#endif
+    profiler_reset();
+}
+
+/*******************************************************************************
+ * Function: profiler_reset
+ * -----------------------------------------------------------------------------
+ * Clears every probe. A probe running concurrently may lose one sample.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void profiler_reset()
+{
+    memset(profile_stats, 0, sizeof(profile_stats));
+    for (int i = 0; i < PROBE_COUNT; i++)
+    {
+        profile_stats[i].min = UINT32_MAX;           // So the first sample becomes the minimum
+    }
+}
+
+/*******************************************************************************
+ * Function: profiler_dump
+ * -----------------------------------------------------------------------------
+ * Prints count, min, mean and max of every probe that ran, followed by its
+ * non-empty histogram buckets. Units are cycles on the target and nanoseconds
+ * on the host.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void profiler_dump()
+{
+#if defined(__MBED__)
+    printf("Profile (cycles at %lu Hz):\r\n", (unsigned long)SystemCoreClock);
+#else
+    printf("Profile (ns):\r\n");
+#endif
+    for (int i = 0; i < PROBE_COUNT; i++)
+    {
+        Profile_Stats stats = profile_stats[i];      // Snapshot, the owner may still be recording
+        if (stats.count == 0)
+        {
+            continue;
+        }
+        printf("  %-14s n=%lu min=%lu mean=%lu max=%lu\r\n", probe_names[i], (unsigned long)stats.count,
+               (unsigned long)stats.min, (unsigned long)(stats.total / stats.count), (unsigned long)stats.max);
+        for (int b = 0; b < PROFILER_BUCKETS; b++)
+        {
+            if (stats.buckets[b] == 0)
+            {
+                continue;
+            }
+            if (b + 1 < PROFILER_BUCKETS)
+            {
+                printf("    < %-10lu %lu\r\n", 1UL << b, (unsigned long)stats.buckets[b]);
+            }
+            else
+            {
+                printf("    >= %-9lu %lu\r\n", 1UL << (b - 1), (unsigned long)stats.buckets[b]);
+            }
+        }
+    }
+}
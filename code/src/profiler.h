@@ -0,0 +1,114 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * Cycle profiler
+ *
+ * Scoped probes time a block with the Cortex-M DWT cycle counter (a
+ * std::chrono clock on host builds, counting nanoseconds) and fold the result
+ * into a per-probe histogram with power-of-two buckets. Recording is a clz and
+ * a handful of increments, so a probe costs well under 20 cycles on the M4 and
+ * can sit in the per-sample path. Each probe is recorded from one thread only,
+ * so the counters need no locking.
+ *
+ * Define PROFILER_ENABLED to 0 to compile every probe out.
+ ******************************************************************************/
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Histogram buckets; bucket b counts durations in [2^(b-1), 2^b), the last one everything longer
+#define PROFILER_BUCKETS 24
+
+// Instrumented stages
+typedef enum
+{
+    PROBE_CAPTURE,                 // One DRDY sample through the capture thread
+    PROBE_CALIBRATION,             // Gyroscope initialization and calibration
+    PROBE_FILTER,                  // Capture filter chain and decimator, all axes
+    PROBE_SEGMENT,                 // Segmenter update (start and end trimming)
+    PROBE_FINALIZE,                // Resampling and feature extraction of a capture
+    PROBE_FEATURES,                // Embedding comparison
+    PROBE_CORRELATION,             // Resampled correlation
+    PROBE_DTW,                     // DTW on the rotation paths
+    PROBE_RATE_DTW,                // Banded DTW on the resampled rates
+    PROBE_DERIVATIVE_DTW,          // Banded DTW on the derivatives of the resampled rates
+    PROBE_ZNORM_DTW,               // Banded DTW on the z-normalized resampled rates
+    PROBE_FLASH,                   // Flash program or read
+    PROBE_LCD,                     // One LCD update
+    PROBE_COUNT
+} Profile_Probe;
+
+// Aggregated timings of one probe
+typedef struct
+{
+    uint32_t count;                // Recorded durations
+    uint32_t min;                  // Shortest duration
+    uint32_t max;                  // Longest duration
+    uint64_t total;                // Sum of durations
+    uint32_t buckets[PROFILER_BUCKETS]; // Power-of-two histogram
+} Profile_Stats;
+
+extern Profile_Stats profile_stats[PROBE_COUNT];
+
+#if defined(__MBED__)
+#include "cmsis.h"
+
+// Current value of the free-running cycle counter
+static inline uint32_t profiler_cycles()
+{
+    return DWT->CYCCNT;
+}
+#else
+// Current value of the host clock in nanoseconds, truncated like the cycle counter
+uint32_t profiler_cycles();
+#endif
+
+// Enable the cycle counter and clear all probes
+void profiler_init();
+
+// Clear all probes
+void profiler_reset();
+
+// Print every probe that recorded something
+void profiler_dump();
+
+// Fold one duration into a probe
+static inline void profiler_record(Profile_Probe probe, uint32_t cycles)
+{
+    Profile_Stats &stats = profile_stats[probe];
+    uint32_t bucket = cycles ? 32 - __builtin_clz(cycles) : 0; // Bit length, a single CLZ on the M4
+    stats.buckets[bucket < PROFILER_BUCKETS ? bucket : PROFILER_BUCKETS - 1]++;
+    stats.count++;
+    stats.total += cycles;
+    stats.min = cycles < stats.min ? cycles : stats.min;
+    stats.max = cycles > stats.max ? cycles : stats.max;
+}
+
+/*******************************************************************************
+ * Class: ProfileScope
+ * -----------------------------------------------------------------------------
+ * Records the time between its construction and the end of the scope.
+ ******************************************************************************/
+class ProfileScope
+{
+public:
+    explicit ProfileScope(Profile_Probe probe_id) : probe(probe_id), start(profiler_cycles()) {}
+    ~ProfileScope() { profiler_record(probe, profiler_cycles() - start); }
+
+private:
+    Profile_Probe probe;           // Probe to record into
+    uint32_t start;                // Counter value at construction
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(probe) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(probe)
+#else
+#define PROFILE_SCOPE(probe) do {} while (0)
+#endif
+
+#endif
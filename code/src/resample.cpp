@@ -0,0 +1,59 @@
+#include "resample.h"                            // Include the resampling header
+
+/*******************************************************************************
+ * Function: resample_linear
+ * -----------------------------------------------------------------------------
+ * Stretches or squeezes a trace to a fixed number of samples with linear
+ * interpolation, so two performances of the same gesture at different speeds
+ * line up sample for sample. The first and last samples are kept exactly.
+ * Runs in O(length) with one multiply-add per axis and output sample.
+ *
+ * Parameters:
+ *  - src: Trace to resample.
+ *  - dst: Trace receiving the result; truncated to its capacity.
+ *  - length: Number of output samples.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void resample_linear(const Gesture_Trace &src, Gesture_Trace &dst, size_t length)
+{
+    if (length > dst.capacity)
+    {
+        length = dst.capacity;                       // Never overrun the destination
+    }
+    if (src.size == 0 || length == 0)
+    {
+        dst.size = 0;                                // Nothing to interpolate
+        return;
+    }
+    if (src.size == 1 || length == 1)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            dst.samples[i] = src.samples[0];         // A single sample stretches to a constant
+        }
+        dst.size = length;
+        return;
+    }
+
+    float step = (float)(src.size - 1) / (float)(length - 1); // Source samples per output sample
+    float position = 0.0f;                           // Position in the source trace
+    for (size_t i = 0; i < length - 1; i++, position += step)
+    {
+        size_t k = (size_t)position;                 // Left neighbour
+        if (k > src.size - 2)
+        {
+            k = src.size - 2;                        // Rounding drift near the end
+        }
+        float t = position - (float)k;               // Distance from the left neighbour
+        const Gesture_Sample &a = src.samples[k];
+        const Gesture_Sample &b = src.samples[k + 1];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            dst.samples[i][axis] = a[axis] + t * (b[axis] - a[axis]);
+        }
+    }
+    dst.samples[length - 1] = src.samples[src.size - 1]; // Pin the end exactly
+    dst.size = length;
+}
@@ -0,0 +1,13 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stddef.h>
+#include "gesture_trace.h"
+
+// Length every trace is resampled to before correlation
+#define RESAMPLE_LENGTH 64
+
+// Resample src to exactly length samples into dst by linear interpolation
+void resample_linear(const Gesture_Trace &src, Gesture_Trace &dst, size_t length);
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+ * Function: sample_ring_size
+ * -----------------------------------------------------------------------------
+ * Rounds a depth up to the next power of two, for sizing a SampleRing from a
+ * duration at compile time.
+ ******************************************************************************/
+constexpr uint32_t sample_ring_size(uint32_t depth, uint32_t size = 1)
+{
+    return size >= depth ? size : sample_ring_size(depth, size * 2);
+}
+
+/*******************************************************************************
+ * Struct: RingView
+ * -----------------------------------------------------------------------------
+ * A run of ring entries in order, without copying them out. A run that wraps
+ * past the end of the storage is two pieces: first from the oldest entry to
+ * the end, second from the start of the storage. The view is valid until the
+ * ring's owner pushes again.
+ ******************************************************************************/
+template <typename T>
+struct RingView
+{
+    const T *first;                    // Oldest entries, up to the end of the storage
+    uint32_t first_size;               // Entries in first
+    const T *second;                   // Wrapped entries from the start of the storage
+    uint32_t second_size;              // Entries in second
+
+    uint32_t size() const
+    {
+        return first_size + second_size;
+    }
+
+    // Entry i of the run, oldest first
+    const T &operator[](uint32_t i) const
+    {
+        return i < first_size ? first[i] : second[i - first_size];
+    }
+};
+
+/*******************************************************************************
+ * Class: SampleRing
+ * -----------------------------------------------------------------------------
+ * Fixed-size history that always keeps the latest N entries, overwriting the
+ * oldest. Every entry gets a sequence number, so a reader can remember how far
+ * it got and ask for everything pushed since, as long as it stays within N
+ * entries of the writer. Owned by a single thread.
+ *
+ * Template parameters:
+ *  - T: Element type.
+ *  - N: Capacity in elements, must be a power of two.
+ ******************************************************************************/
+template <typename T, uint32_t N>
+class SampleRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleRing capacity must be a power of two");
+
+public:
+    SampleRing() : written(0), held(0) {}
+
+    // Append an entry, dropping the oldest one if the ring is full
+    void push(const T &item)
+    {
+        buffer[written & (N - 1)] = item;
+        written++;
+        if (held < N)
+        {
+            held++;
+        }
+    }
+
+    // Forget every entry; sequence numbers keep counting
+    void clear()
+    {
+        held = 0;
+    }
+
+    // Number of entries held
+    uint32_t size() const
+    {
+        return held;
+    }
+
+    // Sequence number of the oldest entry held
+    uint32_t begin() const
+    {
+        return written - held;
+    }
+
+    // Sequence number the next pushed entry will get
+    uint32_t end() const
+    {
+        return written;
+    }
+
+    // The latest count entries, oldest first
+    RingView<T> latest(uint32_t count) const
+    {
+        return since(written - (count < held ? count : held));
+    }
+
+    // Entries from sequence number seq to the newest; entries already overwritten are skipped
+    RingView<T> since(uint32_t seq) const
+    {
+        if ((int32_t)(seq - begin()) < 0)
+        {
+            seq = begin();
+        }
+        uint32_t count = written - seq;                                // Entries in the run
+        uint32_t start = seq & (N - 1);                                // Storage index of the oldest one
+        uint32_t first_size = count < N - start ? count : N - start;   // Part before the wrap
+        RingView<T> view = {&buffer[start], first_size, &buffer[0], count - first_size};
+        return view;
+    }
+
+    static constexpr uint32_t capacity()
+    {
+        return N;
+    }
+
+private:
+    T buffer[N];                       // Element storage
+    uint32_t written;                  // Entries pushed so far, the next sequence number
+    uint32_t held;                     // Entries held, at most N
+};
+
+#endif
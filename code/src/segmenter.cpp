@@ -0,0 +1,156 @@
+#include "segmenter.h"                           // Include the segmenter header
+
+/*******************************************************************************
+ * Function: segmenter_default_config
+ * -----------------------------------------------------------------------------
+ * Returns the default segmentation parameters for a SEGMENT_RATE_HZ stream.
+ *
+ * Parameters:
+ *  - None
+ *
+ * Returns:
+ *  - Default Segmenter_Config.
+ ******************************************************************************/
+Segmenter_Config segmenter_default_config()
+{
+    Segmenter_Config config;
+    config.on_ratio = SEGMENT_ON_RATIO;              // Start threshold over the noise floor
+    config.off_ratio = SEGMENT_OFF_RATIO;            // End threshold over the noise floor
+    config.min_on = SEGMENT_MIN_ON;                  // Lowest start threshold
+    config.min_off = SEGMENT_MIN_OFF;                // Lowest end threshold
+    config.start_hold = SEGMENT_START_HOLD;          // Debounce for the start
+    config.end_hold = SEGMENT_END_HOLD;              // Debounce for the end
+    config.max_length = GESTURE_MAX_SAMPLES * (SEGMENT_RATE_HZ / GESTURE_RATE_HZ); // A segment never outgrows a trace
+    return config;
+}
+
+/*******************************************************************************
+ * Function: segmenter_init
+ * -----------------------------------------------------------------------------
+ * Initializes a segmenter. The noise floor starts at zero, so the minimum
+ * thresholds apply until idle samples have been seen.
+ *
+ * Parameters:
+ *  - segmenter: Segmenter to initialize.
+ *  - config: Segmentation parameters.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void segmenter_init(Segmenter &segmenter, const Segmenter_Config &config)
+{
+    segmenter.config = config;                       // Store the parameters
+    segmenter.noise_floor = 0.0f;                    // Nothing learned yet
+    segmenter_reset(segmenter);
+}
+
+/*******************************************************************************
+ * Function: segmenter_reset
+ * -----------------------------------------------------------------------------
+ * Prepares a segmenter for a new recording. The noise floor is kept, since
+ * the sensor noise does not change between gestures.
+ *
+ * Parameters:
+ *  - segmenter: Segmenter to reset.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void segmenter_reset(Segmenter &segmenter)
+{
+    for (uint32_t i = 0; i < SEGMENT_WINDOW; i++)
+    {
+        segmenter.window[i] = 0.0f;                  // Empty the energy window
+    }
+    segmenter.index = 0;
+    segmenter.filled = 0;
+    segmenter.sum = 0.0f;
+    segmenter.energy = 0.0f;
+    segmenter.active = false;                        // Wait for the next onset
+    segmenter.run = 0;
+    segmenter.length = 0;
+}
+
+/*******************************************************************************
+ * Function: segmenter_update
+ * -----------------------------------------------------------------------------
+ * Updates the short-window energy with one sample and applies the hysteresis:
+ * a segment opens after start_hold samples above the start threshold and
+ * closes after end_hold samples below the lower end threshold, or when it
+ * reaches max_length. While idle the noise floor tracks the window energy.
+ *
+ * Parameters:
+ *  - segmenter: Segmenter to update.
+ *  - sample: Sample in degrees per second.
+ *
+ * Returns:
+ *  - SEGMENT_START, SEGMENT_END or SEGMENT_NONE.
+ ******************************************************************************/
+Segment_Event segmenter_update(Segmenter &segmenter, const Gesture_Sample &sample)
+{
+    const Segmenter_Config &config = segmenter.config;
+
+    // Slide the energy window by one sample
+    float e = sample[0] * sample[0] + sample[1] * sample[1] + sample[2] * sample[2];
+    segmenter.sum += e - segmenter.window[segmenter.index];
+    segmenter.window[segmenter.index] = e;
+    segmenter.index = (segmenter.index + 1) % SEGMENT_WINDOW;
+    if (segmenter.filled < SEGMENT_WINDOW)
+    {
+        segmenter.filled++;
+    }
+    segmenter.energy = segmenter.sum / segmenter.filled;
+
+    float on = segmenter.noise_floor * config.on_ratio;  // Start threshold
+    on = on > config.min_on ? on : config.min_on;
+
+    if (!segmenter.active)
+    {
+        if (segmenter.energy > on)
+        {
+            if (++segmenter.run >= config.start_hold)
+            {
+                segmenter.active = true;             // Onset confirmed
+                segmenter.run = 0;
+                segmenter.length = 1;
+                return SEGMENT_START;
+            }
+        }
+        else
+        {
+            segmenter.run = 0;
+            // Learn the noise floor from idle samples only
+            segmenter.noise_floor += (segmenter.energy - segmenter.noise_floor) / (1 << SEGMENT_FLOOR_SHIFT);
+        }
+        return SEGMENT_NONE;
+    }
+
+    segmenter.length++;
+    segmenter.run = segmenter_moving(segmenter) ? 0 : segmenter.run + 1;
+    if (segmenter.run >= config.end_hold ||
+        (config.max_length != 0 && segmenter.length >= config.max_length))
+    {
+        segmenter.active = false;                    // Stillness confirmed or segment full
+        segmenter.run = 0;
+        return SEGMENT_END;
+    }
+    return SEGMENT_NONE;
+}
+
+/*******************************************************************************
+ * Function: segmenter_moving
+ * -----------------------------------------------------------------------------
+ * Tells whether the last sample is above the end threshold.
+ *
+ * Parameters:
+ *  - segmenter: Segmenter to query.
+ *
+ * Returns:
+ *  - true if the short-window energy is above the end threshold.
+ ******************************************************************************/
+bool segmenter_moving(const Segmenter &segmenter)
+{
+    float off = segmenter.noise_floor * segmenter.config.off_ratio; // End threshold
+    off = off > segmenter.config.min_off ? off : segmenter.config.min_off;
+    return segmenter.energy > off;
+}
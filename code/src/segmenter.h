@@ -0,0 +1,74 @@
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include <stdint.h>
+#include "gesture_trace.h"
+
+// Rate the segmenter runs at, above GESTURE_RATE_HZ for finer boundaries
+#define SEGMENT_RATE_HZ 100
+
+// Short-window length for the energy estimate, in samples (200 ms)
+#define SEGMENT_WINDOW (SEGMENT_RATE_HZ / 5)
+
+// Default segmentation parameters
+#define SEGMENT_ON_RATIO 8.0f      // Start when energy exceeds 8x the noise floor...
+#define SEGMENT_OFF_RATIO 4.0f     // ...and end when it falls below 4x the noise floor
+#define SEGMENT_MIN_ON 9.0f        // Start threshold never drops below 3 dps RMS
+#define SEGMENT_MIN_OFF 4.0f       // End threshold never drops below 2 dps RMS
+#define SEGMENT_START_HOLD (SEGMENT_RATE_HZ / 10) // Samples above the start threshold to open a segment (100 ms)
+#define SEGMENT_END_HOLD (SEGMENT_RATE_HZ / 2)    // Samples below the end threshold to close it (500 ms)
+#define SEGMENT_FLOOR_SHIFT 6      // Noise floor follows idle energy with weight 1/64 (about 0.6 s)
+
+static_assert(SEGMENT_RATE_HZ % GESTURE_RATE_HZ == 0, "Segment rate must be a multiple of the gesture rate");
+
+// Segmenter output for one sample
+typedef enum
+{
+    SEGMENT_NONE,                  // No boundary at this sample
+    SEGMENT_START,                 // Motion onset, this sample opens the segment
+    SEGMENT_END                    // Stillness confirmed or maximum length reached
+} Segment_Event;
+
+// Segmentation parameters
+typedef struct
+{
+    float on_ratio;                // Start threshold as a multiple of the noise floor
+    float off_ratio;               // End threshold as a multiple of the noise floor
+    float min_on;                  // Lowest start threshold, in dps^2
+    float min_off;                 // Lowest end threshold, in dps^2
+    uint16_t start_hold;           // Samples above the start threshold to open a segment
+    uint16_t end_hold;             // Samples below the end threshold to close a segment
+    uint16_t max_length;           // Longest segment in samples, 0 for unlimited
+} Segmenter_Config;
+
+// Streaming segmenter state
+typedef struct
+{
+    Segmenter_Config config;       // Parameters
+    float window[SEGMENT_WINDOW];  // Energy of the last SEGMENT_WINDOW samples
+    uint32_t index;                // Slot of the oldest window entry
+    uint32_t filled;               // Valid window entries
+    float sum;                     // Sum of the window
+    float energy;                  // Short-window mean energy of the last sample, in dps^2
+    float noise_floor;             // Idle energy estimate, in dps^2
+    bool active;                   // True inside a segment
+    uint16_t run;                  // Consecutive samples past the pending threshold
+    uint32_t length;               // Samples in the current segment
+} Segmenter;
+
+// Default parameters
+Segmenter_Config segmenter_default_config();
+
+// Initialize a segmenter with an empty noise floor
+void segmenter_init(Segmenter &segmenter, const Segmenter_Config &config);
+
+// Start a new recording, keeping the learned noise floor
+void segmenter_reset(Segmenter &segmenter);
+
+// Feed one sample and report a segment boundary
+Segment_Event segmenter_update(Segmenter &segmenter, const Gesture_Sample &sample);
+
+// True if the last sample is above the end threshold
+bool segmenter_moving(const Segmenter &segmenter);
+
+#endif
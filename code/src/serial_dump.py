@@ -1,22 +1,225 @@
-import serial
+"""Decode the binary telemetry stream into one CSV file per record type.
 
-# Replace 'COMx' with the appropriate serial port name for your system
-ser = serial.Serial('COM4', 9600)
-data = []
+Frames are COBS-encoded and 0x00-delimited; see telemetry.h for the layout.
+Reads either a serial port or a file captured earlier with --save.
 
-while True:
-    line = ser.readline().decode('utf-8').strip()
-    if line:
-        values = [float(x) for x in line.split(',')]
-        data.append(values)
+    python serial_dump.py --port COM4 --seconds 10 --output capture
+    python serial_dump.py --input capture.bin --output capture
+    python serial_dump.py --port COM4 --corpus corpus.gcr --label 3
 
-    # Exit the loop after receiving the desired number of data points
-    if len(data) >= NUMBER_OF_DATA_POINTS:
-        break
+With --corpus every complete capture is also appended to a binary corpus for
+the host tools (host/pairs), tagged with --label (e.g. one label per person
+and gesture). Layout, little-endian: "GCRP" version:u16 reserved:u16, then per
+capture label:u16 count:u16 and count samples of x y z path_x path_y path_z
+as f32.
 
-ser.close()
+Press 't' on the firmware console to start and stop the stream.
+"""
 
-# Save the data to a file
-with open('output.txt', 'w') as f:
-    for entry in data:
-        f.write("{}, {}, {}\n".format(entry[0], entry[1], entry[2]))
+import argparse
+import binascii
+import csv
+import os
+import struct
+import sys
+import time
+
+PROFILER_BUCKETS = 24
+PROBE_NAMES = ["capture", "calibration", "filter", "segment", "finalize",
+               "features", "correlation", "dtw", "rate_dtw", "derivative_dtw", "znorm_dtw", "flash", "lcd"]
+MATCHER_NAMES = ["features", "correlation", "rate_dtw", "derivative_dtw", "znorm_dtw", "path_dtw"]
+MATCHERS = len(MATCHER_NAMES)
+
+# Record type -> (file name, struct format, column names)
+RECORDS = {
+    0: ("info", "<IfHH", ["odr_hz", "dps_per_digit", "segment_rate_hz", "gesture_rate_hz"]),
+    1: ("raw", "<Ihhh", ["timestamp_us", "x", "y", "z"]),
+    2: ("filtered", "<Ihhh", ["timestamp_us", "x", "y", "z"]),
+    4: ("profile", "<BIIII%dI" % PROFILER_BUCKETS,
+        ["probe", "count", "min", "mean", "max"] + ["bucket_%d" % b for b in range(PROFILER_BUCKETS)]),
+    5: ("ensemble", "<I%df%df%dIfBB" % (MATCHERS, MATCHERS, MATCHERS),
+        ["timestamp_us"] + ["score_%s" % m for m in MATCHER_NAMES] + ["term_%s" % m for m in MATCHER_NAMES] +
+        ["cycles_%s" % m for m in MATCHER_NAMES] + ["probability", "run", "flags"]),
+    6: ("gesture", "<IHH6f", ["timestamp_us", "index", "count", "x", "y", "z", "path_x", "path_y", "path_z"]),
+}
+
+CORPUS_MAGIC = b"GCRP"
+CORPUS_VERSION = 1
+
+
+class Corpus:
+    """Reassembles TELEMETRY_GESTURE records into captures and appends them to a corpus file."""
+
+    def __init__(self, path, label):
+        exists = os.path.exists(path) and os.path.getsize(path) > 0
+        if exists:
+            with open(path, "rb") as f:
+                magic, version, _ = struct.unpack("<4sHH", f.read(8))
+            if magic != CORPUS_MAGIC or version != CORPUS_VERSION:
+                raise SystemExit("%s is not a version %d corpus" % (path, CORPUS_VERSION))
+        self.file = open(path, "ab")
+        if not exists:
+            self.file.write(struct.pack("<4sHH", CORPUS_MAGIC, CORPUS_VERSION, 0))
+        self.label = label
+        self.timestamp = None
+        self.samples = []
+        self.captures = 0
+
+    def add(self, timestamp, index, count, sample):
+        if timestamp != self.timestamp or index != len(self.samples):
+            self.timestamp = timestamp                   # New capture, or a record of this one was lost
+            self.samples = []
+            if index != 0:
+                return
+        self.samples.append(sample)
+        if len(self.samples) == count:
+            self.file.write(struct.pack("<HH", self.label, count))
+            for values in self.samples:
+                self.file.write(struct.pack("<6f", *values))
+            self.captures += 1
+            self.samples = []
+
+    def close(self):
+        self.file.close()
+        print("corpus    %d captures" % self.captures)
+
+
+def cobs_decode(data):
+    """Undo COBS stuffing; returns None if the block lengths are inconsistent."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xff and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Splits the byte stream into frames and writes each record to its CSV."""
+
+    def __init__(self, output, corpus=None):
+        os.makedirs(output, exist_ok=True)
+        self.output = output
+        self.files = {}
+        self.writers = {}
+        self.counts = {}
+        self.buffer = bytearray()
+        self.sequence = None
+        self.lost = 0
+        self.bad = 0
+        self.scale = None
+        self.corpus = corpus
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            end = self.buffer.find(b"\x00")
+            if end < 0:
+                return
+            frame = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if frame:
+                self.frame(frame)
+
+    def frame(self, encoded):
+        raw = cobs_decode(encoded)
+        if raw is None or len(raw) < 4:
+            self.bad += 1
+            return
+        body, crc = raw[:-2], struct.unpack("<H", raw[-2:])[0]
+        if binascii.crc_hqx(body, 0xffff) != crc:
+            self.bad += 1
+            return
+
+        kind, sequence, payload = body[0], body[1], body[2:]
+        if self.sequence is not None:
+            self.lost += (sequence - self.sequence - 1) & 0xff
+        self.sequence = sequence
+
+        if kind not in RECORDS:
+            self.bad += 1
+            return
+        name, fmt, columns = RECORDS[kind]
+        if len(payload) != struct.calcsize(fmt):
+            self.bad += 1
+            return
+        values = list(struct.unpack(fmt, payload))
+        if kind == 0:
+            self.scale = values[1]
+        if kind == 4 and values[0] < len(PROBE_NAMES):
+            values[0] = PROBE_NAMES[values[0]]
+        if kind == 6 and self.corpus:
+            self.corpus.add(values[0], values[1], values[2], values[3:9])
+        if kind in (1, 2) and self.scale is not None:
+            values += [v * self.scale for v in values[1:4]]
+        self.write(name, columns, values)
+
+    def write(self, name, columns, values):
+        if name not in self.writers:
+            f = open(os.path.join(self.output, name + ".csv"), "w", newline="")
+            writer = csv.writer(f)
+            header = list(columns)
+            if len(values) > len(columns):
+                header += ["x_dps", "y_dps", "z_dps"]
+            writer.writerow(header)
+            self.files[name] = f
+            self.writers[name] = writer
+            self.counts[name] = 0
+        self.writers[name].writerow(values)
+        self.counts[name] += 1
+
+    def close(self):
+        for f in self.files.values():
+            f.close()
+        for name, count in sorted(self.counts.items()):
+            print("%-9s %d records" % (name, count))
+        print("lost frames %d, bad frames %d" % (self.lost, self.bad))
+        if self.corpus:
+            self.corpus.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the telemetry UART")
+    source.add_argument("--input", help="file saved earlier with --save")
+    parser.add_argument("--baud", type=int, default=921600)
+    parser.add_argument("--seconds", type=float, default=0, help="stop after this long, 0 for Ctrl+C")
+    parser.add_argument("--save", help="also store the undecoded bytes here")
+    parser.add_argument("--output", default="telemetry", help="directory for the CSV files")
+    parser.add_argument("--corpus", help="append complete captures to this corpus file")
+    parser.add_argument("--label", type=int, default=0, help="label of the captures appended to the corpus")
+    args = parser.parse_args()
+
+    decoder = Decoder(args.output, Corpus(args.corpus, args.label) if args.corpus else None)
+    save = open(args.save, "wb") if args.save else None
+    try:
+        if args.input:
+            with open(args.input, "rb") as f:
+                decoder.feed(f.read())
+        else:
+            import serial
+            port = serial.Serial(args.port, args.baud, timeout=0.1)
+            deadline = time.time() + args.seconds if args.seconds else None
+            try:
+                while deadline is None or time.time() < deadline:
+                    data = port.read(max(1, port.in_waiting))
+                    if save:
+                        save.write(data)
+                    decoder.feed(data)
+            except KeyboardInterrupt:
+                pass
+            port.close()
+    finally:
+        if save:
+            save.close()
+        decoder.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,72 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*******************************************************************************
+ * Class: SpscQueue
+ * -----------------------------------------------------------------------------
+ * Fixed-size lock-free queue for exactly one producer and one consumer.
+ *
+ * The producer only writes head and the consumer only writes tail, so neither
+ * side ever blocks or disables interrupts. Indices run freely and wrap
+ * through the power-of-two capacity mask.
+ *
+ * Template parameters:
+ *  - T: Element type, copied in and out of the queue.
+ *  - N: Capacity in elements, must be a power of two.
+ ******************************************************************************/
+template <typename T, uint32_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Append an item (producer only); returns false if the queue is full
+    bool push(const T &item)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);          // Only the producer writes head
+        if (h - tail.load(std::memory_order_acquire) == N)          // Consumer has not freed a slot yet
+        {
+            return false;
+        }
+        buffer[h & (N - 1)] = item;                                 // Fill the slot
+        head.store(h + 1, std::memory_order_release);               // Publish the slot to the consumer
+        return true;
+    }
+
+    // Remove the oldest item (consumer only); returns false if the queue is empty
+    bool pop(T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);          // Only the consumer writes tail
+        if (t == head.load(std::memory_order_acquire))              // Producer has not published anything
+        {
+            return false;
+        }
+        item = buffer[t & (N - 1)];                                 // Copy the slot out
+        tail.store(t + 1, std::memory_order_release);               // Hand the slot back to the producer
+        return true;
+    }
+
+    // Number of queued items; exact only when called from the producer or consumer
+    uint32_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    // Maximum number of queued items
+    static constexpr uint32_t capacity()
+    {
+        return N;
+    }
+
+private:
+    T buffer[N];                       // Element storage
+    std::atomic<uint32_t> head;        // Next slot to write, owned by the producer
+    std::atomic<uint32_t> tail;        // Next slot to read, owned by the consumer
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include <string.h>                              // Include memcpy
+#include "telemetry.h"                           // Include the telemetry header
+
+// Little-endian field writers, return the position after the field
+static uint8_t *put_u8(uint8_t *p, uint8_t v)
+{
+    *p = v;
+    return p + 1;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+static uint8_t *put_f32(uint8_t *p, float v)
+{
+    uint32_t bits;                                   // IEEE 754 bit pattern, the M4 is little-endian too
+    memcpy(&bits, &v, sizeof(bits));
+    return put_u32(p, bits);
+}
+
+/*******************************************************************************
+ * Function: telemetry_crc16
+ * -----------------------------------------------------------------------------
+ * CRC-16/CCITT-FALSE with a 16-entry table, two lookups per byte.
+ *
+ * Parameters:
+ *  - data: Bytes to checksum.
+ *  - length: Number of bytes.
+ *  - crc: 0xFFFF to start, or the result of the previous call to continue.
+ *
+ * Returns:
+ *  - Updated CRC.
+ ******************************************************************************/
+uint16_t telemetry_crc16(const uint8_t *data, size_t length, uint16_t crc)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    };
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (uint16_t)((crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0f)]);
+    }
+    return crc;
+}
+
+/*******************************************************************************
+ * Function: telemetry_cobs_encode
+ * -----------------------------------------------------------------------------
+ * Consistent Overhead Byte Stuffing: every zero is replaced by the distance to
+ * the next one, at a cost of one byte per 254 bytes of input.
+ *
+ * Parameters:
+ *  - data: Bytes to encode.
+ *  - length: Number of bytes.
+ *  - out: Receives length + length / 254 + 1 bytes at most.
+ *
+ * Returns:
+ *  - Encoded length, not counting a delimiter.
+ ******************************************************************************/
+size_t telemetry_cobs_encode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t code_index = 0;                           // Where the current block's length byte goes
+    size_t write = 1;                                // Next output byte
+    uint8_t code = 1;                                // Length of the current block plus one
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (data[i] == 0)
+        {
+            out[code_index] = code;                  // Close the block at the zero
+            code_index = write++;
+            code = 1;
+            continue;
+        }
+        out[write++] = data[i];
+        if (++code == 0xff)
+        {
+            out[code_index] = code;                  // Block full, start another without a zero
+            code_index = write++;
+            code = 1;
+        }
+    }
+    out[code_index] = code;
+    return write;
+}
+
+/*******************************************************************************
+ * Function: telemetry_frame
+ * -----------------------------------------------------------------------------
+ * Adds the header and CRC to a payload, COBS-encodes it and appends the
+ * delimiter.
+ *
+ * Parameters:
+ *  - type: Record type.
+ *  - sequence: Frame counter.
+ *  - payload: Serialized fields.
+ *  - length: Payload bytes, at most TELEMETRY_MAX_PAYLOAD.
+ *  - out: Receives at most TELEMETRY_MAX_FRAME bytes.
+ *
+ * Returns:
+ *  - Frame length including the delimiter.
+ ******************************************************************************/
+size_t telemetry_frame(uint8_t type, uint8_t sequence, const uint8_t *payload, size_t length, uint8_t *out)
+{
+    uint8_t raw[TELEMETRY_MAX_PAYLOAD + 4];          // Frame before stuffing
+    uint8_t *p = put_u8(raw, type);
+    p = put_u8(p, sequence);
+    memcpy(p, payload, length);
+    p += length;
+    p = put_u16(p, telemetry_crc16(raw, p - raw, 0xffff));
+
+    size_t encoded = telemetry_cobs_encode(raw, p - raw, out);
+    out[encoded] = 0;                                // Delimiter
+    return encoded + 1;
+}
+
+/*******************************************************************************
+ * Function: telemetry_frame_sample
+ * -----------------------------------------------------------------------------
+ * Frames one sensor sample as a TELEMETRY_RAW or TELEMETRY_FILTERED record.
+ *
+ * Parameters:
+ *  - type: TELEMETRY_RAW or TELEMETRY_FILTERED.
+ *  - sequence: Frame counter.
+ *  - sample: Sample to send.
+ *  - out: Receives at most TELEMETRY_MAX_FRAME bytes.
+ *
+ * Returns:
+ *  - Frame length including the delimiter.
+ ******************************************************************************/
+size_t telemetry_frame_sample(uint8_t type, uint8_t sequence, const Telemetry_Sample &sample, uint8_t *out)
+{
+    uint8_t payload[10];
+    uint8_t *p = put_u32(payload, sample.timestamp_us);
+    p = put_u16(p, (uint16_t)sample.x);
+    p = put_u16(p, (uint16_t)sample.y);
+    put_u16(p, (uint16_t)sample.z);
+    return telemetry_frame(type, sequence, payload, sizeof(payload), out);
+}
+
+/*******************************************************************************
+ * Function: telemetry_frame_record
+ * -----------------------------------------------------------------------------
+ * Frames a record serialized by one of the telemetry_*_record functions.
+ *
+ * Parameters:
+ *  - record: Serialized record.
+ *  - sequence: Frame counter.
+ *  - out: Receives at most TELEMETRY_MAX_FRAME bytes.
+ *
+ * Returns:
+ *  - Frame length including the delimiter.
+ ******************************************************************************/
+size_t telemetry_frame_record(const Telemetry_Record &record, uint8_t sequence, uint8_t *out)
+{
+    return telemetry_frame(record.type, sequence, record.payload, record.length, out);
+}
+
+/*******************************************************************************
+ * Function: telemetry_info_record
+ * -----------------------------------------------------------------------------
+ * Describes the streams so the decoder can scale samples to dps.
+ *
+ * Parameters:
+ *  - record: Receives the serialized record.
+ *  - odr_hz: Rate of the TELEMETRY_RAW stream.
+ *  - dps_per_digit: Sensitivity of the sample streams.
+ *  - segment_rate_hz: Rate of the TELEMETRY_FILTERED stream.
+ *  - gesture_rate_hz: Rate the matcher works at.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void telemetry_info_record(Telemetry_Record &record, uint32_t odr_hz, float dps_per_digit, uint16_t segment_rate_hz, uint16_t gesture_rate_hz)
+{
+    uint8_t *p = put_u32(record.payload, odr_hz);
+    p = put_f32(p, dps_per_digit);
+    p = put_u16(p, segment_rate_hz);
+    p = put_u16(p, gesture_rate_hz);
+    record.type = TELEMETRY_INFO;
+    record.length = (uint8_t)(p - record.payload);
+}
+
+/*******************************************************************************
+ * Function: telemetry_ensemble_record
+ * -----------------------------------------------------------------------------
+ * Serializes every matcher's score, logit term and time for an unlock attempt.
+ * Matchers that did not run have a clear bit in run and a NaN score.
+ *
+ * Parameters:
+ *  - record: Receives the serialized record.
+ *  - timestamp_us: Time the capture ended.
+ *  - result: Result from ensemble_match.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void telemetry_ensemble_record(Telemetry_Record &record, uint32_t timestamp_us, const Ensemble_Result &result)
+{
+    uint8_t *p = put_u32(record.payload, timestamp_us);
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        p = put_f32(p, result.score[i]);
+    }
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        p = put_f32(p, result.contribution[i]);
+    }
+    for (int i = 0; i < MATCHER_COUNT; i++)
+    {
+        p = put_u32(p, result.cycles[i]);
+    }
+    p = put_f32(p, result.probability);
+    p = put_u8(p, result.run);
+    p = put_u8(p, result.match ? TELEMETRY_ENSEMBLE_UNLOCKED : 0);
+    record.type = TELEMETRY_ENSEMBLE;
+    record.length = (uint8_t)(p - record.payload);
+}
+
+/*******************************************************************************
+ * Function: telemetry_gesture_record
+ * -----------------------------------------------------------------------------
+ * Serializes one sample of a finished capture exactly as the matcher saw it,
+ * so host tools can rebuild the template bit for bit. A capture is sent as
+ * count records with the same timestamp and index 0 to count - 1.
+ *
+ * Parameters:
+ *  - record: Receives the serialized record.
+ *  - timestamp_us: Time the capture ended, shared by all its records.
+ *  - gesture: Finished capture.
+ *  - index: Sample to send, below gesture.trace.size.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void telemetry_gesture_record(Telemetry_Record &record, uint32_t timestamp_us, const Gesture_Template &gesture, size_t index)
+{
+    uint8_t *p = put_u32(record.payload, timestamp_us);
+    p = put_u16(p, (uint16_t)index);
+    p = put_u16(p, (uint16_t)gesture.trace.size);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        p = put_f32(p, gesture.trace.samples[index][axis]);
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        p = put_f32(p, gesture.path.samples[index][axis]);
+    }
+    record.type = TELEMETRY_GESTURE;
+    record.length = (uint8_t)(p - record.payload);
+}
+
+/*******************************************************************************
+ * Function: telemetry_profile_record
+ * -----------------------------------------------------------------------------
+ * Serializes one profiler probe including its histogram.
+ *
+ * Parameters:
+ *  - record: Receives the serialized record.
+ *  - probe: Profile_Probe index.
+ *  - stats: Snapshot of the probe.
+ *
+ * Returns:
+ *  - None
+ ******************************************************************************/
+void telemetry_profile_record(Telemetry_Record &record, uint8_t probe, const Profile_Stats &stats)
+{
+    uint8_t *p = put_u8(record.payload, probe);
+    p = put_u32(p, stats.count);
+    p = put_u32(p, stats.count ? stats.min : 0);
+    p = put_u32(p, stats.count ? (uint32_t)(stats.total / stats.count) : 0);
+    p = put_u32(p, stats.max);
+    for (int b = 0; b < PROFILER_BUCKETS; b++)
+    {
+        p = put_u32(p, stats.buckets[b]);
+    }
+    record.type = TELEMETRY_PROFILE;
+    record.length = (uint8_t)(p - record.payload);
+}
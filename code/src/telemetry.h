@@ -0,0 +1,83 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ensemble.h"
+#include "profiler.h"
+
+/*******************************************************************************
+ * Binary telemetry framing
+ *
+ * Every record travels as one frame:
+ *
+ *   COBS( type:u8 | sequence:u8 | payload | crc16:u16 ) 0x00
+ *
+ * All fields are little-endian. The CRC is CRC-16/CCITT-FALSE (polynomial
+ * 0x1021, initial value 0xFFFF) over type, sequence and payload. COBS removes
+ * every zero byte from the frame, so 0x00 only appears as the delimiter and
+ * a decoder resynchronizes after at most one damaged frame. The sequence
+ * number increments per frame, so the decoder can count frames lost on the
+ * link. serial_dump.py is the host decoder.
+ ******************************************************************************/
+
+// Record types
+#define TELEMETRY_INFO 0           // odr_hz:u32 dps_per_digit:f32 segment_rate_hz:u16 gesture_rate_hz:u16
+#define TELEMETRY_RAW 1            // timestamp_us:u32 x:i16 y:i16 z:i16, every DRDY sample in digits
+#define TELEMETRY_FILTERED 2       // timestamp_us:u32 x:i16 y:i16 z:i16, segment-rate samples in digits
+#define TELEMETRY_PROFILE 4        // probe:u8 count:u32 min:u32 mean:u32 max:u32 buckets:u32[PROFILER_BUCKETS]
+#define TELEMETRY_ENSEMBLE 5       // timestamp_us:u32 score:f32[6] term:f32[6] cycles:u32[6] probability:f32 run:u8 flags:u8
+#define TELEMETRY_GESTURE 6        // timestamp_us:u32 index:u16 count:u16 x:f32 y:f32 z:f32 path_x:f32 path_y:f32 path_z:f32
+
+// Ensemble record flags; type 3 carried the scores of the legacy cascade and is not reused
+#define TELEMETRY_ENSEMBLE_UNLOCKED 0x04
+
+// Frame limits
+#define TELEMETRY_MAX_PAYLOAD (17 + 4 * PROFILER_BUCKETS) // Largest payload, the profile record
+#define TELEMETRY_MAX_FRAME (TELEMETRY_MAX_PAYLOAD + 4 + (TELEMETRY_MAX_PAYLOAD + 4) / 254 + 2) // Encoded size with COBS overhead and delimiter
+
+// One sensor sample for the high-rate streams
+typedef struct
+{
+    uint32_t timestamp_us;         // DRDY time of the sample
+    int16_t x;                     // Angular rate in digits
+    int16_t y;
+    int16_t z;
+} Telemetry_Sample;
+
+// Any record, already serialized
+typedef struct
+{
+    uint8_t type;                  // TELEMETRY_* record type
+    uint8_t length;                // Payload bytes used
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD]; // Little-endian fields
+} Telemetry_Record;
+
+// CRC-16/CCITT-FALSE over data, continuing from crc
+uint16_t telemetry_crc16(const uint8_t *data, size_t length, uint16_t crc);
+
+// COBS-encode length bytes into out, returns the encoded length without delimiter
+size_t telemetry_cobs_encode(const uint8_t *data, size_t length, uint8_t *out);
+
+// Build a complete frame including the delimiter, returns its length
+size_t telemetry_frame(uint8_t type, uint8_t sequence, const uint8_t *payload, size_t length, uint8_t *out);
+
+// Frame a sample record (TELEMETRY_RAW or TELEMETRY_FILTERED)
+size_t telemetry_frame_sample(uint8_t type, uint8_t sequence, const Telemetry_Sample &sample, uint8_t *out);
+
+// Frame a serialized record
+size_t telemetry_frame_record(const Telemetry_Record &record, uint8_t sequence, uint8_t *out);
+
+// Serialize the stream description
+void telemetry_info_record(Telemetry_Record &record, uint32_t odr_hz, float dps_per_digit, uint16_t segment_rate_hz, uint16_t gesture_rate_hz);
+
+// Serialize the per-matcher scores, terms and timings of one unlock attempt
+void telemetry_ensemble_record(Telemetry_Record &record, uint32_t timestamp_us, const Ensemble_Result &result);
+
+// Serialize sample index of a finished capture, rate and rotation path
+void telemetry_gesture_record(Telemetry_Record &record, uint32_t timestamp_us, const Gesture_Template &gesture, size_t index);
+
+// Serialize the timings of one profiler probe
+void telemetry_profile_record(Telemetry_Record &record, uint8_t probe, const Profile_Stats &stats);
+
+#endif